@@ -0,0 +1,222 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       arena.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Page and arena memory allocation
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Memory for nr's large in-memory tables and for the blocks it keeps
+   for the whole run.
+
+   PageAlloc() is used for the big tables which are read at random
+   (the Bloom filter, the deleted sequence bitset and the extra anchor
+   set). Normally it is just calloc(), but if nr is built with
+   HUGEPAGES defined (make DEFS=-DHUGEPAGES) tables of a huge page or
+   more are mapped from huge pages (MAP_HUGETLB) where some have been
+   reserved, or otherwise mapped on a huge page boundary and marked
+   for transparent huge pages (MADV_HUGEPAGE). Once a table is much
+   bigger than the TLB reaches with ordinary pages, almost every random
+   access also misses the TLB, and huge pages avoid most of this.
+
+   An ARENA hands out memory from large blocks obtained with 
+   PageAlloc(), so that many allocations which all live until the same
+   time cost nothing to make and are freed together by FreeArena().
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* mmap() flags are not declared under -ansi without this               */
+#define _DEFAULT_SOURCE
+
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef HUGEPAGES
+#  include <sys/mman.h>
+#endif
+#include "arena.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define ROUNDUP(x, n) (((x) + (n) - 1) / (n) * (n))
+
+
+/************************************************************************/
+/*>void *PageAlloc(size_t size)
+   ----------------------------
+   Input:     size_t size      Bytes needed
+   Returns:   void   *         Zeroed memory (NULL if none)
+
+   Allocates memory for a large table. It must be freed with PageFree()
+   giving the same size.
+
+   19.10.26 Original
+*/
+void *PageAlloc(size_t size)
+{
+#ifdef HUGEPAGES
+   char   *ptr;
+   size_t lead;
+
+   if(size >= HUGE_PAGE)
+   {
+      size = ROUNDUP(size, HUGE_PAGE);
+#  ifdef MAP_HUGETLB
+      ptr = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, 
+                         -1, 0);
+      if(ptr != (char *)MAP_FAILED)
+         return((void *)ptr);
+#  endif
+
+      /* No huge pages reserved, so map an extra huge page and trim it
+         so the memory starts on a huge page boundary where transparent
+         huge pages can be used
+      */
+      ptr = (char *)mmap(NULL, size + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(ptr == (char *)MAP_FAILED)
+         return(NULL);
+      lead = (HUGE_PAGE - ((unsigned long)ptr % HUGE_PAGE)) % HUGE_PAGE;
+      if(lead)
+         munmap(ptr, lead);
+      munmap(ptr + lead + size, HUGE_PAGE - lead);
+      ptr += lead;
+#  ifdef MADV_HUGEPAGE
+      madvise(ptr, size, MADV_HUGEPAGE);
+#  endif
+      return((void *)ptr);
+   }
+#endif
+   return(calloc(size, 1));
+}
+
+
+/************************************************************************/
+/*>void PageFree(void *ptr, size_t size)
+   -------------------------------------
+   Input:     void   *ptr      Memory from PageAlloc()
+              size_t size      Size that was requested
+
+   19.10.26 Original
+*/
+void PageFree(void *ptr, size_t size)
+{
+   if(ptr == NULL)
+      return;
+#ifdef HUGEPAGES
+   if(size >= HUGE_PAGE)
+   {
+      munmap(ptr, ROUNDUP(size, HUGE_PAGE));
+      return;
+   }
+#endif
+   free(ptr);
+}
+
+
+/************************************************************************/
+/*>void *ArenaAlloc(ARENA *arena, size_t size)
+   -------------------------------------------
+   I/O:       ARENA  *arena    Arena to allocate from
+   Input:     size_t size      Bytes needed
+   Returns:   void   *         Zeroed memory (NULL if none)
+
+   Takes memory from the newest block of the arena, starting a new
+   block when that is full. The memory can't be freed on its own.
+
+   19.10.26 Original
+*/
+void *ArenaAlloc(ARENA *arena, size_t size)
+{
+   ARENABLOCK *block = arena->blocks;
+   size_t     blockSize;
+   char       *ptr;
+
+   size = ROUNDUP(size, ARENA_ALIGN);
+   if((block == NULL) || (block->used + size > block->size))
+   {
+      blockSize = (arena->blockSize ? arena->blockSize : ARENA_BLOCK);
+      if(blockSize < size)
+         blockSize = size;
+      
+      if((block = (ARENABLOCK *)malloc(sizeof(ARENABLOCK)))==NULL)
+         return(NULL);
+      if((block->data = (char *)PageAlloc(blockSize))==NULL)
+      {
+         free(block);
+         return(NULL);
+      }
+      block->size   = blockSize;
+      block->used   = 0;
+      block->next   = arena->blocks;
+      arena->blocks = block;
+   }
+
+   ptr = block->data + block->used;
+   block->used += size;
+   return((void *)ptr);
+}
+
+
+/************************************************************************/
+/*>void FreeArena(ARENA *arena)
+   ----------------------------
+   I/O:       ARENA  *arena    Arena to free
+
+   Frees all the memory taken from an arena, leaving it empty
+
+   19.10.26 Original
+*/
+void FreeArena(ARENA *arena)
+{
+   ARENABLOCK *block,
+              *next;
+
+   for(block=arena->blocks; block!=NULL; block=next)
+   {
+      next = block->next;
+      PageFree(block->data, block->size);
+      free(block);
+   }
+   arena->blocks = NULL;
+}
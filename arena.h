@@ -0,0 +1,82 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       arena.h
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Page and arena memory allocation
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+#ifndef _NR_ARENA_H
+#define _NR_ARENA_H
+
+#include <stddef.h>
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define ARENA_BLOCK      16777216   /* Default size of an arena block   */
+#define ARENA_ALIGN      16         /* Alignment of ArenaAlloc() memory */
+#define HUGE_PAGE        2097152    /* Huge page size (with HUGEPAGES)  */
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct _arenablock
+{
+   char          *data;          /* From PageAlloc()                    */
+   size_t        size,
+                 used;
+   struct _arenablock *next;
+}  ARENABLOCK;
+
+typedef struct                   /* A zeroed ARENA is empty             */
+{
+   ARENABLOCK    *blocks;        /* Newest first                        */
+   size_t        blockSize;      /* 0 for ARENA_BLOCK                   */
+}  ARENA;
+
+/************************************************************************/
+/* Prototypes
+*/
+void *PageAlloc(size_t size);
+void PageFree(void *ptr, size_t size);
+void *ArenaAlloc(ARENA *arena, size_t size);
+void FreeArena(ARENA *arena);
+
+#endif
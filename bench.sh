@@ -0,0 +1,32 @@
+#!/bin/sh
+# Benchmark nr on synthetic data sets of increasing size.
+#
+# Each data set is generated by genfaa with a fixed seed, so the runs
+# are comparable between versions of nr. Results are appended as JSON
+# lines to $BENCH_RESULTS (default bench_results.json), including the
+# per-stage metrics written by nr -m.
+#
+# Override the sizes with BENCH_SIZES and the redundancy, chain depth,
+# mean length and X fraction with BENCH_REDUNDANCY, BENCH_DEPTH,
+# BENCH_MEANLEN and BENCH_XFRAC. The data and hash files go in
+# $NR_TMPDIR (default /tmp) since they are large.
+
+sizes=${BENCH_SIZES:-"10000 100000 1000000"}
+results=${BENCH_RESULTS:-bench_results.json}
+tmpdir=${NR_TMPDIR:-/tmp}
+redundancy=${BENCH_REDUNDANCY:-0.3}
+depth=${BENCH_DEPTH:-3}
+meanlen=${BENCH_MEANLEN:-350}
+xfrac=${BENCH_XFRAC:-0.001}
+
+for n in $sizes
+do
+    in=$tmpdir/nrbench_$n.faa
+    out=$tmpdir/nrbench_$n.nr
+    metrics=$tmpdir/nrbench_$n.json
+    ./genfaa -n $n -r $redundancy -c $depth -l $meanlen -x $xfrac \
+             -s 1 $in || exit 1
+    ./nrbench -o $results -l "nr-$n" -n $n -m $metrics \
+              ./nr -d $tmpdir -o $out -m $metrics $in 2>/dev/null
+    rm -f $in $out $metrics
+done
@@ -0,0 +1,318 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       bloom.c
+
+   Version:    V1.3
+   Date:       19.10.26
+   Function:   Blocked Bloom filter over the fragment hash
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   A Bloom filter in front of the fragment hash of nr, so that most
+   lookups of fragments which are not stored can be answered without
+   going to the GDBM file.
+
+   The filter is 'blocked': it is split into 64-byte blocks (a cache
+   line) and all the bits for a key are set in one block chosen by the
+   key's hash, so each test touches a single cache line. The keys are 
+   the fragment hash values from KmerHash(). Once the filter is bigger
+   than the cache, that line is usually a miss, so a caller with
+   several keys to test can start fetching their blocks first with
+   BloomPrefetch(). The filter is allocated with PageAlloc(), so that
+   it may be in huge pages and these misses don't also miss the TLB.
+
+   Bits can't be cleared, so deleting a fragment just leaves a stale
+   key in the filter which costs an occasional wasted lookup. Once too
+   many keys are stale, or the filter is too small for the number of
+   keys, BloomStale() says that it needs to be rebuilt.
+
+   There is one filter in use at a time. SwapBloom() exchanges it with
+   one kept in a BLOOM, so each library context can have its own.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.1  19.10.26 Added SwapBloom() and FreeBloom()
+   V1.2  19.10.26 Added BloomPrefetch()
+   V1.3  19.10.26 The filter comes from PageAlloc()
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "bloom.h"
+#include "arena.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define BLOCK_BYTES (BLOOM_BLOCK_BITS / 8)
+
+/* Start loading the cache line at p without waiting for it            */
+#ifdef __GNUC__
+#  define PREFETCH(p) __builtin_prefetch((p), 0, 3)
+#else
+#  define PREFETCH(p)
+#endif
+
+/************************************************************************/
+/* Globals
+*/
+static unsigned char *sBits      = NULL,   /* Aligned filter bits       */
+                     *sAlloc     = NULL;   /* As allocated              */
+static unsigned long sNBlocks    = 0;
+static long          sCapacity   = 0,      /* Keys the filter was sized
+                                              for                       */
+                     sNAdded     = 0,
+                     sNDeleted   = 0;
+
+
+/************************************************************************/
+/*>BOOL BloomCreate(long nKeys)
+   ----------------------------
+   Input:     long   nKeys     Number of keys to size the filter for
+   Returns:   BOOL             Success?
+
+   (Re)creates an empty filter. The keys must then be added again with
+   BloomAdd().
+
+   19.10.26 Original
+   19.10.26 Allocated with PageAlloc() so it may use huge pages
+*/
+BOOL BloomCreate(long nKeys)
+{
+   unsigned long size;
+   
+   if(sAlloc != NULL)
+      PageFree(sAlloc, (sNBlocks + 1) * BLOCK_BYTES);
+   
+   if(nKeys < 1)
+      nKeys = 1;
+   sNBlocks = ((unsigned long)nKeys * BLOOM_BITS_PER_KEY + 
+               BLOOM_BLOCK_BITS - 1) / BLOOM_BLOCK_BITS;
+   size     = sNBlocks * BLOCK_BYTES;
+   
+   /* Allocate an extra block so the bits can start on a cache line     */
+   if((sAlloc = (unsigned char *)PageAlloc(size + BLOCK_BYTES))==NULL)
+   {
+      sBits     = NULL;
+      sNBlocks  = 0;
+      sCapacity = 0;
+      return(FALSE);
+   }
+   sBits = sAlloc + 
+           ((BLOCK_BYTES - ((unsigned long)sAlloc % BLOCK_BYTES)) % 
+            BLOCK_BYTES);
+
+   sCapacity = nKeys;
+   sNAdded   = 0;
+   sNDeleted = 0;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void BloomAdd(unsigned long hash)
+   ---------------------------------
+   Input:     unsigned long hash     Hash of a stored fragment
+
+   Adds a key to the filter. The block is chosen from the hash and the
+   bits within it by double hashing from a remix of the hash.
+
+   19.10.26 Original
+*/
+void BloomAdd(unsigned long hash)
+{
+   unsigned char *block;
+   unsigned long mix;
+   int           i, 
+                 bit,
+                 step;
+
+   if(sBits == NULL)
+      return;
+   
+   block = sBits + (hash % sNBlocks) * BLOCK_BYTES;
+   mix   = (hash ^ (hash >> 16)) * 0x45d9f3bUL;
+   bit   = (int)(mix % BLOOM_BLOCK_BITS);
+   step  = (int)((mix >> 9) % BLOOM_BLOCK_BITS) | 1;
+   
+   for(i=0; i<BLOOM_NHASH; i++)
+   {
+      block[bit >> 3] |= (unsigned char)(1 << (bit & 7));
+      bit = (bit + step) % BLOOM_BLOCK_BITS;
+   }
+   sNAdded++;
+}
+
+
+/************************************************************************/
+/*>BOOL BloomTest(unsigned long hash)
+   ----------------------------------
+   Input:     unsigned long hash     Hash of a fragment
+   Returns:   BOOL                   Might the fragment be stored?
+
+   If there is no filter, everything might be stored.
+
+   19.10.26 Original
+*/
+BOOL BloomTest(unsigned long hash)
+{
+   unsigned char *block;
+   unsigned long mix;
+   int           i, 
+                 bit,
+                 step;
+
+   if(sBits == NULL)
+      return(TRUE);
+   
+   block = sBits + (hash % sNBlocks) * BLOCK_BYTES;
+   mix   = (hash ^ (hash >> 16)) * 0x45d9f3bUL;
+   bit   = (int)(mix % BLOOM_BLOCK_BITS);
+   step  = (int)((mix >> 9) % BLOOM_BLOCK_BITS) | 1;
+   
+   for(i=0; i<BLOOM_NHASH; i++)
+   {
+      if(!(block[bit >> 3] & (1 << (bit & 7))))
+         return(FALSE);
+      bit = (bit + step) % BLOOM_BLOCK_BITS;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void BloomPrefetch(unsigned long hash)
+   --------------------------------------
+   Input:     unsigned long hash     Hash of a fragment
+
+   Starts loading the block that BloomTest() will look at for this key
+   into the cache, and returns at once.
+
+   19.10.26 Original
+*/
+void BloomPrefetch(unsigned long hash)
+{
+   if(sBits != NULL)
+      PREFETCH(sBits + (hash % sNBlocks) * BLOCK_BYTES);
+}
+
+
+/************************************************************************/
+/*>void BloomDeleted(void)
+   -----------------------
+   Notes that a key has been deleted from the fragment hash (it stays
+   in the filter).
+
+   19.10.26 Original
+*/
+void BloomDeleted(void)
+{
+   sNDeleted++;
+}
+
+
+/************************************************************************/
+/*>BOOL BloomStale(long nKeys)
+   ---------------------------
+   Input:     long   nKeys     Number of keys about to be in the filter
+   Returns:   BOOL             Should the filter be rebuilt?
+
+   TRUE if there is no filter, if it is too small for nKeys or if more
+   than 1/BLOOM_STALE of the keys added have since been deleted.
+
+   19.10.26 Original
+*/
+BOOL BloomStale(long nKeys)
+{
+   return((sBits == NULL) ||
+          (nKeys > sCapacity) ||
+          (sNDeleted * BLOOM_STALE > sNAdded));
+}
+
+
+/************************************************************************/
+/*>void SwapBloom(BLOOM *other)
+   ----------------------------
+   I/O:       BLOOM  *other    Filter to use (returned holding the one
+                               that was in use)
+
+   Exchanges the filter in use with another. A zeroed BLOOM is an empty
+   filter.
+
+   19.10.26 Original
+*/
+void SwapBloom(BLOOM *other)
+{
+   BLOOM here;
+
+   here.bits     = sBits;
+   here.alloc    = sAlloc;
+   here.nBlocks  = sNBlocks;
+   here.capacity = sCapacity;
+   here.nAdded   = sNAdded;
+   here.nDeleted = sNDeleted;
+
+   sBits         = other->bits;
+   sAlloc        = other->alloc;
+   sNBlocks      = other->nBlocks;
+   sCapacity     = other->capacity;
+   sNAdded       = other->nAdded;
+   sNDeleted     = other->nDeleted;
+
+   *other        = here;
+}
+
+
+/************************************************************************/
+/*>void FreeBloom(BLOOM *filter)
+   -----------------------------
+   I/O:       BLOOM  *filter   Filter which is not in use
+
+   Frees a filter swapped out with SwapBloom(), leaving it empty
+
+   19.10.26 Original
+   19.10.26 Uses PageFree()
+*/
+void FreeBloom(BLOOM *filter)
+{
+   if(filter->alloc != NULL)
+      PageFree(filter->alloc, (filter->nBlocks + 1) * BLOCK_BYTES);
+   filter->bits     = filter->alloc = NULL;
+   filter->nBlocks  = 0;
+   filter->capacity = filter->nAdded = filter->nDeleted = 0;
+}
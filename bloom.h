@@ -0,0 +1,85 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       bloom.h
+
+   Version:    V1.3
+   Date:       19.10.26
+   Function:   Blocked Bloom filter over the fragment hash
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.1  19.10.26 Added SwapBloom() and FreeBloom()
+   V1.2  19.10.26 Added BloomPrefetch()
+   V1.3  19.10.26 The filter comes from PageAlloc()
+
+*************************************************************************/
+#ifndef _NR_BLOOM_H
+#define _NR_BLOOM_H
+
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define BLOOM_BLOCK_BITS    512  /* Bits in a block (one cache line)    */
+#define BLOOM_BITS_PER_KEY  12   /* Gives a false positive rate of ~1%  */
+#define BLOOM_NHASH         6    /* Bits set in the block for each key  */
+#define BLOOM_STALE         4    /* Rebuild when 1/4 of keys deleted    */
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct                   /* A filter while it is not in use     */
+{
+   unsigned char *bits,
+                 *alloc;
+   unsigned long nBlocks;
+   long          capacity,
+                 nAdded,
+                 nDeleted;
+}  BLOOM;
+
+/************************************************************************/
+/* Prototypes
+*/
+BOOL BloomCreate(long nKeys);
+void BloomAdd(unsigned long hash);
+BOOL BloomTest(unsigned long hash);
+void BloomPrefetch(unsigned long hash);
+void BloomDeleted(void);
+BOOL BloomStale(long nKeys);
+void SwapBloom(BLOOM *other);
+void FreeBloom(BLOOM *filter);
+
+#endif
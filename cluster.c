@@ -0,0 +1,463 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       cluster.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Greedy identity-threshold clustering
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Clusters a set of sequences at a given sequence identity for the -i
+   mode of nr.
+
+   The sequences are taken longest first. Each is compared against the
+   representatives chosen so far and joins the cluster of the first one
+   it matches; if it matches none it becomes a new representative.
+
+   Identity is measured over the length of the shorter sequence (which
+   is always the new one) as 1 - (edits / length), where the edits are
+   the substitutions, insertions and deletions in the best alignment
+   of the whole of the shorter sequence against any part of the 
+   representative.
+
+   Most pairs are ruled out without aligning them by counting the
+   short words (WORD_LEN residues) they share. Each edit can spoil at 
+   most WORD_LEN of the words in the shorter sequence, so a pair within
+   the identity threshold must share at least
+      (len - WORD_LEN + 1) - (WORD_LEN * maxEdits)
+   words. The words of each representative are kept in an in-memory
+   index, so one pass over the words of a sequence gives the count for
+   every representative at once. Only the pairs which pass are aligned,
+   and the alignment is restricted to the band of diagonals which a
+   path with no more than maxEdits edits can reach.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cluster.h"
+#include "metrics.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define WORD_LEN 4
+#define NWORDS   (26*26*26*26)
+#define INF      0x3FFFFFFF
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct
+{
+   int *reps,                    /* Representatives with this word      */
+       nReps,
+       nAlloc;
+}  POSTING;
+
+/************************************************************************/
+/* Globals
+*/
+static CLUSTERSEQ *sSeqs = NULL; /* For the qsort() comparisons         */
+static int        *sCounts = NULL;
+
+/************************************************************************/
+/* Prototypes
+*/
+static int WordCode(char *word);
+static int CompareLengths(const void *p1, const void *p2);
+static int CompareCounts(const void *p1, const void *p2);
+static BOOL AddPosting(POSTING *posting, int rep);
+static int BandedEdits(char *rep, int repLen, char *seq, int seqLen,
+                       int maxEdits);
+
+
+/************************************************************************/
+/*>int ClusterSequences(CLUSTERSEQ *seqs, int nSeqs, REAL identity, 
+                        int *repOf)
+   ----------------------------------------------------------------
+   Input:     CLUSTERSEQ *seqs      The sequences
+              int        nSeqs      Number of sequences
+              REAL       identity   Identity threshold (0.0-1.0)
+   Output:    int        *repOf     For each sequence, the index of the
+                                    representative of its cluster (its
+                                    own index for a representative)
+   Returns:   int                   Number of clusters (-1 if out of
+                                    memory)
+
+   Greedy clustering of the sequences. See the description above.
+   Sequences of the same length are taken in descending order of ID so
+   that, as in CompareSequences(), the alphabetically higher ID is kept.
+
+   19.10.26 Original
+*/
+int ClusterSequences(CLUSTERSEQ *seqs, int nSeqs, REAL identity, 
+                     int *repOf)
+{
+   POSTING *postings = NULL;
+   int     *order    = NULL,
+           *stamp    = NULL,
+           *touched  = NULL,
+           *cands    = NULL,
+           nClusters = 0,
+           nTouched,
+           nCands,
+           nDups,
+           maxEdits,
+           minShared,
+           i, j, c, q, r,
+           code;
+
+   if(nSeqs == 0)
+      return(0);
+
+   if(((postings = (POSTING *)calloc(NWORDS, sizeof(POSTING)))==NULL) ||
+      ((stamp    = (int *)malloc(NWORDS * sizeof(int)))==NULL)        ||
+      ((order    = (int *)malloc(nSeqs * sizeof(int)))==NULL)         ||
+      ((touched  = (int *)malloc(nSeqs * sizeof(int)))==NULL)         ||
+      ((cands    = (int *)malloc(nSeqs * sizeof(int)))==NULL)         ||
+      ((sCounts  = (int *)calloc(nSeqs, sizeof(int)))==NULL))
+   {
+      nClusters = (-1);
+      goto cleanup;
+   }
+
+   for(i=0; i<NWORDS; i++)
+      stamp[i] = (-1);
+
+   /* Longest first                                                     */
+   for(i=0; i<nSeqs; i++)
+      order[i] = i;
+   sSeqs = seqs;
+   qsort(order, nSeqs, sizeof(int), CompareLengths);
+
+   for(i=0; i<nSeqs; i++)
+   {
+      q = order[i];
+      repOf[q] = q;
+      METRIC(seqsIn);
+      PROGRESS();
+
+      maxEdits = (int)((1.0 - identity) * seqs[q].len);
+
+      /* Count the words shared with each representative. Each word of
+         this sequence is only counted once.
+      */
+      nTouched = 0;
+      nDups    = 0;
+      for(j=0; j<=seqs[q].len-WORD_LEN; j++)
+      {
+         if(((code = WordCode(seqs[q].seq+j)) < 0) || (stamp[code] == q))
+         {
+            nDups++;
+            continue;
+         }
+         stamp[code] = q;
+         METRIC(hashProbes);
+         for(c=0; c<postings[code].nReps; c++)
+         {
+            r = postings[code].reps[c];
+            if(sCounts[r]++ == 0)
+               touched[nTouched++] = r;
+         }
+      }
+
+      /* Keep the representatives with enough words in common. Words
+         which were skipped could not have been counted.
+      */
+      minShared = (seqs[q].len - WORD_LEN + 1) - (WORD_LEN * maxEdits) 
+                  - nDups;
+      if(minShared < 1)
+         minShared = 1;
+      nCands = 0;
+      for(c=0; c<nTouched; c++)
+      {
+         if(sCounts[touched[c]] >= minShared)
+            cands[nCands++] = touched[c];
+      }
+
+      /* Align against the candidates, best first                       */
+      qsort(cands, nCands, sizeof(int), CompareCounts);
+      for(c=0; c<nCands; c++)
+      {
+         r = cands[c];
+         METRIC(candidateFetches);
+         METRIC(compares);
+         if(BandedEdits(seqs[r].seq, seqs[r].len, seqs[q].seq, 
+                        seqs[q].len, maxEdits) <= maxEdits)
+         {
+            METRIC(compareResults[1]);
+            repOf[q] = r;
+            break;
+         }
+         METRIC(compareResults[0]);
+      }
+
+      for(c=0; c<nTouched; c++)
+         sCounts[touched[c]] = 0;
+
+      /* No match so this is a new representative. Index its words.     */
+      if(repOf[q] == q)
+      {
+         METRIC(seqsOut);
+         nClusters++;
+         for(j=0; j<=seqs[q].len-WORD_LEN; j++)
+         {
+            if((code = WordCode(seqs[q].seq+j)) >= 0)
+            {
+               if(!AddPosting(&(postings[code]), q))
+               {
+                  nClusters = (-1);
+                  goto cleanup;
+               }
+            }
+         }
+      }
+   }
+
+cleanup:
+   if(postings != NULL)
+   {
+      for(i=0; i<NWORDS; i++)
+      {
+         if(postings[i].reps != NULL)
+            free(postings[i].reps);
+      }
+      free(postings);
+   }
+   if(stamp   != NULL) free(stamp);
+   if(order   != NULL) free(order);
+   if(touched != NULL) free(touched);
+   if(cands   != NULL) free(cands);
+   if(sCounts != NULL) free(sCounts);
+   sCounts = NULL;
+
+   return(nClusters);
+}
+
+
+/************************************************************************/
+/*>static int WordCode(char *word)
+   -------------------------------
+   Input:     char   *word      Start of a word in a sequence
+   Returns:   int               Index for the word (-1 if it contains
+                                anything other than A-Z)
+
+   19.10.26 Original
+*/
+static int WordCode(char *word)
+{
+   int code = 0,
+       i;
+
+   for(i=0; i<WORD_LEN; i++)
+   {
+      if((word[i] < 'A') || (word[i] > 'Z'))
+         return(-1);
+      code = (code * 26) + (word[i] - 'A');
+   }
+   return(code);
+}
+
+
+/************************************************************************/
+/*>static BOOL AddPosting(POSTING *posting, int rep)
+   -------------------------------------------------
+   Input:     POSTING *posting  Index entry for a word
+              int     rep       Representative containing the word
+   Returns:   BOOL              Success?
+
+   Adds a representative to the list for a word. The words of each
+   representative are added together so a repeated word is spotted as
+   being the same as the last one in the list.
+
+   19.10.26 Original
+*/
+static BOOL AddPosting(POSTING *posting, int rep)
+{
+   if(posting->nReps && (posting->reps[posting->nReps-1] == rep))
+      return(TRUE);
+
+   if(posting->nReps == posting->nAlloc)
+   {
+      posting->nAlloc = (posting->nAlloc)?(2 * posting->nAlloc):4;
+      if((posting->reps = (int *)realloc(posting->reps, 
+                                         posting->nAlloc * sizeof(int)))
+         ==NULL)
+         return(FALSE);
+   }
+   posting->reps[posting->nReps++] = rep;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static int BandedEdits(char *rep, int repLen, char *seq, int seqLen,
+                          int maxEdits)
+   --------------------------------------------------------------------
+   Input:     char   *rep       Representative sequence
+              int    repLen     Its length
+              char   *seq       Shorter sequence
+              int    seqLen     Its length
+              int    maxEdits   Maximum number of edits of interest
+   Returns:   int               Edits needed to align all of seq 
+                                against part of rep (maxEdits+1 if more
+                                than maxEdits)
+
+   Dynamic programming with unit costs and free end gaps in rep. Only
+   the diagonals (j-i) from -maxEdits to (repLen-seqLen+maxEdits) can
+   be reached without more than maxEdits edits, so only that band is
+   calculated, one row (residue of seq) at a time. Gives up as soon as
+   a whole row exceeds maxEdits.
+
+   19.10.26 Original
+*/
+static int BandedEdits(char *rep, int repLen, char *seq, int seqLen,
+                       int maxEdits)
+{
+   static int *sPrev  = NULL,
+              *sCurr  = NULL,
+              sNAlloc = 0;
+   int        lo, hi, width,
+              i, j, b,
+              best,
+              cost,
+              *tmp;
+
+   lo    = -maxEdits;
+   hi    = repLen - seqLen + maxEdits;
+   width = hi - lo + 1;
+
+   if(width+2 > sNAlloc)
+   {
+      sNAlloc = width+2;
+      if(((sPrev = (int *)realloc(sPrev, sNAlloc * sizeof(int)))==NULL)||
+         ((sCurr = (int *)realloc(sCurr, sNAlloc * sizeof(int)))==NULL))
+      {
+         fprintf(stderr,"E003: No memory for alignment\n");
+         exit(1);
+      }
+   }
+
+   /* Band element b of row i is column j = i + lo + b. Elements 0 and
+      width+1 are sentinels outside the band.
+   */
+   sPrev[0] = sPrev[width+1] = sCurr[0] = sCurr[width+1] = INF;
+   for(b=1; b<=width; b++)
+   {
+      j = lo + b - 1;
+      sPrev[b] = ((j >= 0) && (j <= repLen)) ? 0 : INF;
+   }
+
+   for(i=1; i<=seqLen; i++)
+   {
+      best = INF;
+      for(b=1; b<=width; b++)
+      {
+         j = i + lo + b - 1;
+         if((j < 0) || (j > repLen))
+         {
+            sCurr[b] = INF;
+            continue;
+         }
+
+         /* Gap in rep                                                  */
+         cost = sPrev[b+1] + 1;
+         /* Gap in seq                                                  */
+         if(sCurr[b-1] + 1 < cost)
+            cost = sCurr[b-1] + 1;
+         /* Match or mismatch                                           */
+         if((j > 0) && 
+            (sPrev[b] + ((seq[i-1] == rep[j-1])?0:1) < cost))
+            cost = sPrev[b] + ((seq[i-1] == rep[j-1])?0:1);
+
+         sCurr[b] = cost;
+         if(cost < best)
+            best = cost;
+      }
+      if(best > maxEdits)
+         return(maxEdits+1);
+
+      tmp = sPrev; sPrev = sCurr; sCurr = tmp;
+   }
+
+   best = INF;
+   for(b=1; b<=width; b++)
+   {
+      if(sPrev[b] < best)
+         best = sPrev[b];
+   }
+   return((best > maxEdits) ? maxEdits+1 : best);
+}
+
+
+/************************************************************************/
+/*>static int CompareLengths(const void *p1, const void *p2)
+   ---------------------------------------------------------
+   qsort() comparison to put sequences in descending order of length
+   and then descending order of ID
+
+   19.10.26 Original
+*/
+static int CompareLengths(const void *p1, const void *p2)
+{
+   CLUSTERSEQ *s1 = sSeqs + *(int *)p1,
+              *s2 = sSeqs + *(int *)p2;
+
+   if(s1->len != s2->len)
+      return(s2->len - s1->len);
+   return(strcmp(s2->id, s1->id));
+}
+
+
+/************************************************************************/
+/*>static int CompareCounts(const void *p1, const void *p2)
+   --------------------------------------------------------
+   qsort() comparison to put representatives in descending order of
+   the number of words shared with the current sequence
+
+   19.10.26 Original
+*/
+static int CompareCounts(const void *p1, const void *p2)
+{
+   return(sCounts[*(int *)p2] - sCounts[*(int *)p1]);
+}
@@ -0,0 +1,244 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       dna.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Nucleotide k-mers for nr
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Support for nucleotide sequences (-D). A k-mer is packed 2 bits per
+   base (A=0, C=1, G=2, T=3, first base in the top bits of the first
+   byte) so it takes a quarter of the space of the text. Each k-mer is
+   stored in its 'canonical' form: the lower of the packed k-mer and
+   the packed reverse complement. A sequence and its reverse complement
+   therefore have the same k-mers (in the opposite order) and so the
+   same anchors and minimizers.
+
+   Lower case bases are accepted. A k-mer containing anything else 
+   (such as N) can't be packed.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dna.h"
+#include "minimizer.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define NOT_BASE (-1)
+
+/************************************************************************/
+/* Prototypes
+*/
+static int BaseCode(char base);
+static BOOL Grow(unsigned char **buffer, int *size, int needed);
+
+
+/************************************************************************/
+/*>BOOL PackCanonical(char *kmer, int k, unsigned char *packed)
+   ------------------------------------------------------------
+   Input:     char          *kmer    k-mer (need not be terminated)
+              int           k        Its length
+   Output:    unsigned char *packed  Canonical packed k-mer 
+                                     (DNA_PACKED_SIZE(k) bytes)
+   Returns:   BOOL                   Success? (FALSE if the k-mer has
+                                     anything other than ACGT)
+
+   Packs the k-mer and its reverse complement at the same time and 
+   keeps whichever is lower.
+
+   19.10.26 Original
+*/
+BOOL PackCanonical(char *kmer, int k, unsigned char *packed)
+{
+   static unsigned char *sReverse = NULL;
+   static int           sSize     = 0;
+   int                  nBytes    = DNA_PACKED_SIZE(k),
+                        i,
+                        code,
+                        shift;
+
+   if(!Grow(&sReverse, &sSize, nBytes))
+      return(FALSE);
+   memset(packed, 0, nBytes);
+   memset(sReverse, 0, nBytes);
+
+   for(i=0; i<k; i++)
+   {
+      if((code = BaseCode(kmer[i])) == NOT_BASE)
+         return(FALSE);
+
+      /* Base i of the k-mer is base k-1-i of the reverse complement    */
+      shift = 6 - 2*(i%4);
+      packed[i/4] |= (unsigned char)(code << shift);
+      shift = 6 - 2*((k-1-i)%4);
+      sReverse[(k-1-i)/4] |= (unsigned char)((3-code) << shift);
+   }
+
+   if(memcmp(sReverse, packed, nBytes) < 0)
+      memcpy(packed, sReverse, nBytes);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>unsigned long CanonicalHash(char *kmer, int k)
+   ----------------------------------------------
+   Input:     char          *kmer    k-mer
+              int           k        Its length
+   Returns:   unsigned long          KmerHash() of the canonical packed
+                                     k-mer (~0 if it can't be packed)
+
+   The -D replacement for KmerHash() on the text of a fragment. The
+   highest value is given to a k-mer which can't be packed, so that it
+   is only chosen as a minimizer if nothing else in the window can be.
+
+   19.10.26 Original
+*/
+unsigned long CanonicalHash(char *kmer, int k)
+{
+   static unsigned char *sPacked = NULL;
+   static int           sSize    = 0;
+
+   if(!Grow(&sPacked, &sSize, DNA_PACKED_SIZE(k)) ||
+      !PackCanonical(kmer, k, sPacked))
+      return(~0UL);
+   return(KmerHash((char *)sPacked, DNA_PACKED_SIZE(k)));
+}
+
+
+/************************************************************************/
+/*>BOOL ContainsRevComp(char *seq, char *sub)
+   ------------------------------------------
+   Input:     char   *seq      A sequence
+              char   *sub      A sequence no longer than seq
+   Returns:   BOOL             Does seq contain the reverse complement
+                               of sub?
+
+   19.10.26 Original
+*/
+BOOL ContainsRevComp(char *seq, char *sub)
+{
+   static unsigned char *sRevComp = NULL;
+   static int           sSize     = 0;
+   int                  length    = strlen(sub),
+                        i;
+   char                 base;
+
+   if(!Grow(&sRevComp, &sSize, length+1))
+      return(FALSE);
+
+   for(i=0; i<length; i++)
+   {
+      switch(base = sub[length-1-i])
+      {
+      case 'A': base = 'T'; break;
+      case 'C': base = 'G'; break;
+      case 'G': base = 'C'; break;
+      case 'T': base = 'A'; break;
+      case 'a': base = 't'; break;
+      case 'c': base = 'g'; break;
+      case 'g': base = 'c'; break;
+      case 't': base = 'a'; break;
+      }
+      sRevComp[i] = (unsigned char)base;
+   }
+   sRevComp[length] = '\0';
+
+   return(strstr(seq, (char *)sRevComp) != NULL);
+}
+
+
+/************************************************************************/
+/*>static int BaseCode(char base)
+   ------------------------------
+   Input:     char   base      A base
+   Returns:   int              Its 2-bit code (NOT_BASE if it isn't one
+                               of ACGT)
+
+   19.10.26 Original
+*/
+static int BaseCode(char base)
+{
+   switch(base)
+   {
+   case 'A': case 'a':
+      return(0);
+   case 'C': case 'c':
+      return(1);
+   case 'G': case 'g':
+      return(2);
+   case 'T': case 't':
+      return(3);
+   }
+   return(NOT_BASE);
+}
+
+
+/************************************************************************/
+/*>static BOOL Grow(unsigned char **buffer, int *size, int needed)
+   ---------------------------------------------------------------
+   I/O:       unsigned char **buffer  A buffer
+              int           *size     Its size
+   Input:     int           needed    Size needed
+   Returns:   BOOL                    Success?
+
+   19.10.26 Original
+*/
+static BOOL Grow(unsigned char **buffer, int *size, int needed)
+{
+   unsigned char *newBuffer;
+   
+   if(needed <= *size)
+      return(TRUE);
+   if((newBuffer = (unsigned char *)realloc(*buffer, needed))==NULL)
+   {
+      fprintf(stderr,"E003: No memory for k-mers\n");
+      return(FALSE);
+   }
+   *buffer = newBuffer;
+   *size   = needed;
+   return(TRUE);
+}
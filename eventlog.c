@@ -0,0 +1,273 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       eventlog.c
+
+   Version:    V1.3
+   Date:       19.10.26
+   Function:   Binary log of supersede events
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Writes the -b event log: one fixed-size binary record for each
+   sequence which is superceeded or dropped, giving the index of the
+   parent, the index of the child, a reason code and the stage. This is
+   much cheaper than formatting the -v messages and the file is a 
+   fraction of the size.
+
+   Sequence IDs are replaced by indexes (from the supersede forest) and
+   the table of IDs is written once, after the records, when the log is
+   closed. The records are packed into a buffer, byte by byte in 
+   little-endian order so the file is the same on any machine, and the
+   buffer is written out when full.
+
+   The nrevents program decodes the log back into text.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eventlog.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define EVENT_BUFFER_RECORDS 4096
+
+/************************************************************************/
+/* Globals
+*/
+static FILE          *sLog = NULL;
+static unsigned char sBuffer[EVENT_BUFFER_RECORDS * EVENT_RECORD_SIZE];
+static int           sNBuffered = 0;
+static unsigned long sNRecords  = 0;
+static BOOL          sError     = FALSE;
+
+static char *sReasonNames[EVENT_NREASONS] =
+{
+   "unknown",
+   "contained",
+   "no_fragment",
+   "mismatch",
+   "identity",
+   "too_many_xs",
+   "unstorable"
+};
+
+/************************************************************************/
+/* Prototypes
+*/
+static void PutU32(unsigned char *buffer, unsigned long value);
+static void FlushEvents(void);
+
+
+/************************************************************************/
+/*>BOOL OpenEventLog(char *filename)
+   ---------------------------------
+   Input:     char   *filename  File to write
+   Returns:   BOOL              Success?
+
+   Opens the event log and writes the header
+
+   19.10.26 Original
+*/
+BOOL OpenEventLog(char *filename)
+{
+   unsigned char header[EVENT_HEADER_SIZE];
+
+   if((sLog = fopen(filename, "wb"))==NULL)
+      return(FALSE);
+
+   memcpy(header, EVENT_MAGIC, 8);
+   PutU32(header+8,  EVENT_VERSION);
+   PutU32(header+12, EVENT_RECORD_SIZE);
+   sError     = (fwrite(header, EVENT_HEADER_SIZE, 1, sLog) != 1);
+   sNBuffered = 0;
+   sNRecords  = 0;
+
+   return(!sError);
+}
+
+
+/************************************************************************/
+/*>void LogEvent(unsigned long parent, unsigned long child, int reason,
+                 int stage)
+   -------------------------------------------------------------------
+   Input:     unsigned long parent  Index of the parent (EVENT_NO_PARENT
+                                    if there isn't one)
+              unsigned long child   Index of the child
+              int           reason  Reason code (EVENT_xxx)
+              int           stage   Stage (STAGE_xxx)
+
+   Adds a record to the log. Does nothing if the log isn't open.
+
+   19.10.26 Original
+*/
+void LogEvent(unsigned long parent, unsigned long child, int reason,
+              int stage)
+{
+   unsigned char *record;
+
+   if(sLog == NULL)
+      return;
+
+   record = sBuffer + (sNBuffered * EVENT_RECORD_SIZE);
+   PutU32(record,   parent);
+   PutU32(record+4, child);
+   record[8] = (unsigned char)reason;
+   record[9] = (unsigned char)stage;
+   sNRecords++;
+
+   if(++sNBuffered == EVENT_BUFFER_RECORDS)
+      FlushEvents();
+}
+
+
+/************************************************************************/
+/*>BOOL CloseEventLog(int nIDs, char *(*idOf)(int))
+   ------------------------------------------------
+   Input:     int    nIDs       Number of sequence indexes
+              char   *(*idOf)(int)  Function giving the ID for an index
+   Returns:   BOOL              Success?
+
+   Writes out any buffered records, the table of IDs and the trailer
+   and closes the log.
+
+   19.10.26 Original
+*/
+BOOL CloseEventLog(int nIDs, char *(*idOf)(int))
+{
+   unsigned char trailer[EVENT_TRAILER_SIZE];
+   char          *id;
+   int           i;
+   BOOL          retval;
+
+   if(sLog == NULL)
+      return(TRUE);
+
+   FlushEvents();
+
+   for(i=0; i<nIDs; i++)
+   {
+      id = (*idOf)(i);
+      if(fwrite(id, strlen(id)+1, 1, sLog) != 1)
+         sError = TRUE;
+   }
+
+   PutU32(trailer,   sNRecords);
+   PutU32(trailer+4, (unsigned long)nIDs);
+   memcpy(trailer+8, EVENT_TRAILER, 8);
+   if(fwrite(trailer, EVENT_TRAILER_SIZE, 1, sLog) != 1)
+      sError = TRUE;
+
+   retval = !sError;
+   if(fclose(sLog))
+      retval = FALSE;
+   sLog = NULL;
+
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>char *EventReasonName(int reason)
+   ---------------------------------
+   Input:     int    reason     Reason code
+   Returns:   char   *          Name of the reason
+
+   19.10.26 Original
+*/
+char *EventReasonName(int reason)
+{
+   if((reason < 0) || (reason >= EVENT_NREASONS))
+      reason = 0;
+   return(sReasonNames[reason]);
+}
+
+
+/************************************************************************/
+/*>unsigned long GetU32(unsigned char *buffer)
+   -------------------------------------------
+   Input:     unsigned char *buffer  4 bytes
+   Returns:   unsigned long          Little-endian value they hold
+
+   19.10.26 Original
+*/
+unsigned long GetU32(unsigned char *buffer)
+{
+   return((unsigned long)buffer[0]         | 
+          ((unsigned long)buffer[1] << 8)  |
+          ((unsigned long)buffer[2] << 16) | 
+          ((unsigned long)buffer[3] << 24));
+}
+
+
+/************************************************************************/
+/*>static void PutU32(unsigned char *buffer, unsigned long value)
+   --------------------------------------------------------------
+   Input:     unsigned long value   Value to store
+   Output:    unsigned char *buffer 4 bytes to hold it (little-endian)
+
+   19.10.26 Original
+*/
+static void PutU32(unsigned char *buffer, unsigned long value)
+{
+   buffer[0] = (unsigned char)(value         & 0xFF);
+   buffer[1] = (unsigned char)((value >> 8)  & 0xFF);
+   buffer[2] = (unsigned char)((value >> 16) & 0xFF);
+   buffer[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+
+/************************************************************************/
+/*>static void FlushEvents(void)
+   -----------------------------
+   Writes out the buffered records
+
+   19.10.26 Original
+*/
+static void FlushEvents(void)
+{
+   if(sNBuffered && 
+      (fwrite(sBuffer, EVENT_RECORD_SIZE, sNBuffered, sLog) != 
+       (size_t)sNBuffered))
+      sError = TRUE;
+   sNBuffered = 0;
+}
@@ -0,0 +1,85 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       eventlog.h
+
+   Version:    V1.3
+   Date:       19.10.26
+   Function:   Binary log of supersede events
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+#ifndef _NR_EVENTLOG_H
+#define _NR_EVENTLOG_H
+
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+/* File layout. All numbers are unsigned and little-endian.
+   Header:  EVENT_MAGIC (8 bytes), version (4), record size (4)
+   Records: parent index (4), child index (4), reason (1), stage (1)
+   IDs:     '\0'-terminated ID for each index in turn
+   Trailer: number of records (4), number of IDs (4), EVENT_TRAILER (8)
+*/
+#define EVENT_MAGIC         "NREVENTS"
+#define EVENT_TRAILER       "NREVEND\0"
+#define EVENT_VERSION       1
+#define EVENT_HEADER_SIZE   16
+#define EVENT_RECORD_SIZE   10
+#define EVENT_TRAILER_SIZE  16
+#define EVENT_NO_PARENT     0xFFFFFFFFUL
+
+/* Reason codes                                                         */
+#define EVENT_CONTAINED     1  /* Contained in the parent               */
+#define EVENT_NO_FRAGMENT   2  /* No unique fragment, parent found      */
+#define EVENT_MISMATCH      3  /* Contained with mismatches (-k)        */
+#define EVENT_IDENTITY      4  /* Joined the parent's cluster (-i)      */
+#define EVENT_TOO_MANY_XS   5  /* Dropped: too many Xs (W002)           */
+#define EVENT_UNSTORABLE    6  /* Dropped: no unique fragment (W003)    */
+#define EVENT_NREASONS      7
+
+/************************************************************************/
+/* Prototypes
+*/
+BOOL OpenEventLog(char *filename);
+void LogEvent(unsigned long parent, unsigned long child, int reason,
+              int stage);
+BOOL CloseEventLog(int nIDs, char *(*idOf)(int));
+char *EventReasonName(int reason);
+unsigned long GetU32(unsigned char *buffer);
+
+#endif
@@ -0,0 +1,637 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       forest.c
+
+   Version:    V1.3
+   Date:       19.10.26
+   Function:   Record of which sequences superceeded which
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Keeps the "supersede forest" for the -c and -a options of nr: each
+   sequence which is dropped because another contains it (or, with -i,
+   because it joins another's cluster) points to the sequence which
+   superceeded it. Following the parents up from any sequence leads to
+   the representative in the final output.
+
+   Each sequence ID is given an index through an in-memory hash table
+   (open addressing, doubled when half full) and the parents are held
+   as an array of indexes, with path compression as in union-find so
+   that repeated lookups of the root are cheap. Optionally the file 
+   locator of each dropped sequence is kept so its header can be 
+   fetched again for merged deflines.
+
+   When a sequence has been marked as kept with ForestMarkKept(), the
+   members of its cluster (itself first, then every sequence whose root
+   it is) can be listed with ForestFirstMember()/ForestNextMember() or
+   written out as a representative/member TSV with ForestWriteTSV().
+
+   ForestWriteEdges() and ForestReadEdges() pass the edges from shard
+   worker processes back to the parent.
+
+   When an earlier run is updated, the forest is rebuilt from its
+   state. Each sequence may then carry a mark saying how the update
+   treats it, and ForestCut() detaches a sequence whose family is to
+   be worked out again.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.3  19.10.26 Added ForestCut(), ForestSetLocator() and marks for
+                  updates
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "forest.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXBUFF      320
+#define INITIAL_SIZE 1024
+#define NO_PARENT    (-1)
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct
+{
+   char *id,                     /* Sequence ID                         */
+        *locator;                /* Where to find it (may be NULL)      */
+   int  parent,                  /* Index of parent or NO_PARENT        */
+        next;                    /* Next member of the same cluster     */
+   int  mark;                    /* Set by ForestSetMark()              */
+   BOOL kept;                    /* In the final output?                */
+}  FORESTNODE;
+
+/************************************************************************/
+/* Globals
+*/
+static FORESTNODE *sNodes     = NULL;
+static int        sNNodes     = 0,
+                  sNAlloc     = 0,
+                  *sTable     = NULL,   /* Hash table of node indexes   */
+                  sTableSize  = 0,
+                  *sFirst     = NULL;   /* First member of each cluster */
+
+/************************************************************************/
+/* Prototypes
+*/
+static unsigned long HashID(char *id);
+static BOOL GrowTable(void);
+static void GroupMembers(void);
+static void NoMemory(void);
+
+
+/************************************************************************/
+/*>int ForestIndex(char *id, BOOL create)
+   --------------------------------------
+   Input:     char   *id        Sequence ID
+              BOOL   create     Create an entry if not found
+   Returns:   int               Index for the ID (-1 if not found)
+
+   19.10.26 Original
+*/
+int ForestIndex(char *id, BOOL create)
+{
+   unsigned long slot;
+   int           index;
+
+   if((sTableSize == 0) || (create && (2 * sNNodes >= sTableSize)))
+   {
+      if(!create)
+         return(-1);
+      if(!GrowTable())
+         NoMemory();
+   }
+
+   for(slot = HashID(id) % sTableSize; 
+       (index = sTable[slot]) != (-1); 
+       slot = (slot + 1) % sTableSize)
+   {
+      if(!strcmp(sNodes[index].id, id))
+         return(index);
+   }
+
+   if(!create)
+      return(-1);
+
+   if(sNNodes == sNAlloc)
+   {
+      sNAlloc = (sNAlloc)?(2 * sNAlloc):INITIAL_SIZE;
+      if((sNodes = (FORESTNODE *)realloc(sNodes, 
+                                         sNAlloc * sizeof(FORESTNODE)))
+         ==NULL)
+         NoMemory();
+   }
+
+   index = sNNodes++;
+   if((sNodes[index].id = (char *)malloc(strlen(id)+1))==NULL)
+      NoMemory();
+   strcpy(sNodes[index].id, id);
+   sNodes[index].locator = NULL;
+   sNodes[index].parent  = NO_PARENT;
+   sNodes[index].next    = (-1);
+   sNodes[index].kept    = FALSE;
+   sNodes[index].mark    = 0;
+   sTable[slot] = index;
+
+   /* Any grouping of members is now out of date                        */
+   if(sFirst != NULL)
+   {
+      free(sFirst);
+      sFirst = NULL;
+   }
+
+   return(index);
+}
+
+
+/************************************************************************/
+/*>int ForestSize(void)
+   --------------------
+   Returns:   int               Number of sequences in the forest
+
+   19.10.26 Original
+*/
+int ForestSize(void)
+{
+   return(sNNodes);
+}
+
+
+/************************************************************************/
+/*>char *ForestID(int index)
+   -------------------------
+   Input:     int    index      Index of a sequence
+   Returns:   char   *          Its ID
+
+   19.10.26 Original
+*/
+char *ForestID(int index)
+{
+   return(sNodes[index].id);
+}
+
+
+/************************************************************************/
+/*>char *ForestLocator(int index)
+   ------------------------------
+   Input:     int    index      Index of a sequence
+   Returns:   char   *          Its file locator (NULL if not known)
+
+   19.10.26 Original
+*/
+char *ForestLocator(int index)
+{
+   return(sNodes[index].locator);
+}
+
+
+/************************************************************************/
+/*>void ForestAddEdge(char *parent, char *child, char *locator)
+   ------------------------------------------------------------
+   Input:     char   *parent    ID of the superceeding sequence
+              char   *child     ID of the superceeded sequence
+              char   *locator   File locator of the child (or NULL)
+
+   Records that child has been superceeded by parent. A sequence only
+   has one parent, so if it has already been superceeded (or this would
+   make a loop) the edge is ignored.
+
+   19.10.26 Original
+*/
+void ForestAddEdge(char *parent, char *child, char *locator)
+{
+   int p, c;
+
+   p = ForestIndex(parent, TRUE);
+   c = ForestIndex(child,  TRUE);
+
+   if((sNodes[c].parent != NO_PARENT) || (ForestRoot(p) == c))
+      return;
+
+   sNodes[c].parent = p;
+   if(locator != NULL)
+   {
+      if((sNodes[c].locator = (char *)malloc(strlen(locator)+1))==NULL)
+         NoMemory();
+      strcpy(sNodes[c].locator, locator);
+   }
+
+   if(sFirst != NULL)
+   {
+      free(sFirst);
+      sFirst = NULL;
+   }
+}
+
+
+/************************************************************************/
+/*>void ForestCut(int index)
+   -------------------------
+   Input:     int    index      Index of a sequence
+
+   Makes a superceeded sequence a root again, forgetting its parent and
+   locator. Anything whose path to the root passes through it goes with
+   it, so when only the sequence itself should move every path must 
+   already have been compressed with ForestRoot().
+
+   19.10.26 Original
+*/
+void ForestCut(int index)
+{
+   sNodes[index].parent = NO_PARENT;
+   if(sNodes[index].locator != NULL)
+   {
+      free(sNodes[index].locator);
+      sNodes[index].locator = NULL;
+   }
+
+   if(sFirst != NULL)
+   {
+      free(sFirst);
+      sFirst = NULL;
+   }
+}
+
+
+/************************************************************************/
+/*>void ForestSetLocator(int index, char *locator)
+   -----------------------------------------------
+   Input:     int    index      Index of a sequence
+              char   *locator   Its new file locator
+
+   19.10.26 Original
+*/
+void ForestSetLocator(int index, char *locator)
+{
+   if(sNodes[index].locator != NULL)
+      free(sNodes[index].locator);
+   if((sNodes[index].locator = (char *)malloc(strlen(locator)+1))==NULL)
+      NoMemory();
+   strcpy(sNodes[index].locator, locator);
+}
+
+
+/************************************************************************/
+/*>void ForestSetMark(int index, int mark)
+   ---------------------------------------
+   Input:     int    index      Index of a sequence
+              int    mark       Value to keep with it (initially 0)
+
+   19.10.26 Original
+*/
+void ForestSetMark(int index, int mark)
+{
+   sNodes[index].mark = mark;
+}
+
+
+/************************************************************************/
+/*>int ForestMark(int index)
+   -------------------------
+   Input:     int    index      Index of a sequence
+   Returns:   int               Value given to ForestSetMark()
+
+   19.10.26 Original
+*/
+int ForestMark(int index)
+{
+   return(sNodes[index].mark);
+}
+
+
+/************************************************************************/
+/*>int ForestRoot(int index)
+   -------------------------
+   Input:     int    index      Index of a sequence
+   Returns:   int               Index of the root of its tree
+
+   Follows the parents up to the root, then points everything on the
+   way directly at the root.
+
+   19.10.26 Original
+*/
+int ForestRoot(int index)
+{
+   int root = index,
+       next;
+
+   while(sNodes[root].parent != NO_PARENT)
+      root = sNodes[root].parent;
+
+   while(index != root)
+   {
+      next = sNodes[index].parent;
+      sNodes[index].parent = root;
+      index = next;
+   }
+
+   return(root);
+}
+
+
+/************************************************************************/
+/*>void ForestMarkKept(char *id)
+   -----------------------------
+   Input:     char   *id        ID of a sequence in the final output
+
+   19.10.26 Original
+*/
+void ForestMarkKept(char *id)
+{
+   int index;
+
+   /* Separate statement since ForestIndex() may move sNodes            */
+   index = ForestIndex(id, TRUE);
+   sNodes[index].kept = TRUE;
+}
+
+
+/************************************************************************/
+/*>int ForestFirstMember(int rep)
+   ------------------------------
+   Input:     int    rep        Index of a representative
+   Returns:   int               Index of the first member of its 
+                                cluster (the representative itself)
+
+   19.10.26 Original
+*/
+int ForestFirstMember(int rep)
+{
+   if(sFirst == NULL)
+      GroupMembers();
+   return(sFirst[rep]);
+}
+
+
+/************************************************************************/
+/*>int ForestNextMember(int member)
+   --------------------------------
+   Input:     int    member     Index of a cluster member
+   Returns:   int               Index of the next member (-1 if none)
+
+   19.10.26 Original
+*/
+int ForestNextMember(int member)
+{
+   return(sNodes[member].next);
+}
+
+
+/************************************************************************/
+/*>BOOL ForestWriteTSV(FILE *out)
+   ------------------------------
+   Input:     FILE   *out       Output file
+   Returns:   BOOL              Success?
+
+   Writes a line for each member of each cluster giving the ID of the
+   representative and the ID of the member. The representative is
+   listed as the first member of its own cluster. Only clusters whose
+   representative was marked as kept are written.
+
+   19.10.26 Original
+*/
+BOOL ForestWriteTSV(FILE *out)
+{
+   int rep,
+       member;
+
+   for(rep=0; rep<sNNodes; rep++)
+   {
+      if(sNodes[rep].kept && (sNodes[rep].parent == NO_PARENT))
+      {
+         for(member=ForestFirstMember(rep); 
+             member != (-1); 
+             member=ForestNextMember(member))
+         {
+            fprintf(out,"%s\t%s\n", sNodes[rep].id, sNodes[member].id);
+         }
+      }
+   }
+
+   return(!ferror(out));
+}
+
+
+/************************************************************************/
+/*>void ForestWriteEdges(FILE *out)
+   --------------------------------
+   Input:     FILE   *out       Output file
+
+   Writes each edge as a line giving the parent ID, child ID and (if 
+   known) the child's locator, separated by tabs.
+
+   19.10.26 Original
+*/
+void ForestWriteEdges(FILE *out)
+{
+   int i;
+
+   for(i=0; i<sNNodes; i++)
+   {
+      if(sNodes[i].parent != NO_PARENT)
+      {
+         fprintf(out,"%s\t%s\t%s\n", sNodes[sNodes[i].parent].id,
+                 sNodes[i].id,
+                 (sNodes[i].locator != NULL)?sNodes[i].locator:"");
+      }
+   }
+}
+
+
+/************************************************************************/
+/*>BOOL ForestReadEdges(FILE *in)
+   ------------------------------
+   Input:     FILE   *in        File written by ForestWriteEdges()
+   Returns:   BOOL              Success?
+
+   19.10.26 Original
+*/
+BOOL ForestReadEdges(FILE *in)
+{
+   char buffer[3*MAXBUFF],
+        *child,
+        *locator;
+
+   while(fgets(buffer, 3*MAXBUFF, in))
+   {
+      buffer[strcspn(buffer, "\n")] = '\0';
+      if(((child   = strchr(buffer,  '\t')) == NULL) ||
+         ((locator = strchr(child+1, '\t')) == NULL))
+         return(FALSE);
+      *(child++)   = '\0';
+      *(locator++) = '\0';
+      ForestAddEdge(buffer, child, (*locator)?locator:NULL);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void ForestFree(void)
+   ---------------------
+   Frees all the memory used by the forest
+
+   19.10.26 Original
+*/
+void ForestFree(void)
+{
+   int i;
+
+   for(i=0; i<sNNodes; i++)
+   {
+      free(sNodes[i].id);
+      if(sNodes[i].locator != NULL)
+         free(sNodes[i].locator);
+   }
+   if(sNodes != NULL) free(sNodes);
+   if(sTable != NULL) free(sTable);
+   if(sFirst != NULL) free(sFirst);
+   sNodes  = NULL;
+   sTable  = NULL;
+   sFirst  = NULL;
+   sNNodes = sNAlloc = sTableSize = 0;
+}
+
+
+/************************************************************************/
+/*>static void GroupMembers(void)
+   ------------------------------
+   Links the members of each cluster into a list starting at the root.
+   The root comes first and the others follow in index order.
+
+   19.10.26 Original
+*/
+static void GroupMembers(void)
+{
+   int *last,
+       i,
+       root;
+
+   if(((sFirst = (int *)malloc((sNNodes+1) * sizeof(int)))==NULL) ||
+      ((last   = (int *)malloc((sNNodes+1) * sizeof(int)))==NULL))
+      NoMemory();
+
+   for(i=0; i<sNNodes; i++)
+   {
+      sNodes[i].next = (-1);
+      if(sNodes[i].parent == NO_PARENT)
+         sFirst[i] = last[i] = i;
+      else
+         sFirst[i] = last[i] = (-1);
+   }
+
+   for(i=0; i<sNNodes; i++)
+   {
+      if(sNodes[i].parent != NO_PARENT)
+      {
+         root = ForestRoot(i);
+         sNodes[last[root]].next = i;
+         last[root] = i;
+      }
+   }
+
+   free(last);
+}
+
+
+/************************************************************************/
+/*>static BOOL GrowTable(void)
+   ---------------------------
+   Returns:   BOOL              Success?
+
+   Doubles the size of the hash table and re-enters all the IDs
+
+   19.10.26 Original
+*/
+static BOOL GrowTable(void)
+{
+   unsigned long slot;
+   int           i;
+
+   sTableSize = (sTableSize)?(2 * sTableSize):(2 * INITIAL_SIZE);
+   if(sTable != NULL)
+      free(sTable);
+   if((sTable = (int *)malloc(sTableSize * sizeof(int)))==NULL)
+      return(FALSE);
+
+   for(i=0; i<sTableSize; i++)
+      sTable[i] = (-1);
+
+   for(i=0; i<sNNodes; i++)
+   {
+      for(slot = HashID(sNodes[i].id) % sTableSize; 
+          sTable[slot] != (-1);
+          slot = (slot + 1) % sTableSize);
+      sTable[slot] = i;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static unsigned long HashID(char *id)
+   -------------------------------------
+   Input:     char   *id        Sequence ID
+   Returns:   unsigned long     Hash value
+
+   19.10.26 Original
+*/
+static unsigned long HashID(char *id)
+{
+   unsigned long hash = 5381;
+
+   while(*id)
+      hash = (hash * 33) + (unsigned char)*(id++);
+   return(hash);
+}
+
+
+/************************************************************************/
+/*>static void NoMemory(void)
+   --------------------------
+   19.10.26 Original
+*/
+static void NoMemory(void)
+{
+   fprintf(stderr,"E003: No memory for cluster membership\n");
+   exit(1);
+}
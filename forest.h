@@ -0,0 +1,73 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       forest.h
+
+   Version:    V1.3
+   Date:       19.10.26
+   Function:   Record of which sequences superceeded which
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.3  19.10.26 Added ForestCut(), ForestSetLocator() and marks for
+                  updates
+
+*************************************************************************/
+#ifndef _NR_FOREST_H
+#define _NR_FOREST_H
+
+#include <stdio.h>
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Prototypes
+*/
+int  ForestIndex(char *id, BOOL create);
+int  ForestSize(void);
+char *ForestID(int index);
+char *ForestLocator(int index);
+void ForestAddEdge(char *parent, char *child, char *locator);
+void ForestCut(int index);
+void ForestSetLocator(int index, char *locator);
+void ForestSetMark(int index, int mark);
+int  ForestMark(int index);
+int  ForestRoot(int index);
+void ForestMarkKept(char *id);
+int  ForestFirstMember(int rep);
+int  ForestNextMember(int member);
+BOOL ForestWriteTSV(FILE *out);
+void ForestWriteEdges(FILE *out);
+BOOL ForestReadEdges(FILE *in);
+void ForestFree(void);
+
+#endif
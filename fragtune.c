@@ -0,0 +1,703 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       fragtune.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Choose a fragment size from a sample of the input
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Chooses the fragment size for -f auto from a sample of the input
+   sequences. Each size in a range is tried on the sample and the
+   fastest of the sizes expected to lose no sequences with W003 is
+   chosen. As in nr, the fragments hashed for a fragment size of f are
+   f-1 residues long.
+
+   Sampled sequences which lie within another sampled sequence are set
+   aside first: they are redundant, so it doesn't matter if they can't
+   store a fragment, and an exact copy in the sample would otherwise
+   make every fragment of a sequence look as if it were taken.
+
+   For each size, two sets of fragments of the remaining sequences are
+   counted in a hash table: those which are probed (the minimizers, or
+   every fragment with -w 0) and those which may become anchors (the
+   minimizers, or the first fragment with -w 0). The chance that a 
+   probe matches the anchor of another sequence (the collision rate)
+   times the estimated number of sequences in the input gives the 
+   number of candidates expected for each probe (the fan-out) - each
+   one has to be read back and compared.
+
+   A sequence is lost with W003 if every one of its fragments has been
+   taken as the anchor of another sequence. A fragment with frequency
+   p among the anchors of the sample is expected to be taken by one of
+   N other sequences with probability 1 - exp(-Np). For a fragment not
+   seen as the anchor of another sampled sequence, the Good-Turing 
+   estimate of the frequency of an anchor seen once in the sample is
+   used instead. The chance of losing the sequence is the product over
+   its distinct fragments, and the sum over the input is the expected
+   number of losses.
+
+   The cost of a size is that of hashing every fragment, probing the
+   Bloom filter and reading back the expected candidates.
+   TUNE_PROBE_COST and TUNE_FETCH_COST were measured from the nr
+   metrics.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fragtune.h"
+#include "minimizer.h"
+#include "dna.h"
+#include "arena.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define SMALL_X     1.0e-6       /* 1-exp(-x) is taken as x below this  */
+#define LOG_TINY    (-700.0)     /* Chances below exp(LOG_TINY) are 0   */
+#define FRAG_PROBED 1            /* Flags for each fragment             */
+#define FRAG_ANCHOR 2
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct
+{
+   unsigned long hash;
+   int           probes,         /* Times probed in the sample          */
+                 anchors,        /* Times a possible anchor             */
+                 last,           /* Last sequence it was counted in     */
+                 ownProbes,      /* ...and the counts in that sequence  */
+                 ownAnchors,
+                 seen;           /* Last sequence it was scored for     */
+   BOOL          used;
+}  FRAGCOUNT;
+
+typedef struct
+{
+   unsigned long hash;
+   int           seq;
+}  FRAGSEQ;
+
+typedef struct                   /* Work space for TrySize()            */
+{
+   unsigned long *hashes;        /* Hash of every sampled fragment      */
+   char          *flags;         /* FRAG_PROBED and FRAG_ANCHOR         */
+   FRAGCOUNT     *table;         /* Counts of the flagged fragments     */
+   unsigned long mask,           /* Table size - 1                      */
+                 maxMask;        /* Largest allowed by the allocation   */
+}  TUNEWORK;
+
+/************************************************************************/
+/* Prototypes
+*/
+static int  NFrags(int length, int fragSize, BOOL dna);
+static FRAGCOUNT *FindCount(TUNEWORK *work, unsigned long hash);
+static int  CompareFragSeqs(const void *p1, const void *p2);
+static int  CompareHashes(const void *p1, const void *p2);
+static int  MarkRedundant(char **seqs, int *lengths, int nSeqs, 
+                          int fragSize, BOOL dna, char *redundant);
+static BOOL HashSample(char **seqs, int *lengths, int nSeqs,
+                       char *redundant, int fragSize, int window, 
+                       BOOL dna, TUNEWORK *work);
+static void TrySize(int *lengths, int nSeqs, char *redundant, 
+                    long nTotal, int nKept, BOOL dna, TUNEWORK *work,
+                    FRAGTUNING *size);
+
+
+/************************************************************************/
+/*>int TuneFragSize(char **seqs, int nSeqs, long nTotal, int minSize,
+                    int maxSize, int window, BOOL dna, 
+                    FRAGTUNING *sizes, int *nTried, int *nRedundant, 
+                    char *reason)
+   ------------------------------------------------------------------
+   Input:     char       **seqs       Sampled sequences
+              int        nSeqs        Number of sequences sampled
+              long       nTotal       Estimated sequences in the input
+              int        minSize      Smallest fragment size to try
+              int        maxSize      Largest fragment size to try (less
+                                      than the length of the shortest
+                                      sequence)
+              int        window       Minimizer window (-w)
+              BOOL       dna          Are they DNA (-D)?
+   Output:    FRAGTUNING *sizes       Results for each size tried (the
+                                      array must have room for 
+                                      maxSize-minSize+1)
+              int        *nTried      Number of sizes tried
+              int        *nRedundant  Sampled sequences contained in
+                                      another
+              char       *reason      Why the size was chosen (at 
+                                      least TUNE_REASON characters)
+   Returns:   int                     The fragment size chosen (0 if out
+                                      of memory or nothing was sampled)
+
+   Tries each fragment size on the sample and chooses the one expected
+   to be fastest of those expected to lose fewer than TUNE_MAX_LOSSES
+   sequences with W003. If none is safe, the one expected to lose 
+   fewest is chosen. Stops once TUNE_PATIENCE sizes in a row are no
+   faster than the fastest safe size so far.
+
+   19.10.26 Original
+*/
+int TuneFragSize(char **seqs, int nSeqs, long nTotal, int minSize,
+                 int maxSize, int window, BOOL dna, FRAGTUNING *sizes, 
+                 int *nTried, int *nRedundant, char *reason)
+{
+   TUNEWORK      work;
+   int           *lengths   = NULL;
+   char          *redundant = NULL;
+   long          nResidues  = 0;
+   size_t        tableSize  = 0;
+   double        minCost    = 0.0,
+                 bestCost   = 0.0;
+   int           nSizes     = maxSize - minSize + 1,
+                 nSinceBest = (-1),
+                 nSafe      = 0,
+                 best       = (-1),
+                 i;
+
+   *nRedundant = *nTried = 0;
+   if((nSeqs == 0) || (nSizes < 1))
+      return(0);
+
+   work.hashes = NULL;
+   work.flags  = NULL;
+   work.table  = NULL;
+
+   if(((lengths   = (int *)malloc(nSeqs * sizeof(int)))==NULL) ||
+      ((redundant = (char *)calloc(nSeqs, sizeof(char)))==NULL))
+   {
+      nSizes = 0;
+      goto cleanup;
+   }
+   for(i=0; i<nSeqs; i++)
+   {
+      lengths[i] = strlen(seqs[i]);
+      nResidues += lengths[i];
+   }
+
+   if((*nRedundant = MarkRedundant(seqs, lengths, nSeqs, maxSize, dna,
+                                   redundant)) < 0)
+   {
+      nSizes = 0;
+      goto cleanup;
+   }
+
+   /* Room for every fragment with the table no more than half full. 
+      With minimizers, only a fraction of it is used
+   */
+   for(work.maxMask=1024; work.maxMask < 2*nResidues; work.maxMask *= 2);
+   tableSize = work.maxMask * sizeof(FRAGCOUNT);
+   work.maxMask--;
+   if(((work.table  = (FRAGCOUNT *)PageAlloc(tableSize))==NULL)         ||
+      ((work.hashes = (unsigned long *)malloc(nResidues * 
+                                              sizeof(unsigned long)))
+       ==NULL)                                                          ||
+      ((work.flags  = (char *)malloc(nResidues * sizeof(char)))==NULL))
+   {
+      nSizes = 0;
+      goto cleanup;
+   }
+
+   for(i=0; i<nSizes; i++)
+   {
+      sizes[i].fragSize = minSize + i;
+      if(!HashSample(seqs, lengths, nSeqs, redundant, sizes[i].fragSize,
+                     window, dna, &work))
+      {
+         nSizes = 0;
+         goto cleanup;
+      }
+      TrySize(lengths, nSeqs, redundant, nTotal, nSeqs - *nRedundant, 
+              dna, &work, &(sizes[i]));
+      if((i == 0) || (sizes[i].cost < minCost))
+         minCost = sizes[i].cost;
+
+      /* Larger sizes only add to the hashing once the fan-out stops 
+         falling, so give up when they stop getting faster
+      */
+      if((sizes[i].w003Losses < TUNE_MAX_LOSSES) &&
+         ((nSinceBest < 0) || (sizes[i].cost < bestCost)))
+      {
+         bestCost   = sizes[i].cost;
+         nSinceBest = 0;
+      }
+      else if((nSinceBest >= 0) && (++nSinceBest >= TUNE_PATIENCE))
+      {
+         i++;
+         break;
+      }
+   }
+   *nTried = nSizes = i;
+
+   /* Make the costs relative to the cheapest and pick the fastest safe
+      size
+   */
+   for(i=0; i<nSizes; i++)
+   {
+      sizes[i].cost = (minCost > 0.0) ? (sizes[i].cost / minCost) : 1.0;
+      sizes[i].safe = (sizes[i].w003Losses < TUNE_MAX_LOSSES);
+      if(sizes[i].safe)
+      {
+         nSafe++;
+         if((best < 0) || !sizes[best].safe || 
+            (sizes[i].cost < sizes[best].cost))
+            best = i;
+      }
+      else if((best < 0) || 
+              (!sizes[best].safe && 
+               (sizes[i].w003Losses <= sizes[best].w003Losses)))
+      {
+         best = i;
+      }
+   }
+
+   if(nSafe)
+   {
+      sprintf(reason, "fastest of %d safe sizes: %.3g candidates per \
+probe and %.3g expected W003 losses", nSafe, sizes[best].fanOut, 
+              sizes[best].w003Losses);
+   }
+   else
+   {
+      sprintf(reason, "no size is safe: fewest expected W003 losses \
+(%.3g)", sizes[best].w003Losses);
+   }
+
+cleanup:
+   if(work.table  != NULL) PageFree(work.table, tableSize);
+   if(work.hashes != NULL) free(work.hashes);
+   if(work.flags  != NULL) free(work.flags);
+   if(lengths     != NULL) free(lengths);
+   if(redundant   != NULL) free(redundant);
+   return((nSizes > 0) ? sizes[best].fragSize : 0);
+}
+
+
+/************************************************************************/
+/*>static BOOL HashSample(char **seqs, int *lengths, int nSeqs,
+                          char *redundant, int fragSize, int window, 
+                          BOOL dna, TUNEWORK *work)
+   ---------------------------------------------------------------
+   Input:     char     **seqs      Sampled sequences
+              int      *lengths    Their lengths
+              int      nSeqs       Number of sequences
+              char     *redundant  Which are contained in another
+              int      fragSize    Fragment size
+              int      window      Minimizer window (-w)
+              BOOL     dna         Are they DNA?
+   I/O:       TUNEWORK *work       Hashes and flags filled in and the
+                                   counts made in the table
+   Returns:   BOOL                 Success?
+
+   Hashes every fragment of the sequences which aren't redundant and
+   flags those which nr would probe and those which it would try as 
+   anchors first, then counts the flagged ones in a table sized for 
+   them.
+
+   19.10.26 Original
+*/
+static BOOL HashSample(char **seqs, int *lengths, int nSeqs,
+                       char *redundant, int fragSize, int window, 
+                       BOOL dna, TUNEWORK *work)
+{
+   KMERHASHFN    hash     = (dna ? CanonicalHash : KmerHash);
+   FRAGCOUNT     *count;
+   unsigned long *hashes;
+   char          *isMin;
+   long          f        = 0,
+                 nFlagged = 0,
+                 nFrags;
+   int           nMin     = 0,
+                 n, s, i;
+
+   for(s=0; s<nSeqs; s++)
+   {
+      if(redundant[s] || ((n = NFrags(lengths[s], fragSize, dna)) < 1))
+         continue;
+
+      if(window && 
+         ((nMin = FindMinimizers(seqs[s], n, fragSize-1, window, hash,
+                                 &hashes, &isMin)) < 0))
+         return(FALSE);
+
+      for(i=0; i<n; i++, f++)
+      {
+         if(window)
+         {
+            work->hashes[f] = hashes[i];
+            work->flags[f]  = (isMin[i] ? FRAG_PROBED : 0);
+            if(nMin ? isMin[i] : (i == 0))
+               work->flags[f] |= FRAG_ANCHOR;
+         }
+         else
+         {
+            work->hashes[f] = (*hash)(seqs[s]+i, fragSize-1);
+            work->flags[f]  = FRAG_PROBED | ((i == 0) ? FRAG_ANCHOR : 0);
+         }
+         if(work->flags[f])
+            nFlagged++;
+      }
+   }
+   nFrags = f;
+
+   for(work->mask=1024; 
+       (work->mask < 2*nFlagged) && (work->mask <= work->maxMask); 
+       work->mask *= 2);
+   work->mask--;
+   memset(work->table, 0, (work->mask+1) * sizeof(FRAGCOUNT));
+
+   for(f=0; f<nFrags; f++)
+   {
+      if(work->flags[f])
+      {
+         count = FindCount(work, work->hashes[f]);
+         if(!count->used)
+         {
+            count->used = TRUE;
+            count->hash = work->hashes[f];
+            count->last = count->seen = (-1);
+         }
+         if(work->flags[f] & FRAG_PROBED)
+            count->probes++;
+         if(work->flags[f] & FRAG_ANCHOR)
+            count->anchors++;
+      }
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void TrySize(int *lengths, int nSeqs, char *redundant, 
+                       long nTotal, int nKept, BOOL dna, TUNEWORK *work,
+                       FRAGTUNING *size)
+   ---------------------------------------------------------------------
+   Input:     int        *lengths    Lengths of the sampled sequences
+              int        nSeqs       Number of sequences
+              char       *redundant  Which are contained in another
+              long       nTotal      Estimated sequences in the input
+              int        nKept       Sampled sequences not redundant
+              BOOL       dna         Are they DNA?
+              TUNEWORK   *work       From HashSample()
+   I/O:       FRAGTUNING *size       fragSize in, the rest filled in
+                                     (cost in absolute terms)
+
+   Estimates the collision rate, fan-out, W003 losses and cost from the
+   counts made by HashSample() as described at the top of the file.
+
+   19.10.26 Original
+*/
+static void TrySize(int *lengths, int nSeqs, char *redundant, 
+                    long nTotal, int nKept, BOOL dna, TUNEWORK *work,
+                    FRAGTUNING *size)
+{
+   FRAGCOUNT *count;
+   double    cross    = 0.0,
+             nOnce    = 0.0,
+             nTwice   = 0.0,
+             pOnce,
+             risk     = 0.0,
+             logRisk,
+             hashCost = 0.0,
+             p, x;
+   long      nProbes  = 0,
+             nAnchors = 0,
+             first,
+             f        = 0;
+   int       fragSize = size->fragSize,
+             own,
+             n, s, i;
+
+   for(i=0; i<=(int)work->mask; i++)
+   {
+      count = &(work->table[i]);
+      if(count->used)
+      {
+         nProbes  += count->probes;
+         nAnchors += count->anchors;
+         cross    += (double)count->probes * (double)count->anchors;
+         if(count->anchors == 1)
+            nOnce++;
+         else if(count->anchors == 2)
+            nTwice++;
+      }
+   }
+
+   /* Good-Turing estimate of the frequency of an anchor seen once      */
+   pOnce = ((nOnce > 0.0) && nAnchors) ? 
+           (2.0 * nTwice / nOnce) / (double)nAnchors : 0.0;
+
+   for(s=0; s<nSeqs; s++)
+   {
+      if(redundant[s] || ((n = NFrags(lengths[s], fragSize, dna)) < 1))
+         continue;
+      hashCost += (double)n * (fragSize-1);
+
+      /* Count each fragment's occurrences in this sequence, leaving out
+         probes which would only find the sequence itself
+      */
+      for(i=0, first=f; i<n; i++, f++)
+      {
+         if(!work->flags[f])
+            continue;
+         count = FindCount(work, work->hashes[f]);
+         if(count->last != s)
+         {
+            count->last      = s;
+            count->ownProbes = count->ownAnchors = 0;
+         }
+         if(work->flags[f] & FRAG_PROBED)
+         {
+            cross -= count->ownAnchors;
+            count->ownProbes++;
+         }
+         if(work->flags[f] & FRAG_ANCHOR)
+         {
+            cross -= count->ownProbes;
+            count->ownAnchors++;
+         }
+      }
+
+      /* Find the chance that every distinct fragment is taken by 
+         another sequence. A fragment which isn't in the table hasn't
+         been seen as an anchor
+      */
+      logRisk = 0.0;
+      for(i=0, f=first; i<n; i++, f++)
+      {
+         count = FindCount(work, work->hashes[f]);
+         if(count->used)
+         {
+            if(count->seen == s)
+               continue;
+            count->seen = s;
+            own = (count->last == s) ? count->ownAnchors : 0;
+            p   = (count->anchors > own) ?
+                  (double)(count->anchors - own) / (double)nAnchors : 
+                  pOnce;
+         }
+         else
+         {
+            p = pOnce;
+         }
+
+         if((x = p * (double)nTotal) <= 0.0)
+            break;
+         logRisk += (x < SMALL_X) ? log(x) : log(1.0 - exp(-x));
+         if(logRisk < LOG_TINY)
+            break;
+      }
+      if((i == n) && (logRisk >= LOG_TINY))
+         risk += exp(logRisk);
+      f = first + n;
+   }
+
+   size->collisionRate = (nProbes && nAnchors) ?
+                         cross / ((double)nProbes * (double)nAnchors) :
+                         0.0;
+   size->fanOut        = size->collisionRate * (double)nTotal;
+   size->w003Losses    = nKept ? (risk / nKept) * 
+                                 ((double)nTotal * nKept / nSeqs) : 0.0;
+   size->cost          = nKept ? (hashCost + 
+                                  (double)nProbes * 
+                                  (TUNE_PROBE_COST + 
+                                   TUNE_FETCH_COST * size->fanOut)) /
+                                 nKept : 0.0;
+}
+
+
+/************************************************************************/
+/*>static int MarkRedundant(char **seqs, int *lengths, int nSeqs, 
+                            int fragSize, BOOL dna, char *redundant)
+   ---------------------------------------------------------------
+   Input:     char   **seqs      Sampled sequences
+              int    *lengths    Their lengths
+              int    nSeqs       Number of sequences
+              int    fragSize    Fragment size used to find candidates
+              BOOL   dna         Are they DNA (either strand)?
+   Output:    char   *redundant  Set for each sequence contained in 
+                                 another (of two identical sequences,
+                                 the later one)
+   Returns:   int                Number of redundant sequences (-1 if
+                                 out of memory)
+
+   Each sequence is only checked against the sequences which contain
+   its first fragment.
+
+   19.10.26 Original
+*/
+static int MarkRedundant(char **seqs, int *lengths, int nSeqs, 
+                         int fragSize, BOOL dna, char *redundant)
+{
+   KMERHASHFN    hash   = (dna ? CanonicalHash : KmerHash);
+   FRAGSEQ       *frags,
+                 key,
+                 *found;
+   long          nFrags = 0,
+                 f;
+   int           nRedundant = 0,
+                 n, s, t, i;
+
+   for(s=0; s<nSeqs; s++)
+      nFrags += lengths[s] - fragSize + 1;
+   if((frags = (FRAGSEQ *)malloc((nFrags+1) * sizeof(FRAGSEQ)))==NULL)
+      return(-1);
+
+   for(s=0, f=0; s<nSeqs; s++)
+   {
+      n = lengths[s] - fragSize + 1;
+      for(i=0; i<n; i++, f++)
+      {
+         frags[f].hash = (*hash)(seqs[s]+i, fragSize);
+         frags[f].seq  = s;
+      }
+   }
+   qsort(frags, nFrags, sizeof(FRAGSEQ), CompareFragSeqs);
+
+   for(s=0; s<nSeqs; s++)
+   {
+      key.hash = (*hash)(seqs[s], fragSize);
+      key.seq  = (-1);
+      if((found = (FRAGSEQ *)bsearch(&key, frags, nFrags, 
+                                     sizeof(FRAGSEQ), CompareHashes))
+         == NULL)
+         continue;
+
+      /* Back to the first with this hash                              */
+      for(f=found-frags; (f > 0) && (frags[f-1].hash == key.hash); f--);
+      for(; (f < nFrags) && (frags[f].hash == key.hash); f++)
+      {
+         t = frags[f].seq;
+         if((t == s) || (lengths[t] < lengths[s]) ||
+            ((lengths[t] == lengths[s]) && (t > s)) ||
+            ((f > 0) && (frags[f-1].hash == key.hash) && 
+             (frags[f-1].seq == t)))
+            continue;
+         if((strstr(seqs[t], seqs[s]) != NULL) ||
+            (dna && ContainsRevComp(seqs[t], seqs[s])))
+         {
+            redundant[s] = 1;
+            nRedundant++;
+            break;
+         }
+      }
+   }
+
+   free(frags);
+   return(nRedundant);
+}
+
+
+/************************************************************************/
+/*>static FRAGCOUNT *FindCount(TUNEWORK *work, unsigned long hash)
+   ---------------------------------------------------------------
+   Input:     TUNEWORK  *work     Holds the hash table of counts
+              unsigned long hash  Fragment hash
+   Returns:   FRAGCOUNT *         Its entry (not used if it isn't in 
+                                  the table)
+
+   Linear probing. The table is never more than half full.
+
+   19.10.26 Original
+*/
+static FRAGCOUNT *FindCount(TUNEWORK *work, unsigned long hash)
+{
+   unsigned long slot = (hash ^ (hash >> 29)) & work->mask;
+
+   while(work->table[slot].used && (work->table[slot].hash != hash))
+      slot = (slot + 1) & work->mask;
+   return(&(work->table[slot]));
+}
+
+
+/************************************************************************/
+/*>static int NFrags(int length, int fragSize, BOOL dna)
+   -----------------------------------------------------
+   Input:     int    length     Sequence length
+              int    fragSize   Fragment size
+              BOOL   dna        DNA?
+   Returns:   int               Number of fragments nr may use as 
+                                anchors (as NFragments() in nr.c)
+
+   19.10.26 Original
+*/
+static int NFrags(int length, int fragSize, BOOL dna)
+{
+   return(dna ? (length - (fragSize-1) + 1) : (length - fragSize));
+}
+
+
+/************************************************************************/
+/*>static int CompareFragSeqs(const void *p1, const void *p2)
+   ----------------------------------------------------------
+   qsort() comparison of FRAGSEQs by hash then sequence, so that the
+   fragments of each sequence with the same hash are together
+
+   19.10.26 Original
+*/
+static int CompareFragSeqs(const void *p1, const void *p2)
+{
+   int result = CompareHashes(p1, p2);
+
+   if(result)
+      return(result);
+   return(((FRAGSEQ *)p1)->seq - ((FRAGSEQ *)p2)->seq);
+}
+
+
+/************************************************************************/
+/*>static int CompareHashes(const void *p1, const void *p2)
+   --------------------------------------------------------
+   bsearch() comparison of FRAGSEQs by hash alone
+
+   19.10.26 Original
+*/
+static int CompareHashes(const void *p1, const void *p2)
+{
+   unsigned long h1 = ((FRAGSEQ *)p1)->hash,
+                 h2 = ((FRAGSEQ *)p2)->hash;
+
+   return((h1 < h2) ? (-1) : ((h1 > h2) ? 1 : 0));
+}
@@ -0,0 +1,74 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       fragtune.h
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Choose a fragment size from a sample of the input
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+#ifndef _NR_FRAGTUNE_H
+#define _NR_FRAGTUNE_H
+
+#include "bioplib/SysDefs.h"
+#include "metrics.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define TUNE_SAMPLE       1000   /* Sequences sampled from the input    */
+#define TUNE_CHUNKS       16     /* Places they are taken from          */
+#define TUNE_MIN_FRAGSIZE 5      /* Range of fragment sizes tried       */
+#define TUNE_MAX_FRAGSIZE 32
+#define TUNE_MAX_LOSSES   0.5    /* Expected W003 losses for a size to
+                                    count as safe                       */
+#define TUNE_PROBE_COST   200    /* Costs (roughly ns) of a fragment 
+                                    probe...                            */
+#define TUNE_FETCH_COST   4000   /* ...and of reading back and comparing
+                                    a candidate, against 1 for each
+                                    residue hashed                      */
+#define TUNE_PATIENCE     3      /* Sizes tried after the fastest       */
+#define TUNE_REASON       160    /* Space for the reason for the choice */
+
+/************************************************************************/
+/* Prototypes
+*/
+int TuneFragSize(char **seqs, int nSeqs, long nTotal, int minSize,
+                 int maxSize, int window, BOOL dna, FRAGTUNING *sizes, 
+                 int *nTried, int *nRedundant, char *reason);
+
+#endif
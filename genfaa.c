@@ -0,0 +1,503 @@
+/*************************************************************************
+
+   Program:    genfaa
+   File:       genfaa.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Generate synthetic protein FASTA files for benchmarking nr
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Writes a protein FASTA file of a given number of sequences. A given
+   fraction of the sequences are redundant, being exact copies,
+   fragments or extensions of a sequence written earlier. Redundant
+   sequences may themselves be used as the source of further redundant
+   sequences up to the specified containment-chain depth.
+
+   Sequence lengths are drawn from a log-normal distribution and a
+   fraction of the residues may be replaced by X.
+
+   The output depends only on the options and the random seed, so the
+   same command always produces the same file.
+
+**************************************************************************
+
+   Usage:
+   ======
+   genfaa [-n nseq] [-r redundancy] [-c depth] [-l meanlen]
+          [-m minlen] [-M maxlen] [-x xfrac] [-s seed] [-p prefix]
+          [out.faa]
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define DEFAULT_NSEQ        10000
+#define DEFAULT_REDUNDANCY  0.3
+#define DEFAULT_DEPTH       3
+#define DEFAULT_MEANLEN     350
+#define DEFAULT_MINLEN      31
+#define DEFAULT_MAXLEN      5000
+#define DEFAULT_XFRAC       0.001
+#define DEFAULT_SEED        1
+#define DEFAULT_PREFIX      "SYN"
+#define MAXPREFIX           16
+#define POOLSIZE            4096
+#define LINELEN             60
+#define LOGNORMAL_SIGMA     0.6
+
+/* Residues weighted roughly by their natural abundance                 */
+#define RESIDUES "AAAAAAAACCDDDDDEEEEEEFFFFGGGGGGGHHIIIIIKKKKKKLLLLLLLLLLMMMNNNN\
+PPPPPQQQQRRRRRSSSSSSSTTTTTTVVVVVVVWYYYY"
+
+/************************************************************************/
+/* Globals
+*/
+static unsigned long sRandState = DEFAULT_SEED;
+static char          sPrefix[MAXPREFIX] = DEFAULT_PREFIX;
+
+typedef struct
+{
+   char *seq;
+   int  len,
+        depth;
+}  POOLENTRY;
+
+/************************************************************************/
+/* Prototypes
+*/
+int main(int argc, char **argv);
+void Usage(void);
+unsigned long Random(void);
+double RandomUniform(void);
+int RandomLength(int meanLen, int minLen, int maxLen);
+char *RandomSequence(int len, double xFrac);
+char *DeriveSequence(POOLENTRY *source, int minLen, int maxLen,
+                     int *newLen);
+void WriteSequence(FILE *out, int num, char *seq, int len, int depth);
+
+/************************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+   Main program
+
+   19.10.26 Original
+*/
+int main(int argc, char **argv)
+{
+   int       nSeq     = DEFAULT_NSEQ,
+             maxDepth = DEFAULT_DEPTH,
+             meanLen  = DEFAULT_MEANLEN,
+             minLen   = DEFAULT_MINLEN,
+             maxLen   = DEFAULT_MAXLEN,
+             nPool    = 0,
+             i, len;
+   double    redundancy = DEFAULT_REDUNDANCY,
+             xFrac      = DEFAULT_XFRAC;
+   FILE      *out     = stdout;
+   POOLENTRY pool[POOLSIZE],
+             *source;
+   char      *seq;
+
+   for(argc--, argv++; argc && argv[0][0]=='-'; argc--, argv++)
+   {
+      if(argc < 2)
+      {
+         Usage();
+         return(1);
+      }
+
+      switch(argv[0][1])
+      {
+      case 'n':
+         nSeq = atoi(argv[1]);
+         break;
+      case 'r':
+         redundancy = atof(argv[1]);
+         break;
+      case 'c':
+         maxDepth = atoi(argv[1]);
+         break;
+      case 'l':
+         meanLen = atoi(argv[1]);
+         break;
+      case 'm':
+         minLen = atoi(argv[1]);
+         break;
+      case 'M':
+         maxLen = atoi(argv[1]);
+         break;
+      case 'x':
+         xFrac = atof(argv[1]);
+         break;
+      case 's':
+         sRandState = (unsigned long)atol(argv[1]);
+         break;
+      case 'p':
+         strncpy(sPrefix, argv[1], MAXPREFIX);
+         sPrefix[MAXPREFIX-1] = '\0';
+         break;
+      default:
+         Usage();
+         return(1);
+      }
+      argc--;
+      argv++;
+   }
+
+   if((minLen < 1) || (maxLen < minLen))
+   {
+      Usage();
+      return(1);
+   }
+
+   if(argc)
+   {
+      if((out=fopen(argv[0],"w"))==NULL)
+      {
+         fprintf(stderr,"Can't write %s\n", argv[0]);
+         return(1);
+      }
+   }
+
+   for(i=0; i<nSeq; i++)
+   {
+      source = NULL;
+      if(nPool && (RandomUniform() < redundancy))
+      {
+         source = &(pool[Random() % nPool]);
+         if(source->depth >= maxDepth)
+            source = NULL;
+      }
+
+      if(source != NULL)
+      {
+         if((seq = DeriveSequence(source, minLen, maxLen, &len))==NULL)
+            return(1);
+         WriteSequence(out, i, seq, len, source->depth + 1);
+      }
+      else
+      {
+         len = RandomLength(meanLen, minLen, maxLen);
+         if((seq = RandomSequence(len, xFrac))==NULL)
+            return(1);
+         WriteSequence(out, i, seq, len, 0);
+      }
+
+      /* Keep a bounded pool of recent sequences to derive from         */
+      if(nPool < POOLSIZE)
+      {
+         pool[nPool].seq   = seq;
+         pool[nPool].len   = len;
+         pool[nPool].depth = (source==NULL)?0:(source->depth + 1);
+         nPool++;
+      }
+      else
+      {
+         int slot = Random() % POOLSIZE;
+         int depth = (source==NULL)?0:(source->depth + 1);
+         free(pool[slot].seq);
+         pool[slot].seq   = seq;
+         pool[slot].len   = len;
+         pool[slot].depth = depth;
+      }
+   }
+
+   if(out != stdout)
+      fclose(out);
+
+   return(0);
+}
+
+
+/************************************************************************/
+/*>unsigned long Random(void)
+   --------------------------
+   Returns:   unsigned long      Pseudo-random 32-bit value
+
+   A 32-bit xorshift generator. Masked so that the sequence is the same
+   whatever the size of an unsigned long.
+
+   19.10.26 Original
+*/
+unsigned long Random(void)
+{
+   unsigned long x = sRandState & 0xFFFFFFFFUL;
+
+   if(x == 0)
+      x = 0x9E3779B9UL;
+   x ^= (x << 13) & 0xFFFFFFFFUL;
+   x ^= (x >> 17);
+   x ^= (x << 5)  & 0xFFFFFFFFUL;
+   sRandState = x;
+   return(x);
+}
+
+
+/************************************************************************/
+/*>double RandomUniform(void)
+   --------------------------
+   Returns:   double       Pseudo-random value in the range [0,1)
+
+   19.10.26 Original
+*/
+double RandomUniform(void)
+{
+   return((double)Random() / 4294967296.0);
+}
+
+
+/************************************************************************/
+/*>int RandomLength(int meanLen, int minLen, int maxLen)
+   -----------------------------------------------------
+   Input:     int    meanLen    Mean length
+              int    minLen     Minimum length
+              int    maxLen     Maximum length
+   Returns:   int               A sequence length
+
+   Draws a length from a log-normal distribution with the given mean,
+   clipped to the given range. The normal deviate is approximated by
+   the sum of 12 uniform deviates.
+
+   19.10.26 Original
+*/
+int RandomLength(int meanLen, int minLen, int maxLen)
+{
+   double z  = -6.0,
+          mu;
+   int    i,
+          len;
+
+   for(i=0; i<12; i++)
+      z += RandomUniform();
+
+   mu  = log((double)meanLen) - (LOGNORMAL_SIGMA * LOGNORMAL_SIGMA / 2.0);
+   len = (int)exp(mu + LOGNORMAL_SIGMA * z);
+
+   if(len < minLen) len = minLen;
+   if(len > maxLen) len = maxLen;
+   return(len);
+}
+
+
+/************************************************************************/
+/*>char *RandomSequence(int len, double xFrac)
+   -------------------------------------------
+   Input:     int    len        Sequence length
+              double xFrac      Fraction of residues to set to X
+   Returns:   char   *          Malloc'd sequence
+
+   19.10.26 Original
+*/
+char *RandomSequence(int len, double xFrac)
+{
+   static int nRes = 0;
+   char       *seq;
+   int        i;
+
+   if(nRes == 0)
+      nRes = strlen(RESIDUES);
+
+   if((seq = (char *)malloc((len+1) * sizeof(char)))==NULL)
+   {
+      fprintf(stderr,"No memory for sequence\n");
+      return(NULL);
+   }
+
+   for(i=0; i<len; i++)
+   {
+      if((xFrac > 0.0) && (RandomUniform() < xFrac))
+         seq[i] = 'X';
+      else
+         seq[i] = RESIDUES[Random() % nRes];
+   }
+   seq[len] = '\0';
+
+   return(seq);
+}
+
+
+/************************************************************************/
+/*>char *DeriveSequence(POOLENTRY *source, int minLen, int maxLen,
+                        int *newLen)
+   ---------------------------------------------------------------
+   Input:     POOLENTRY *source   Sequence to derive from
+              int       minLen    Minimum length
+              int       maxLen    Maximum length
+   Output:    int       *newLen   Length of new sequence
+   Returns:   char      *         Malloc'd sequence
+
+   Creates a redundant sequence from the source. This is an exact copy,
+   a fragment of the source, or the source extended at either end, in
+   roughly equal proportions.
+
+   19.10.26 Original
+*/
+char *DeriveSequence(POOLENTRY *source, int minLen, int maxLen,
+                     int *newLen)
+{
+   char *seq,
+        *extra;
+   int  start,
+        len,
+        nTerm,
+        cTerm;
+
+   switch(Random() % 3)
+   {
+   case 0:                                  /* Exact copy               */
+      len   = source->len;
+      start = 0;
+      break;
+   case 1:                                  /* Fragment                 */
+      len = source->len;
+      if(len > minLen)
+      {
+         len = minLen + (Random() % (source->len - minLen + 1));
+      }
+      start = Random() % (source->len - len + 1);
+      break;
+   default:                                 /* Extension                */
+      nTerm = Random() % 20;
+      cTerm = Random() % 20;
+      len   = source->len + nTerm + cTerm;
+      if(len > maxLen)
+      {
+         nTerm = cTerm = 0;
+         len   = source->len;
+      }
+      if((seq = (char *)malloc((len+1) * sizeof(char)))==NULL)
+      {
+         fprintf(stderr,"No memory for sequence\n");
+         return(NULL);
+      }
+      if((extra = RandomSequence(nTerm + cTerm, 0.0))==NULL)
+         return(NULL);
+      strncpy(seq, extra, nTerm);
+      strcpy(seq + nTerm, source->seq);
+      strcpy(seq + nTerm + source->len, extra + nTerm);
+      free(extra);
+      *newLen = len;
+      return(seq);
+   }
+
+   if((seq = (char *)malloc((len+1) * sizeof(char)))==NULL)
+   {
+      fprintf(stderr,"No memory for sequence\n");
+      return(NULL);
+   }
+   strncpy(seq, source->seq + start, len);
+   seq[len] = '\0';
+   *newLen = len;
+   return(seq);
+}
+
+
+/************************************************************************/
+/*>void WriteSequence(FILE *out, int num, char *seq, int len, int depth)
+   ---------------------------------------------------------------------
+   Input:     FILE   *out     Output file pointer
+              int    num      Sequence number
+              char   *seq     Sequence
+              int    len      Sequence length
+              int    depth    Containment-chain depth
+
+   Write a sequence in FASTA format with a GenBank-style header
+
+   19.10.26 Original
+*/
+void WriteSequence(FILE *out, int num, char *seq, int len, int depth)
+{
+   int i;
+
+   fprintf(out,">gb|%s%08d.1|%s%08d Synthetic sequence, depth %d.\n",
+           sPrefix, num, sPrefix, num, depth);
+   for(i=0; i<len; i+=LINELEN)
+   {
+      fprintf(out,"%.*s\n", LINELEN, seq+i);
+   }
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+   Write a usage message
+
+   19.10.26 Original
+*/
+void Usage(void)
+{
+   fprintf(stderr,"\ngenfaa V1.0 (c) 2000 Dr. Andrew C.R. Martin, \
+University of Reading.\n");
+   fprintf(stderr,"\nUsage: genfaa [-n nseq] [-r redundancy] [-c depth] \
+[-l meanlen] [-m minlen]\n");
+   fprintf(stderr,"              [-M maxlen] [-x xfrac] [-s seed] \
+[-p prefix] [out.faa]\n");
+   fprintf(stderr,"       -n  Number of sequences (default: %d)\n",
+           DEFAULT_NSEQ);
+   fprintf(stderr,"       -r  Fraction of redundant sequences \
+(default: %.2f)\n", DEFAULT_REDUNDANCY);
+   fprintf(stderr,"       -c  Maximum containment-chain depth \
+(default: %d)\n", DEFAULT_DEPTH);
+   fprintf(stderr,"       -l  Mean sequence length (default: %d)\n",
+           DEFAULT_MEANLEN);
+   fprintf(stderr,"       -m  Minimum sequence length (default: %d)\n",
+           DEFAULT_MINLEN);
+   fprintf(stderr,"       -M  Maximum sequence length (default: %d)\n",
+           DEFAULT_MAXLEN);
+   fprintf(stderr,"       -x  Fraction of residues set to X \
+(default: %.3f)\n", DEFAULT_XFRAC);
+   fprintf(stderr,"       -s  Random seed (default: %d)\n",
+           DEFAULT_SEED);
+   fprintf(stderr,"       -p  Identifier prefix (default: %s)\n",
+           DEFAULT_PREFIX);
+   fprintf(stderr,"\nWrites a deterministic synthetic protein FASTA file \
+for benchmarking nr.\n");
+   fprintf(stderr,"Redundant sequences are exact copies, fragments or \
+extensions of earlier\n");
+   fprintf(stderr,"sequences.\n\n");
+}
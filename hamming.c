@@ -0,0 +1,131 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       hamming.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Word-at-a-time mismatch counting
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Counts the mismatches between two equal-length stretches of sequence
+   for the -k (mismatch) mode of nr.
+
+   Rather than comparing a character at a time, the sequences are
+   compared a machine word (sizeof(unsigned long) residues) at a time.
+   The two words are XORed and, without any branches, the top bit of
+   each byte that differs is set and all other bits cleared. The 
+   number of set bits is then the number of mismatches in the word.
+   Since near-identical sequences match over nearly all their length,
+   nearly every word XORs to zero and costs a single test.
+
+   Only plain C is used, so this works for any size of unsigned long
+   and needs no particular instruction set.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <string.h>
+#include "hamming.h"
+
+/************************************************************************/
+/*>int CountMismatches(char *seq1, char *seq2, int length, 
+                       int maxMismatch)
+   ------------------------------------------------------
+   Input:     char   *seq1         First sequence
+              char   *seq2         Second sequence
+              int    length        Number of residues to compare
+              int    maxMismatch   Stop once more than this many 
+                                   mismatches have been found
+   Returns:   int                  Number of mismatches (or a number
+                                   greater than maxMismatch)
+
+   Counts the positions in the first length residues at which the two
+   sequences differ.
+
+   19.10.26 Original
+*/
+int CountMismatches(char *seq1, char *seq2, int length, int maxMismatch)
+{
+   unsigned long word1,
+                 word2,
+                 diff,
+                 ones,
+                 low7,
+                 high;
+   int           count    = 0,
+                 wordSize = (int)sizeof(unsigned long),
+                 i;
+
+   /* 0x0101...01, 0x7F7F...7F and 0x8080...80 for this word size       */
+   ones = (~0UL) / 0xFF;
+   low7 = ones * 0x7F;
+   high = ones * 0x80;
+
+   for(i=0; i+wordSize <= length; i+=wordSize)
+   {
+      /* memcpy() since the sequences need not be word aligned          */
+      memcpy(&word1, seq1+i, wordSize);
+      memcpy(&word2, seq2+i, wordSize);
+
+      if((diff = word1 ^ word2) != 0)
+      {
+         /* Set the top bit of each non-zero byte and clear the rest    */
+         diff = (((diff & low7) + low7) | diff) & high;
+         
+         /* Count them                                                  */
+         while(diff)
+         {
+            diff &= (diff - 1);
+            count++;
+         }
+         if(count > maxMismatch)
+            return(count);
+      }
+   }
+
+   /* The last few residues                                             */
+   for(; i<length; i++)
+   {
+      if(seq1[i] != seq2[i])
+         count++;
+   }
+
+   return(count);
+}
@@ -0,0 +1,287 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       idrule.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Rules for finding the identifier in a FASTA header
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Finds the identifier of a sequence in its FASTA header. The rule is
+   chosen once, by name, from the table below and FindID() then just
+   calls its function. The identifier is returned as a pointer into the
+   header and a length, so nothing is copied and there is no limit on
+   its length. Trailing newlines (and carriage returns) are ignored.
+
+   The rules are:
+
+   ncbi     The text after the first | up to the next one (e.g.
+            gb|AJ133789.1|AAC133789 gives AJ133789.1). For PDB 
+            entries (pdb|1ABC|A) the first character of the chain is
+            kept, giving 1ABC|A. A header with no | is taken whole.
+            This is what nr has always done.
+   uniprot  The accession from sp|P12345|NAME_HUMAN (or any other
+            db|ACCESSION|NAME header), otherwise the first word.
+   pdb      The first word of a PDB seqres header (101m_A mol:protein
+            ...), or 1ABC|A from pdb|1ABC|A keeping the whole chain
+            name.
+   token    The first word of the header.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <string.h>
+#include "idrule.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define ISSPACE(c) (((c) == ' ') || ((c) == '\t'))
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct
+{
+   char *name;
+   char *(*find)(char *start, char *end, int *idLength);
+}  IDRULE;
+
+/************************************************************************/
+/* Prototypes
+*/
+static char *FindNCBI(char *start, char *end, int *idLength);
+static char *FindUniProt(char *start, char *end, int *idLength);
+static char *FindPDB(char *start, char *end, int *idLength);
+static char *FindToken(char *start, char *end, int *idLength);
+static char *WordEnd(char *start, char *end);
+
+/************************************************************************/
+/* Globals
+*/
+static IDRULE sRules[] =
+{  {"ncbi",    FindNCBI},        /* In the order of the IDRULE_ values  */
+   {"uniprot", FindUniProt},
+   {"pdb",     FindPDB},
+   {"token",   FindToken},
+   {NULL,      NULL}
+};
+
+
+/************************************************************************/
+/*>int IDRuleFromName(char *name)
+   ------------------------------
+   Input:     char   *name      Name of a rule
+   Returns:   int               The rule (IDRULE_NCBI etc., -1 if there
+                                isn't one of that name)
+
+   19.10.26 Original
+*/
+int IDRuleFromName(char *name)
+{
+   int rule;
+
+   for(rule=0; sRules[rule].name != NULL; rule++)
+   {
+      if(!strcmp(sRules[rule].name, name))
+         return(rule);
+   }
+   return(-1);
+}
+
+
+/************************************************************************/
+/*>char *FindID(char *header, int length, int rule, int *idLength)
+   ---------------------------------------------------------------
+   Input:     char   *header    Header line (starting with >)
+              int    length     Its length
+              int    rule       Rule from IDRuleFromName()
+   Output:    int    *idLength  Length of the identifier
+   Returns:   char   *          Start of the identifier in the header
+
+   19.10.26 Original
+*/
+char *FindID(char *header, int length, int rule, int *idLength)
+{
+   char *end = header + length;
+
+   while((end > header+1) && ((end[-1] == '\n') || (end[-1] == '\r')))
+      end--;
+
+   return((*sRules[rule].find)(header+1, end, idLength));
+}
+
+
+/************************************************************************/
+/*>static char *FindNCBI(char *start, char *end, int *idLength)
+   ------------------------------------------------------------
+   Input:     char   *start     Header after the >
+              char   *end       End of the header
+   Output:    int    *idLength  Length of the identifier
+   Returns:   char   *          Start of the identifier
+
+   The ncbi rule
+
+   19.10.26 Original (from the code in ReadSequences())
+*/
+static char *FindNCBI(char *start, char *end, int *idLength)
+{
+   char *id,
+        *bar;
+
+   if((bar = (char *)memchr(start, '|', end-start)) == NULL)
+   {
+      *idLength = (int)(end - start);
+      return(start);
+   }
+   
+   id = bar+1;
+   if((bar = (char *)memchr(id, '|', end-id)) != NULL)
+   {
+      /* For PDB we need to take the chain name if specified            */
+      if(!strncmp(start, "pdb", 3) && (bar+1 < end))
+         end = bar+2;
+      else
+         end = bar;
+   }
+   *idLength = (int)(end - id);
+   return(id);
+}
+
+
+/************************************************************************/
+/*>static char *FindUniProt(char *start, char *end, int *idLength)
+   ---------------------------------------------------------------
+   Input:     char   *start     Header after the >
+              char   *end       End of the header
+   Output:    int    *idLength  Length of the identifier
+   Returns:   char   *          Start of the identifier
+
+   The uniprot rule
+
+   19.10.26 Original
+*/
+static char *FindUniProt(char *start, char *end, int *idLength)
+{
+   char *id,
+        *bar;
+
+   end = WordEnd(start, end);
+   if((bar = (char *)memchr(start, '|', end-start)) == NULL)
+   {
+      *idLength = (int)(end - start);
+      return(start);
+   }
+
+   id = bar+1;
+   if((bar = (char *)memchr(id, '|', end-id)) != NULL)
+      end = bar;
+   *idLength = (int)(end - id);
+   return(id);
+}
+
+
+/************************************************************************/
+/*>static char *FindPDB(char *start, char *end, int *idLength)
+   -----------------------------------------------------------
+   Input:     char   *start     Header after the >
+              char   *end       End of the header
+   Output:    int    *idLength  Length of the identifier
+   Returns:   char   *          Start of the identifier
+
+   The pdb rule
+
+   19.10.26 Original
+*/
+static char *FindPDB(char *start, char *end, int *idLength)
+{
+   char *bar;
+
+   end = WordEnd(start, end);
+   if((end - start > 4) && !strncmp(start, "pdb|", 4))
+   {
+      start += 4;
+
+      /* Stop at any | after the chain name                             */
+      if(((bar = (char *)memchr(start, '|', end-start)) != NULL) &&
+         ((bar = (char *)memchr(bar+1, '|', end-bar-1)) != NULL))
+         end = bar;
+   }
+   *idLength = (int)(end - start);
+   return(start);
+}
+
+
+/************************************************************************/
+/*>static char *FindToken(char *start, char *end, int *idLength)
+   -------------------------------------------------------------
+   Input:     char   *start     Header after the >
+              char   *end       End of the header
+   Output:    int    *idLength  Length of the identifier
+   Returns:   char   *          Start of the identifier
+
+   The token rule
+
+   19.10.26 Original
+*/
+static char *FindToken(char *start, char *end, int *idLength)
+{
+   *idLength = (int)(WordEnd(start, end) - start);
+   return(start);
+}
+
+
+/************************************************************************/
+/*>static char *WordEnd(char *start, char *end)
+   --------------------------------------------
+   Input:     char   *start     Start of some text
+              char   *end       End of the text
+   Returns:   char   *          End of the first word
+
+   19.10.26 Original
+*/
+static char *WordEnd(char *start, char *end)
+{
+   char *ptr;
+
+   for(ptr=start; (ptr < end) && !ISSPACE(*ptr); ptr++);
+   return(ptr);
+}
@@ -0,0 +1,64 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       idrule.h
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Rules for finding the identifier in a FASTA header
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+#ifndef _NR_IDRULE_H
+#define _NR_IDRULE_H
+
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define IDRULE_NCBI      0       /* Text after the first |, PDB chains  */
+#define IDRULE_UNIPROT   1       /* Accession from db|ACCESSION|NAME    */
+#define IDRULE_PDB       2       /* 1ABC_A or pdb|1ABC|A                */
+#define IDRULE_TOKEN     3       /* First word of the header            */
+#define IDRULE_DEFAULT   IDRULE_NCBI
+
+/************************************************************************/
+/* Prototypes
+*/
+int  IDRuleFromName(char *name);
+char *FindID(char *header, int length, int rule, int *idLength);
+
+#endif
@@ -0,0 +1,535 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       libnr.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Library interface to the nr engine
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Lets another program make sequences non-redundant without running
+   nr. A context (NRCONTEXT) owns a set of hashes. Sequences are added
+   to it from FASTA text in memory or from files, each batch being
+   treated as one of nr's input files, and once it is finalized the
+   surviving entries are read back one at a time.
+
+   The engine in nr.c keeps its state in globals, as do the Bloom
+   filter, the deleted sequence bitset and the extra anchor set. A
+   context holds its own copy of all of these and Swap() exchanges them
+   with the globals around each call, so any number of independent
+   contexts can be used in one process. Calls are serialized with a
+   lock, so contexts may be used from different threads but only one
+   call does any work at a time.
+
+   Text added from memory is copied to a memory buffer (seqfile.c)
+   which is kept until the context is freed, since the hashes only hold
+   the offset of each entry.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <gdbm.h>
+#include "bioplib/SysDefs.h"
+#include "libnr.h"
+#include "seqfile.h"
+#include "minimizer.h"
+#include "bloom.h"
+#include "tombstone.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define DEFAULT_FRAGSIZE   15    /* As nr.c                             */
+#define MAXBUFF           320
+#define DEFAULT_GDBM_DIR  "/tmp"
+
+#define SWAP(type, a, b)                                                 \
+   {  type _swap = (a);                                                  \
+      (a) = (b);                                                         \
+      (b) = _swap;                                                       \
+   }
+
+/************************************************************************/
+/* Structures
+*/
+struct _nrcontext
+{
+   GDBM_FILE  seqdata,           /* nr.c globals while swapped out      */
+              fragdata,
+              fragtable;
+   FILE       *keys;
+   long       keysEnd,
+              nTempSeqs,
+              nTempDups,
+              nSeqs,
+              nIndex,
+              nDead,
+              firstNew;
+   int        mismatches,
+              window,
+              idRule,
+              instance;
+   BOOL       dna;
+   char       unknown,
+              gdbmDir[MAXBUFF];
+   BLOOM      bloom;             /* Other modules' state                */
+   TOMBSTONES tombstones;
+   ANCHORS    anchors;
+   int        fragSize,          /* Settings used by the calls          */
+              rejectSize,
+              nBuffers;          /* Memory buffers added                */
+   REAL       identity;
+   BOOL       finalized,
+              started;           /* Reading back the survivors?         */
+   datum      key;               /* ID of the last survivor             */
+   char       *entry;            /* ...and its entry                    */
+};
+
+/************************************************************************/
+/* Globals in nr.c
+*/
+extern GDBM_FILE gDBF_seqdata,
+                 gDBF_fragdata,
+                 gDBF_fragtable;
+extern FILE      *gKeys;
+extern long      gKeysEnd,
+                 gNTempSeqs,
+                 gNTempDups,
+                 gNSeqs,
+                 gNIndex,
+                 gNDead,
+                 gFirstNew;
+extern int       gMismatches,
+                 gWindow,
+                 gIDRule,
+                 gInstance;
+extern BOOL      gDNA;
+extern char      gUnknown,
+                 gGDBMDir[];
+
+/************************************************************************/
+/* Globals
+*/
+static pthread_mutex_t sLock       = PTHREAD_MUTEX_INITIALIZER;
+static int             sNContexts  = 0;
+
+/************************************************************************/
+/* Prototypes
+*/
+static void Swap(NRCONTEXT *ctx);
+static void BufferName(NRCONTEXT *ctx, int buffer, char *name);
+
+/* In nr.c                                                              */
+BOOL CreateHashes(void);
+void CleanUp(void);
+BOOL NonRedundantise(char *file, BOOL loadOnly, int fragSize,
+                     int rejectSize);
+BOOL ClusterResults(REAL identity);
+char *GetSequence(datum content, BOOL full);
+long SequenceIndex(datum content);
+
+
+/************************************************************************/
+/*>void NrDefaultOptions(NROPTIONS *options)
+   -----------------------------------------
+   Output:    NROPTIONS *options   nr's default settings
+
+   19.10.26 Original
+*/
+void NrDefaultOptions(NROPTIONS *options)
+{
+   options->fragSize   = DEFAULT_FRAGSIZE;
+   options->rejectSize = 2 * DEFAULT_FRAGSIZE;
+   options->mismatches = 0;
+   options->window     = DEFAULT_WINDOW;
+   options->idRule     = IDRULE_DEFAULT;
+   options->identity   = 0.0;
+   options->dna        = FALSE;
+   options->tmpDir     = NULL;
+}
+
+
+/************************************************************************/
+/*>NRCONTEXT *NrCreate(NROPTIONS *options)
+   ---------------------------------------
+   Input:     NROPTIONS *options   Settings (NULL for the defaults)
+   Returns:   NRCONTEXT *          New context (NULL if the settings
+                                   aren't allowed, there is no memory or
+                                   the hashes can't be created)
+
+   Makes a new context and creates its hashes. The identity may be given
+   as a fraction or a percentage. As with nr, mismatches and clustering
+   can't be used for nucleotides.
+
+   19.10.26 Original
+*/
+NRCONTEXT *NrCreate(NROPTIONS *options)
+{
+   NRCONTEXT *ctx;
+   NROPTIONS defaults;
+   char      *dir;
+   BOOL      ok;
+
+   if(options == NULL)
+   {
+      NrDefaultOptions(&defaults);
+      options = &defaults;
+   }
+
+   if((options->fragSize < 2) || (options->mismatches < 0) ||
+      (options->window < 0) || (options->identity < 0.0) ||
+      (options->identity > 100.0) ||
+      (options->dna && (options->mismatches ||
+                        (options->identity > 0.0))))
+      return(NULL);
+
+   if((ctx = (NRCONTEXT *)calloc(1, sizeof(NRCONTEXT)))==NULL)
+      return(NULL);
+
+   ctx->mismatches = options->mismatches;
+   ctx->window     = options->window;
+   ctx->idRule     = options->idRule;
+   ctx->dna        = options->dna;
+   ctx->unknown    = (options->dna ? 'N' : 'X');
+   ctx->fragSize   = options->fragSize;
+   ctx->rejectSize = options->rejectSize;
+   ctx->identity   = options->identity;
+   if(ctx->identity > 1.0)         /* Given as a percentage             */
+      ctx->identity /= 100.0;
+
+   if(((dir = options->tmpDir) == NULL) &&
+      ((dir = getenv("NR_TMPDIR")) == NULL))
+      dir = DEFAULT_GDBM_DIR;
+   strncpy(ctx->gdbmDir, dir, MAXBUFF);
+   ctx->gdbmDir[MAXBUFF-1] = '\0';
+
+   pthread_mutex_lock(&sLock);
+   ctx->instance = ++sNContexts;
+   Swap(ctx);
+   if(!(ok = CreateHashes()))
+      CleanUp();
+   Swap(ctx);
+   pthread_mutex_unlock(&sLock);
+
+   if(!ok)
+   {
+      free(ctx);
+      return(NULL);
+   }
+   return(ctx);
+}
+
+
+/************************************************************************/
+/*>BOOL NrAddBuffer(NRCONTEXT *ctx, char *fasta, long length, BOOL isNR)
+   ---------------------------------------------------------------------
+   Input:     NRCONTEXT *ctx       Context
+              char      *fasta     FASTA text
+              long      length     Its length in bytes
+              BOOL      isNR       The text is already non-redundant (as
+                                   nr -n for the first file)
+   Returns:   BOOL                 Success?
+
+   Adds the sequences in a block of FASTA text. They are made
+   non-redundant against each other and everything added before,
+   exactly as if they had been given to nr as the next file. The text
+   is copied so the caller may reuse it.
+
+   19.10.26 Original
+*/
+BOOL NrAddBuffer(NRCONTEXT *ctx, char *fasta, long length, BOOL isNR)
+{
+   char name[MAXBUFF];
+   BOOL ok;
+
+   if(ctx->finalized)
+      return(FALSE);
+
+   pthread_mutex_lock(&sLock);
+   BufferName(ctx, ctx->nBuffers, name);
+   ok = AddSeqBuffer(name, fasta, length);
+   pthread_mutex_unlock(&sLock);
+   if(!ok)
+      return(FALSE);
+
+   ctx->nBuffers++;
+   return(NrAddFile(ctx, name, isNR));
+}
+
+
+/************************************************************************/
+/*>BOOL NrAddFile(NRCONTEXT *ctx, char *filename, BOOL isNR)
+   ---------------------------------------------------------
+   Input:     NRCONTEXT *ctx       Context
+              char      *filename  FASTA file (plain or bgzip'd)
+              BOOL      isNR       The file is already non-redundant
+   Returns:   BOOL                 Success?
+
+   Adds the sequences in a file, as nr does for each file it is given.
+   The file must not change until the context is freed.
+
+   19.10.26 Original
+*/
+BOOL NrAddFile(NRCONTEXT *ctx, char *filename, BOOL isNR)
+{
+   BOOL ok;
+
+   if(ctx->finalized)
+      return(FALSE);
+
+   pthread_mutex_lock(&sLock);
+   Swap(ctx);
+   ok = NonRedundantise(filename, isNR, ctx->fragSize, ctx->rejectSize);
+   Swap(ctx);
+   pthread_mutex_unlock(&sLock);
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>BOOL NrFinalize(NRCONTEXT *ctx)
+   -------------------------------
+   Input:     NRCONTEXT *ctx       Context
+   Returns:   BOOL                 Success?
+
+   Ends the adding of sequences, clustering the survivors if an identity
+   was given. NrNextSurvivor() may then be called.
+
+   19.10.26 Original
+*/
+BOOL NrFinalize(NRCONTEXT *ctx)
+{
+   BOOL ok = TRUE;
+
+   if(ctx->finalized)
+      return(TRUE);
+
+   pthread_mutex_lock(&sLock);
+   Swap(ctx);
+   if(ctx->identity > 0.0)
+      ok = ClusterResults(ctx->identity);
+   Swap(ctx);
+   pthread_mutex_unlock(&sLock);
+
+   ctx->finalized = TRUE;
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>BOOL NrNextSurvivor(NRCONTEXT *ctx, char **id, char **entry)
+   ------------------------------------------------------------
+   Input:     NRCONTEXT *ctx       Finalized context
+   Output:    char      **id       ID of the next non-redundant sequence
+              char      **entry    Its FASTA entry (header and sequence)
+   Returns:   BOOL                 Was there another one?
+
+   Reads the non-redundant sequences back in turn (in the order of the
+   sequence hash). The strings belong to the context and are only valid
+   until the next call.
+
+   19.10.26 Original
+*/
+BOOL NrNextSurvivor(NRCONTEXT *ctx, char **id, char **entry)
+{
+   datum next,
+         content;
+   BOOL  found = FALSE;
+
+   if(!ctx->finalized)
+      return(FALSE);
+
+   pthread_mutex_lock(&sLock);
+   Swap(ctx);
+   if(ctx->entry != NULL)
+   {
+      free(ctx->entry);
+      ctx->entry = NULL;
+   }
+
+   for(;;)
+   {
+      if(!ctx->started)
+      {
+         next = gdbm_firstkey(gDBF_seqdata);
+         ctx->started = TRUE;
+      }
+      else if(ctx->key.dptr != NULL)
+      {
+         next = gdbm_nextkey(gDBF_seqdata, ctx->key);
+         free(ctx->key.dptr);
+      }
+      else                       /* Already at the end                  */
+      {
+         break;
+      }
+
+      ctx->key = next;
+      if(next.dptr == NULL)
+         break;
+
+      content = gdbm_fetch(gDBF_seqdata, next);
+      if((content.dptr != NULL) && !IsTombstone(SequenceIndex(content)))
+         ctx->entry = GetSequence(content, TRUE);
+      if(content.dptr != NULL)
+         free(content.dptr);
+
+      if(ctx->entry != NULL)
+      {
+         found = TRUE;
+         break;
+      }
+   }
+   Swap(ctx);
+   pthread_mutex_unlock(&sLock);
+
+   if(found)
+   {
+      *id    = ctx->key.dptr;
+      *entry = ctx->entry;
+   }
+   return(found);
+}
+
+
+/************************************************************************/
+/*>void NrFree(NRCONTEXT *ctx)
+   ---------------------------
+   Input:     NRCONTEXT *ctx       Context
+
+   Removes the context's hashes and frees everything belonging to it
+
+   19.10.26 Original
+*/
+void NrFree(NRCONTEXT *ctx)
+{
+   char name[MAXBUFF];
+   int  i;
+
+   if(ctx == NULL)
+      return;
+
+   pthread_mutex_lock(&sLock);
+   Swap(ctx);
+   CleanUp();
+   Swap(ctx);
+
+   FreeBloom(&(ctx->bloom));
+   FreeTombstones(&(ctx->tombstones));
+   FreeExtraAnchors(&(ctx->anchors));
+   for(i=0; i<ctx->nBuffers; i++)
+   {
+      BufferName(ctx, i, name);
+      FreeSeqBuffer(name);
+   }
+   pthread_mutex_unlock(&sLock);
+
+   if(ctx->key.dptr != NULL)
+      free(ctx->key.dptr);
+   if(ctx->entry != NULL)
+      free(ctx->entry);
+   free(ctx);
+}
+
+
+/************************************************************************/
+/*>static void Swap(NRCONTEXT *ctx)
+   --------------------------------
+   I/O:       NRCONTEXT *ctx       Context
+
+   Exchanges the engine's globals with the context's copy of them.
+   Called (under sLock) before a call into nr.c to make the context the
+   current one and again afterwards to put back whatever was there.
+
+   19.10.26 Original
+*/
+static void Swap(NRCONTEXT *ctx)
+{
+   char dir[MAXBUFF];
+
+   SWAP(GDBM_FILE, gDBF_seqdata,   ctx->seqdata);
+   SWAP(GDBM_FILE, gDBF_fragdata,  ctx->fragdata);
+   SWAP(GDBM_FILE, gDBF_fragtable, ctx->fragtable);
+   SWAP(FILE *,    gKeys,          ctx->keys);
+   SWAP(long,      gKeysEnd,       ctx->keysEnd);
+   SWAP(long,      gNTempSeqs,     ctx->nTempSeqs);
+   SWAP(long,      gNTempDups,     ctx->nTempDups);
+   SWAP(long,      gNSeqs,         ctx->nSeqs);
+   SWAP(long,      gNIndex,        ctx->nIndex);
+   SWAP(long,      gNDead,         ctx->nDead);
+   SWAP(long,      gFirstNew,      ctx->firstNew);
+   SWAP(int,       gMismatches,    ctx->mismatches);
+   SWAP(int,       gWindow,        ctx->window);
+   SWAP(int,       gIDRule,        ctx->idRule);
+   SWAP(int,       gInstance,      ctx->instance);
+   SWAP(BOOL,      gDNA,           ctx->dna);
+   SWAP(char,      gUnknown,       ctx->unknown);
+
+   strcpy(dir,          gGDBMDir);
+   strcpy(gGDBMDir,     ctx->gdbmDir);
+   strcpy(ctx->gdbmDir, dir);
+
+   SwapBloom(&(ctx->bloom));
+   SwapTombstones(&(ctx->tombstones));
+   SwapExtraAnchors(&(ctx->anchors));
+}
+
+
+/************************************************************************/
+/*>static void BufferName(NRCONTEXT *ctx, int buffer, char *name)
+   --------------------------------------------------------------
+   Input:     NRCONTEXT *ctx       Context
+              int       buffer     Number of the memory buffer
+   Output:    char      *name      Its name
+
+   The name isn't a real file and contains no spaces since it is stored
+   in the sequence hash along with the offset.
+
+   19.10.26 Original
+*/
+static void BufferName(NRCONTEXT *ctx, int buffer, char *name)
+{
+   sprintf(name, "@buffer.%d.%d", ctx->instance, buffer);
+}
@@ -0,0 +1,88 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       libnr.h
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Library interface to the nr engine
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+#ifndef _NR_LIBNR_H
+#define _NR_LIBNR_H
+
+#include "bioplib/SysDefs.h"
+#include "idrule.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct _nrcontext NRCONTEXT;
+
+typedef struct                   /* Settings for a context (as nr's
+                                    command line options)               */
+{
+   int  fragSize,                /* -f                                  */
+        rejectSize,              /* -r                                  */
+        mismatches,              /* -k                                  */
+        window,                  /* -w                                  */
+        idRule;                  /* -I (IDRULE_xxx)                     */
+   REAL identity;                /* -i (clusters in NrFinalize())       */
+   BOOL dna;                     /* -D                                  */
+   char *tmpDir;                 /* -d (NULL for NR_TMPDIR or /tmp)     */
+}  NROPTIONS;
+
+/************************************************************************/
+/* Prototypes
+*/
+void      NrDefaultOptions(NROPTIONS *options);
+NRCONTEXT *NrCreate(NROPTIONS *options);
+BOOL      NrAddBuffer(NRCONTEXT *ctx, char *fasta, long length,
+                      BOOL isNR);
+BOOL      NrAddFile(NRCONTEXT *ctx, char *filename, BOOL isNR);
+BOOL      NrFinalize(NRCONTEXT *ctx);
+BOOL      NrNextSurvivor(NRCONTEXT *ctx, char **id, char **entry);
+void      NrFree(NRCONTEXT *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,595 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       metrics.c
+
+   Version:    V1.6
+   Date:       19.10.26
+   Function:   Per-stage run metrics for nr
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Keeps a set of counters and timings for each stage of each input file
+   and writes them out as JSON at the end of the run.
+
+   The counters are always updated (through the METRIC() macros) since
+   this only costs an increment. The stage currently running is pointed
+   to by gStage; before the first stage starts this points to a dummy
+   so the macros can be used anywhere.
+
+   Each call to MetricsStartStage() adds to the figures for that stage
+   of the current file, so a stage may be run more than once for a file.
+
+   If gProgress is set, the PROGRESS() macro (called once per sequence)
+   updates a progress line on stderr giving the stage, sequences done,
+   throughput and estimated time to completion. The line is worked out
+   from the same counters and is redrawn at most once per 
+   PROGRESS_INTERVAL seconds. Until MIN_RATE_TIME seconds have passed
+   the rates and time to completion are shown as -- since they would
+   be meaningless.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.1  19.10.26 Added progress reporting
+   V1.2  19.10.26 Added ClusterSequences stage
+   V1.3  19.10.26 Added MetricsStage() and MetricsStageName()
+   V1.4  19.10.26 Added Bloom filter counts
+   V1.5  19.10.26 Added the fragment sizes tried by -f auto
+   V1.6  19.10.26 No rates are shown for the first MIN_RATE_TIME
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "metrics.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXBUFF           320
+#define PROGRESS_INTERVAL 1.0
+#define MIN_RATE_TIME     0.01   /* Rates need this long (s) to mean
+                                    anything                            */
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct
+{
+   char         file[MAXBUFF];
+   STAGEMETRICS stage[NSTAGES];
+}  FILEMETRICS;
+
+/************************************************************************/
+/* Globals
+*/
+static STAGEMETRICS sNoStage;
+STAGEMETRICS        *gStage = &sNoStage;
+
+static FILEMETRICS  *sFiles = NULL;
+static int          sNFiles = 0;
+static double       sStartWall,
+                    sStartCPU,
+                    sLastShown;
+static int          sStageNum = 0;
+static long         sTotalSeqs  = 0,
+                    sTotalBytes = 0;
+static FRAGTUNING   *sTuning    = NULL;
+static int          sNTuning    = 0,
+                    sTuneChosen = 0,
+                    sTuneSample = 0,
+                    sTuneRedundant = 0;
+static long         sTuneTotal  = 0;
+static char         sTuneReason[MAXBUFF];
+BOOL                gProgress   = FALSE;
+unsigned long       gProgressTick = 0;
+
+static char *sStageNames[NSTAGES] =
+{
+   "ReadSequences",
+   "HashSequences",
+   "DropRedundancies",
+   "MergeSequenceHashes",
+   "ClusterSequences",
+   "WriteResults"
+};
+
+/************************************************************************/
+/* Prototypes
+*/
+static double WallTime(void);
+static double CPUTime(void);
+static long PeakRSS(void);
+static void WriteJSONString(FILE *fp, char *string);
+static void FormatTime(char *buffer, double seconds);
+
+/************************************************************************/
+/*>void MetricsNewFile(char *file)
+   -------------------------------
+   Input:     char   *file     Name for this set of metrics
+
+   Starts a new set of metrics for an input file. Subsequent stages are
+   recorded against this file.
+
+   19.10.26 Original
+*/
+void MetricsNewFile(char *file)
+{
+   FILEMETRICS *files;
+
+   if((files = (FILEMETRICS *)realloc(sFiles,
+                                      (sNFiles+1)*sizeof(FILEMETRICS)))
+      ==NULL)
+   {
+      /* Not worth stopping the run for; keep adding to the last file   */
+      return;
+   }
+   sFiles = files;
+
+   memset(&(sFiles[sNFiles]), 0, sizeof(FILEMETRICS));
+   strncpy(sFiles[sNFiles].file, file, MAXBUFF);
+   sFiles[sNFiles].file[MAXBUFF-1] = '\0';
+   sNFiles++;
+}
+
+
+/************************************************************************/
+/*>void MetricsStartStage(int stage)
+   ---------------------------------
+   Input:     int    stage     Stage which is starting (STAGE_xxx)
+
+   Points gStage at the counters for this stage of the current file and
+   notes the start time. Clears the progress totals.
+
+   19.10.26 Original
+*/
+void MetricsStartStage(int stage)
+{
+   if(sNFiles == 0)
+      MetricsNewFile("-");
+
+   if(sNFiles == 0)
+   {
+      gStage = &sNoStage;
+   }
+   else
+   {
+      gStage = &(sFiles[sNFiles-1].stage[stage]);
+      gStage->run = TRUE;
+   }
+
+   sStageNum   = stage;
+   sTotalSeqs  = 0;
+   sTotalBytes = 0;
+   sStartWall  = sLastShown = WallTime();
+   sStartCPU   = CPUTime();
+}
+
+
+/************************************************************************/
+/*>void MetricsEndStage(void)
+   --------------------------
+   Adds the time taken to the current stage and records the peak RSS.
+   Finishes off the progress line.
+
+   19.10.26 Original
+*/
+void MetricsEndStage(void)
+{
+   if(gProgress)
+   {
+      sLastShown = 0.0;
+      ShowProgress();
+      fputc('\n', stderr);
+   }
+
+   gStage->wall   += WallTime() - sStartWall;
+   gStage->cpu    += CPUTime()  - sStartCPU;
+   gStage->peakRSS = PeakRSS();
+   gStage = &sNoStage;
+}
+
+
+/************************************************************************/
+/*>int MetricsStage(void)
+   ----------------------
+   Returns:   int              The stage most recently started 
+                               (STAGE_xxx)
+
+   19.10.26 Original
+*/
+int MetricsStage(void)
+{
+   return(sStageNum);
+}
+
+
+/************************************************************************/
+/*>char *MetricsStageName(int stage)
+   ---------------------------------
+   Input:     int    stage     A stage (STAGE_xxx)
+   Returns:   char   *         Its name (NULL if not a valid stage)
+
+   19.10.26 Original
+*/
+char *MetricsStageName(int stage)
+{
+   if((stage < 0) || (stage >= NSTAGES))
+      return(NULL);
+   return(sStageNames[stage]);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteMetrics(char *filename)
+   ---------------------------------
+   Input:     char   *filename    File to write
+   Returns:   BOOL                Success?
+
+   Writes the metrics for every file and stage that has been run as
+   JSON
+
+   19.10.26 Original
+   19.10.26 Writes the Bloom filter counts
+   19.10.26 Writes the fragment sizes tried by -f auto
+*/
+BOOL WriteMetrics(char *filename)
+{
+   FILE         *fp;
+   STAGEMETRICS *s;
+   int          i,
+                stage;
+   BOOL         first;
+
+   if((fp=fopen(filename, "w"))==NULL)
+      return(FALSE);
+
+   fprintf(fp,"{\n  \"program\": \"nr\",\n");
+   fprintf(fp,"  \"peak_rss_kb\": %ld,\n", PeakRSS());
+
+   if(sTuning != NULL)
+   {
+      fprintf(fp,"  \"fragsize_tuning\": {\n");
+      fprintf(fp,"    \"chosen\": %d,\n", sTuneChosen);
+      fprintf(fp,"    \"reason\": ");
+      WriteJSONString(fp, sTuneReason);
+      fprintf(fp,",\n    \"sample_seqs\": %d,\n", sTuneSample);
+      fprintf(fp,"    \"sample_redundant\": %d,\n", sTuneRedundant);
+      fprintf(fp,"    \"estimated_seqs\": %ld,\n", sTuneTotal);
+      fprintf(fp,"    \"sizes\": [");
+      for(i=0; i<sNTuning; i++)
+      {
+         fprintf(fp,"%s\n      {\"fragsize\": %d, \"collision_rate\": %.3g, \
+\"fan_out\": %.3g, \"w003_losses\": %.3g, \"relative_cost\": %.3f, \
+\"safe\": %s}", (i?",":""),
+                 sTuning[i].fragSize, sTuning[i].collisionRate,
+                 sTuning[i].fanOut, sTuning[i].w003Losses,
+                 sTuning[i].cost, (sTuning[i].safe?"true":"false"));
+      }
+      fprintf(fp,"\n    ]\n  },\n");
+   }
+
+   fprintf(fp,"  \"files\": [");
+
+   for(i=0; i<sNFiles; i++)
+   {
+      fprintf(fp,"%s\n    {\n      \"file\": ", (i?",":""));
+      WriteJSONString(fp, sFiles[i].file);
+      fprintf(fp,",\n      \"stages\": {");
+
+      first = TRUE;
+      for(stage=0; stage<NSTAGES; stage++)
+      {
+         s = &(sFiles[i].stage[stage]);
+         if(!s->run)
+            continue;
+
+         /* These stages only ever drop sequences                       */
+         if((stage == STAGE_HASH) || (stage == STAGE_DROP))
+            s->seqsOut = s->seqsIn - s->dropped;
+
+         fprintf(fp,"%s\n        \"%s\": {\n", (first?"":","),
+                 sStageNames[stage]);
+         fprintf(fp,"          \"wall_s\": %.3f,\n", s->wall);
+         fprintf(fp,"          \"cpu_s\": %.3f,\n", s->cpu);
+         fprintf(fp,"          \"seqs_in\": %ld,\n", s->seqsIn);
+         fprintf(fp,"          \"seqs_out\": %ld,\n", s->seqsOut);
+         fprintf(fp,"          \"dropped\": %ld,\n", s->dropped);
+         fprintf(fp,"          \"hash_probes\": %ld,\n", s->hashProbes);
+         fprintf(fp,"          \"bloom_rejects\": %ld,\n", 
+                 s->bloomRejects);
+         fprintf(fp,"          \"bloom_false_positives\": %ld,\n",
+                 s->bloomFalsePositives);
+         fprintf(fp,"          \"bloom_fp_rate\": %.4f,\n",
+                 (s->bloomRejects + s->bloomFalsePositives) ?
+                 (double)s->bloomFalsePositives / 
+                 (double)(s->bloomRejects + s->bloomFalsePositives) : 0.0);
+         fprintf(fp,"          \"candidate_fetches\": %ld,\n",
+                 s->candidateFetches);
+         fprintf(fp,"          \"compares\": %ld,\n", s->compares);
+         fprintf(fp,"          \"compare_results\": \
+{\"different\": %ld, \"first\": %ld, \"second\": %ld},\n",
+                 s->compareResults[0], s->compareResults[1],
+                 s->compareResults[2]);
+         fprintf(fp,"          \"bytes_read\": %ld,\n", s->bytesRead);
+         fprintf(fp,"          \"peak_rss_kb\": %ld\n", s->peakRSS);
+         fprintf(fp,"        }");
+         first = FALSE;
+      }
+      fprintf(fp,"\n      }\n    }");
+   }
+
+   fprintf(fp,"\n  ]\n}\n");
+   fclose(fp);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void MetricsFragTuning(FRAGTUNING *sizes, int nSizes, int chosen,
+                          int nSample, int nRedundant, long nTotal,
+                          char *reason)
+   -----------------------------------------------------------------
+   Input:     FRAGTUNING *sizes      The fragment sizes tried
+              int        nSizes      Number of sizes
+              int        chosen      The size chosen
+              int        nSample     Sequences sampled
+              int        nRedundant  ...of which were contained in 
+                                     another
+              long       nTotal      Estimated sequences in the input
+              char       *reason     Why the size was chosen
+
+   Keeps a copy of what -f auto found so that WriteMetrics() can report
+   it.
+
+   19.10.26 Original
+*/
+void MetricsFragTuning(FRAGTUNING *sizes, int nSizes, int chosen,
+                       int nSample, int nRedundant, long nTotal,
+                       char *reason)
+{
+   if(sTuning != NULL)
+      free(sTuning);
+   sNTuning = 0;
+   if((sTuning = (FRAGTUNING *)malloc(nSizes * sizeof(FRAGTUNING)))
+      == NULL)
+      return;
+
+   memcpy(sTuning, sizes, nSizes * sizeof(FRAGTUNING));
+   sNTuning       = nSizes;
+   sTuneChosen    = chosen;
+   sTuneSample    = nSample;
+   sTuneRedundant = nRedundant;
+   sTuneTotal     = nTotal;
+   strncpy(sTuneReason, reason, MAXBUFF);
+   sTuneReason[MAXBUFF-1] = '\0';
+}
+
+
+/************************************************************************/
+/*>void SetProgressTotals(long seqs, long bytes)
+   ---------------------------------------------
+   Input:     long   seqs     Number of sequences this stage will process
+                              (0 if not known)
+              long   bytes    Number of bytes this stage will read
+                              (0 if not known)
+
+   Sets the totals used to estimate the time to completion. If the
+   number of bytes is given, this is used in preference to the number
+   of sequences.
+
+   19.10.26 Original
+*/
+void SetProgressTotals(long seqs, long bytes)
+{
+   sTotalSeqs  = seqs;
+   sTotalBytes = bytes;
+}
+
+
+/************************************************************************/
+/*>void ShowProgress(void)
+   -----------------------
+   Redraws the progress line if PROGRESS_INTERVAL seconds have passed
+   since it was last drawn.
+
+   19.10.26 Original
+   19.10.26 Shows -- for the rates until MIN_RATE_TIME has passed, 
+            rather than dividing by almost nothing
+*/
+void ShowProgress(void)
+{
+   double now,
+          elapsed,
+          eta = (-1.0);
+   char   etaString[MAXBUFF],
+          seqRate[MAXBUFF],
+          byteRate[MAXBUFF];
+
+   now = WallTime();
+   if((now - sLastShown) < PROGRESS_INTERVAL)
+      return;
+   sLastShown = now;
+
+   elapsed = now - sStartWall;
+   if(elapsed < MIN_RATE_TIME)
+   {
+      strcpy(seqRate,  "--");
+      strcpy(byteRate, "--");
+   }
+   else
+   {
+      sprintf(seqRate,  "%.0f", (double)gStage->seqsIn / elapsed);
+      sprintf(byteRate, "%.1f", 
+              (double)gStage->bytesRead / (elapsed * 1000000.0));
+
+      if(sTotalBytes && gStage->bytesRead)
+      {
+         eta = (double)(sTotalBytes - gStage->bytesRead) * elapsed /
+               (double)gStage->bytesRead;
+      }
+      else if(sTotalSeqs && gStage->seqsIn)
+      {
+         eta = (double)(sTotalSeqs - gStage->seqsIn) * elapsed /
+               (double)gStage->seqsIn;
+      }
+   }
+
+   if(eta < 0.0)
+      strcpy(etaString, "--:--:--");
+   else
+      FormatTime(etaString, eta);
+
+   if(sTotalSeqs)
+   {
+      fprintf(stderr,"\rPROGRESS: %-19s %ld/%ld seqs %s seq/s \
+%s MB/s ETA %s   ",
+              sStageNames[sStageNum], gStage->seqsIn, sTotalSeqs,
+              seqRate, byteRate, etaString);
+   }
+   else
+   {
+      fprintf(stderr,"\rPROGRESS: %-19s %ld seqs %s seq/s \
+%s MB/s ETA %s   ",
+              sStageNames[sStageNum], gStage->seqsIn,
+              seqRate, byteRate, etaString);
+   }
+}
+
+
+/************************************************************************/
+/*>static void FormatTime(char *buffer, double seconds)
+   ----------------------------------------------------
+   Input:     double seconds   A time in seconds
+   Output:    char   *buffer   The time as hh:mm:ss
+
+   19.10.26 Original
+*/
+static void FormatTime(char *buffer, double seconds)
+{
+   long secs = (long)(seconds + 0.5);
+
+   sprintf(buffer, "%02ld:%02ld:%02ld",
+           secs / 3600, (secs / 60) % 60, secs % 60);
+}
+
+
+/************************************************************************/
+/*>static void WriteJSONString(FILE *fp, char *string)
+   ---------------------------------------------------
+   Input:     FILE   *fp       Output file pointer
+              char   *string   String to write
+
+   Writes a quoted string escaping characters as required by JSON
+
+   19.10.26 Original
+*/
+static void WriteJSONString(FILE *fp, char *string)
+{
+   fputc('"', fp);
+   for(; *string; string++)
+   {
+      if((*string == '"') || (*string == '\\'))
+      {
+         fputc('\\', fp);
+         fputc(*string, fp);
+      }
+      else if((unsigned char)*string < 0x20)
+      {
+         fprintf(fp, "\\u%04x", (unsigned char)*string);
+      }
+      else
+      {
+         fputc(*string, fp);
+      }
+   }
+   fputc('"', fp);
+}
+
+
+/************************************************************************/
+/*>static double WallTime(void)
+   ----------------------------
+   Returns:   double     Current time in seconds
+
+   19.10.26 Original
+*/
+static double WallTime(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+   return((double)tv.tv_sec + ((double)tv.tv_usec / 1000000.0));
+}
+
+
+/************************************************************************/
+/*>static double CPUTime(void)
+   ---------------------------
+   Returns:   double     User plus system CPU time used so far (s)
+
+   19.10.26 Original
+*/
+static double CPUTime(void)
+{
+   struct rusage usage;
+
+   getrusage(RUSAGE_SELF, &usage);
+   return((double)usage.ru_utime.tv_sec +
+          ((double)usage.ru_utime.tv_usec / 1000000.0) +
+          (double)usage.ru_stime.tv_sec +
+          ((double)usage.ru_stime.tv_usec / 1000000.0));
+}
+
+
+/************************************************************************/
+/*>static long PeakRSS(void)
+   -------------------------
+   Returns:   long       Peak resident set size so far (kB)
+
+   19.10.26 Original
+*/
+static long PeakRSS(void)
+{
+   struct rusage usage;
+
+   getrusage(RUSAGE_SELF, &usage);
+   return((long)usage.ru_maxrss);
+}
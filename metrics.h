@@ -0,0 +1,134 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       metrics.h
+
+   Version:    V1.5
+   Date:       19.10.26
+   Function:   Per-stage run metrics for nr
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.1  19.10.26 Added progress reporting
+   V1.2  19.10.26 Added STAGE_CLUSTER
+   V1.3  19.10.26 Added MetricsStage() and MetricsStageName()
+   V1.4  19.10.26 Added Bloom filter counts
+   V1.5  19.10.26 Added the fragment sizes tried by -f auto
+
+*************************************************************************/
+#ifndef _NR_METRICS_H
+#define _NR_METRICS_H
+
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define STAGE_READ      0
+#define STAGE_HASH      1
+#define STAGE_DROP      2
+#define STAGE_MERGE     3
+#define STAGE_CLUSTER   4
+#define STAGE_WRITE     5
+#define NSTAGES         6
+
+/* Update a counter for the stage currently running                     */
+#define METRIC(field)        (gStage->field++)
+#define METRIC_ADD(field, n) (gStage->field += (n))
+
+/* Called once per sequence. Only looks at the clock every 
+   PROGRESS_MASK+1 calls
+*/
+#define PROGRESS_MASK        1023
+#define PROGRESS()                                                       \
+do                                                                       \
+{  if(gProgress && !((++gProgressTick) & PROGRESS_MASK))                 \
+      ShowProgress();                                                    \
+} while(0)
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct
+{
+   double wall,                  /* Elapsed time (s)                    */
+          cpu;                   /* User + system CPU time (s)          */
+   long   seqsIn,                /* Sequences processed                 */
+          seqsOut,               /* Sequences kept                      */
+          dropped,               /* Calls to DropSequence()             */
+          hashProbes,            /* Fragment hash lookups and stores    */
+          bloomRejects,          /* Lookups skipped by the Bloom filter */
+          bloomFalsePositives,   /* Lookups it passed which missed      */
+          candidateFetches,      /* Candidate sequences read back       */
+          compares,              /* Calls to CompareSequences()         */
+          compareResults[3],     /* ...split by return value            */
+          bytesRead,             /* Bytes read from the input files     */
+          peakRSS;               /* Peak resident set size (kB)         */
+   BOOL   run;                   /* Has this stage been run?            */
+}  STAGEMETRICS;
+
+typedef struct                   /* A fragment size tried by -f auto    */
+{
+   int    fragSize;
+   double collisionRate,         /* Chance that two sampled fragments
+                                    are the same                        */
+          fanOut,                /* Expected candidates per probe       */
+          w003Losses,            /* Expected W003 losses in the input   */
+          cost;                  /* Estimated time relative to the 
+                                    fastest size                        */
+   BOOL   safe;                  /* Few enough expected losses?         */
+}  FRAGTUNING;
+
+/************************************************************************/
+/* Globals
+*/
+extern STAGEMETRICS  *gStage;
+extern BOOL          gProgress;
+extern unsigned long gProgressTick;
+
+/************************************************************************/
+/* Prototypes
+*/
+void MetricsNewFile(char *file);
+void MetricsStartStage(int stage);
+void MetricsEndStage(void);
+int  MetricsStage(void);
+char *MetricsStageName(int stage);
+BOOL WriteMetrics(char *filename);
+void MetricsFragTuning(FRAGTUNING *sizes, int nSizes, int chosen,
+                       int nSample, int nRedundant, long nTotal,
+                       char *reason);
+void SetProgressTotals(long seqs, long bytes);
+void ShowProgress(void);
+
+#endif
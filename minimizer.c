@@ -0,0 +1,367 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       minimizer.c
+
+   Version:    V1.3
+   Date:       19.10.26
+   Function:   Minimizer anchors for the fragment hash
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Chooses the fragments used as anchors in the fragment hash of nr.
+
+   Each fragment (k-mer) of a sequence is given a pseudo-random hash
+   value. For every window of w consecutive fragments, the one with the
+   lowest hash (the leftmost if there is a tie) is that window's
+   'minimizer'. Since this depends only on the fragments in the window,
+   a sequence which contains another has, among its own minimizers,
+   every minimizer of the one it contains. So if each sequence is 
+   anchored at one of its minimizers, a longer sequence only needs to
+   look up its own minimizers (about 2/(w+1) of its fragments) to find
+   the anchors of all the sequences it contains, and related sequences
+   pick the same anchors whatever order they are stored in.
+
+   A sequence whose minimizers are all taken as anchors by other 
+   sequences (or which is too short to have a full window) is anchored
+   elsewhere. The hashes of these 'extra' anchors are kept in an
+   in-memory set so that lookups can also be made for any fragment
+   which might be one of them.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.1  19.10.26 FindMinimizers() takes the hash function
+   V1.2  19.10.26 Added SwapExtraAnchors() and FreeExtraAnchors()
+   V1.3  19.10.26 The extra anchor set comes from PageAlloc()
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "minimizer.h"
+#include "arena.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define INITIAL_SIZE 1024
+#define EMPTY        0UL
+
+/************************************************************************/
+/* Globals
+*/
+static unsigned long *sHashes     = NULL,   /* Hashes of each fragment  */
+                     *sExtra      = NULL;   /* Set of extra anchors     */
+static char          *sIsMin      = NULL;   /* Flags for minimizers     */
+static int           sNAlloc      = 0;
+static long          sNExtra      = 0,
+                     sExtraSize   = 0;
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL GrowExtra(void);
+
+
+/************************************************************************/
+/*>unsigned long KmerHash(char *kmer, int k)
+   -----------------------------------------
+   Input:     char          *kmer   Fragment
+              int           k       Length of fragment
+   Returns:   unsigned long         Hash value (never 0)
+
+   FNV-1a hash of the fragment, with the bits then mixed so that the
+   order of the hash values is effectively random.
+
+   19.10.26 Original
+*/
+unsigned long KmerHash(char *kmer, int k)
+{
+   unsigned long hash = 2166136261UL;
+   int           i;
+
+   for(i=0; i<k; i++)
+   {
+      hash ^= (unsigned char)kmer[i];
+      hash *= 16777619UL;
+   }
+
+   hash ^= hash >> 15;
+   hash *= 0x2c1b3c6dUL;
+   hash ^= hash >> 12;
+   hash *= 0x297a2d39UL;
+   hash ^= hash >> 15;
+   
+   return((hash == EMPTY) ? 1UL : hash);
+}
+
+
+/************************************************************************/
+/*>int FindMinimizers(char *seq, int nKmers, int k, int w, 
+                      KMERHASHFN hash, unsigned long **hashes, 
+                      char **isMin)
+   ---------------------------------------------------------
+   Input:     char          *seq     Sequence
+              int           nKmers   Number of fragments to consider
+              int           k        Fragment length
+              int           w        Window size
+              KMERHASHFN    hash     Hash function for the fragments
+                                     (normally KmerHash())
+   Output:    unsigned long **hashes Hash of each fragment
+              char          **isMin  Flag for each fragment which is a
+                                     minimizer
+   Returns:   int                    Number of minimizers (-1 if no
+                                     memory)
+
+   Finds the (w,k) minimizers of the first nKmers fragments of a 
+   sequence. The arrays returned are reused on the next call so must not
+   be freed. A sequence with fewer than w fragments has no minimizers.
+
+   19.10.26 Original
+   19.10.26 Added hash
+*/
+int FindMinimizers(char *seq, int nKmers, int k, int w, KMERHASHFN hash,
+                   unsigned long **hashes, char **isMin)
+{
+   int start,
+       i,
+       min   = (-1),
+       nMin  = 0;
+
+   if(nKmers < 0)
+      nKmers = 0;
+   
+   if(nKmers >= sNAlloc)
+   {
+      sNAlloc = nKmers + INITIAL_SIZE;
+      if(((sHashes = (unsigned long *)realloc(sHashes, 
+                                 sNAlloc * sizeof(unsigned long)))==NULL) ||
+         ((sIsMin  = (char *)realloc(sIsMin, sNAlloc * sizeof(char)))
+          ==NULL))
+      {
+         sNAlloc = 0;
+         return(-1);
+      }
+   }
+   *hashes = sHashes;
+   *isMin  = sIsMin;
+
+   for(i=0; i<nKmers; i++)
+   {
+      sHashes[i] = (*hash)(seq+i, k);
+      sIsMin[i]  = FALSE;
+   }
+
+   /* Slide the window along, only rescanning it when the last minimum
+      drops out of the front
+   */
+   for(start=0; start+w<=nKmers; start++)
+   {
+      if(min < start)
+      {
+         min = start;
+         for(i=start+1; i<start+w; i++)
+         {
+            if(sHashes[i] < sHashes[min])
+               min = i;
+         }
+      }
+      else if(sHashes[start+w-1] < sHashes[min])
+      {
+         min = start+w-1;
+      }
+
+      if(!sIsMin[min])
+      {
+         sIsMin[min] = TRUE;
+         nMin++;
+      }
+   }
+
+   return(nMin);
+}
+
+
+/************************************************************************/
+/*>void AddExtraAnchor(unsigned long hash)
+   ---------------------------------------
+   Input:     unsigned long hash     Hash of an anchor which is not a
+                                     minimizer
+
+   Adds a hash to the set of extra anchors (open addressing, doubled 
+   when half full). Exits if there is no memory.
+
+   19.10.26 Original
+*/
+void AddExtraAnchor(unsigned long hash)
+{
+   long i;
+
+   if((2 * (sNExtra+1)) > sExtraSize)
+   {
+      if(!GrowExtra())
+      {
+         fprintf(stderr,"E003: No memory for extra anchors\n");
+         exit(1);
+      }
+   }
+
+   for(i=hash % sExtraSize; sExtra[i] != EMPTY; i=(i+1) % sExtraSize)
+   {
+      if(sExtra[i] == hash)
+         return;
+   }
+   sExtra[i] = hash;
+   sNExtra++;
+}
+
+
+/************************************************************************/
+/*>BOOL IsExtraAnchor(unsigned long hash)
+   --------------------------------------
+   Input:     unsigned long hash     Hash of a fragment
+   Returns:   BOOL                   Might the fragment be an extra
+                                     anchor?
+
+   19.10.26 Original
+*/
+BOOL IsExtraAnchor(unsigned long hash)
+{
+   long i;
+
+   if(sNExtra == 0)
+      return(FALSE);
+
+   for(i=hash % sExtraSize; sExtra[i] != EMPTY; i=(i+1) % sExtraSize)
+   {
+      if(sExtra[i] == hash)
+         return(TRUE);
+   }
+   return(FALSE);
+}
+
+
+/************************************************************************/
+/*>long NExtraAnchors(void)
+   ------------------------
+   Returns:   long                   Number of extra anchors
+
+   19.10.26 Original
+*/
+long NExtraAnchors(void)
+{
+   return(sNExtra);
+}
+
+
+/************************************************************************/
+/*>static BOOL GrowExtra(void)
+   ---------------------------
+   Returns:   BOOL                   Success?
+
+   Doubles the size of the extra anchor set and rehashes it
+
+   19.10.26 Original
+   19.10.26 Allocated with PageAlloc()
+*/
+static BOOL GrowExtra(void)
+{
+   unsigned long *old     = sExtra;
+   long          oldSize  = sExtraSize,
+                 i,
+                 j;
+
+   sExtraSize = (oldSize ? 2 * oldSize : INITIAL_SIZE);
+   if((sExtra = (unsigned long *)PageAlloc(sExtraSize * 
+                                           sizeof(unsigned long)))==NULL)
+      return(FALSE);
+
+   for(i=0; i<oldSize; i++)
+   {
+      if(old[i] != EMPTY)
+      {
+         for(j=old[i] % sExtraSize; sExtra[j] != EMPTY; 
+             j=(j+1) % sExtraSize);
+         sExtra[j] = old[i];
+      }
+   }
+   PageFree(old, oldSize * sizeof(unsigned long));
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void SwapExtraAnchors(ANCHORS *other)
+   -------------------------------------
+   I/O:       ANCHORS *other   Set to use (returned holding the one that
+                               was in use)
+
+   Exchanges the set of extra anchors in use with another, so each
+   library context can have its own. A zeroed ANCHORS is an empty set.
+
+   19.10.26 Original
+*/
+void SwapExtraAnchors(ANCHORS *other)
+{
+   ANCHORS here;
+
+   here.hashes   = sExtra;
+   here.n        = sNExtra;
+   here.size     = sExtraSize;
+   sExtra        = other->hashes;
+   sNExtra       = other->n;
+   sExtraSize    = other->size;
+   *other        = here;
+}
+
+
+/************************************************************************/
+/*>void FreeExtraAnchors(ANCHORS *set)
+   -----------------------------------
+   I/O:       ANCHORS *set     Set which is not in use
+
+   Frees a set swapped out with SwapExtraAnchors(), leaving it empty
+
+   19.10.26 Original
+   19.10.26 Uses PageFree()
+*/
+void FreeExtraAnchors(ANCHORS *set)
+{
+   if(set->hashes != NULL)
+      PageFree(set->hashes, set->size * sizeof(unsigned long));
+   set->hashes = NULL;
+   set->n      = set->size = 0;
+}
@@ -0,0 +1,81 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       minimizer.h
+
+   Version:    V1.3
+   Date:       19.10.26
+   Function:   Minimizer anchors for the fragment hash
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.1  19.10.26 FindMinimizers() takes the hash function
+   V1.2  19.10.26 Added SwapExtraAnchors() and FreeExtraAnchors()
+   V1.3  19.10.26 The extra anchor set comes from PageAlloc()
+
+*************************************************************************/
+#ifndef _NR_MINIMIZER_H
+#define _NR_MINIMIZER_H
+
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define DEFAULT_WINDOW 8         /* Fragments in each minimizer window  */
+
+/************************************************************************/
+/* Structures
+*/
+typedef unsigned long (*KMERHASHFN)(char *kmer, int k);
+
+typedef struct                   /* Extra anchors while not in use      */
+{
+   unsigned long *hashes;
+   long          n,
+                 size;
+}  ANCHORS;
+
+/************************************************************************/
+/* Prototypes
+*/
+unsigned long KmerHash(char *kmer, int k);
+int  FindMinimizers(char *seq, int nKmers, int k, int w, KMERHASHFN hash,
+                    unsigned long **hashes, char **isMin);
+void AddExtraAnchor(unsigned long hash);
+BOOL IsExtraAnchor(unsigned long hash);
+long NExtraAnchors(void);
+void SwapExtraAnchors(ANCHORS *other);
+void FreeExtraAnchors(ANCHORS *set);
+
+#endif
@@ -3,8 +3,8 @@
    Program:    nr
    File:       nr.c
    
-   Version:    V1.2
-   Date:       20.07.00
+   Version:    V1.26
+   Date:       19.10.26
    Function:   Create a non-redundant sequence data set
    
    Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
@@ -58,19 +58,70 @@
    With a reasonably large fragment size this is very unlikely and
    increasing the fragment size at run time should solve the problem.
 
-   Possible speedups:
+   Deleted sequences:
    ------------------
-   One route to speedup would be to create a linked list of the keys
-   in seqhash_temp and work through this list rather than through
-   the keys directly so that the keys can be deleted from seqhash_temp
-   as we find them. Thus DropSequence() would actually remove an item
-   rather than building a list of items to delete and PurgeSequences()
-   would no longer be needed.
-
-   Possible changes:
-   -----------------
-   CompareSequences() could be enhanced to perform non-exact matching to
-   allow a limited number of mutations
+   Each sequence is given a serial index, stored after the filename and
+   offset in the sequence hash. DropSequence() doesn't actually delete
+   the entry; it sets the bit for the index in a bitset (tombstone.c)
+   instead. Deleted entries are skipped when the hash is read and only
+   removed by PurgeDeletedSequences() once they make up a quarter of it.
+
+   Generations:
+   ------------
+   All the sequences are kept in one hash. Those read from the current
+   file are the ones with an index of at least gFirstNew, and their IDs
+   are also written to a key file so that each stage can loop through
+   just these. MergeSequenceHashes() then only has to move gFirstNew
+   on to the next index.
+
+   Mismatch mode:
+   --------------
+   With -k, a sequence may also be dropped if it is contained in another
+   with up to k mismatches. Instead of one unique fragment, k+1 
+   non-overlapping seed fragments are stored for each sequence (the
+   fragment hash then holds lists of ID/offset pairs). Any sequence 
+   contained in another with k or fewer mismatches must share at least
+   one seed exactly with it, so sliding the window along each sequence
+   still finds every candidate. The seed also fixes the alignment, so
+   candidates are checked by counting mismatches along that one diagonal
+   with CountMismatches().
+
+   Serving:
+   --------
+   With -S, a non-redundant file is loaded and then queries are answered
+   over a socket (serve.c) until the program is killed. Every 
+   (fragSize-1)th fragment of each sequence is stored as a seed, as in
+   mismatch mode, so that a query lying within a stored sequence is 
+   found as well as one containing it. The hashes are then reopened 
+   read-only and each server thread opens its own handles on them and on
+   the file.
+
+   Library:
+   --------
+   Compiled with NR_LIBRARY defined, main() is left out and the rest is
+   used by libnr.c. Each library context keeps its own copy of the 
+   hash handles, counters and options held in globals here, and swaps
+   them in around each call. Its temporary files are told apart by 
+   gInstance.
+
+   Updates:
+   --------
+   With -e, a state file is written holding the settings, the edges of
+   the supersede forest and the complete entries of the kept sequences
+   and of those they superceeded. With -u, the forest is rebuilt from 
+   the state and the IDs given with -x are marked as removed. Families 
+   which have lost their representative are broken up and only their
+   remaining members are compared again, after the other 
+   representatives have been loaded as already non-redundant. The added
+   files are then processed as usual.
+
+   Fragment size:
+   --------------
+   With -f auto, a sample of the input is read before anything else
+   from evenly spaced places in each file (estimating the number of
+   sequences in the file from how far through it the sample got) and
+   TuneFragSize() in fragtune.c tries each size on it. Nothing else 
+   changes once the size is chosen.
 
    Development Time:
    -----------------
@@ -95,6 +146,40 @@
                   in the file rather than the actual sequence data to
                   reduce memory usage
    V1.2  20.07.00 Rewrote all the deletion logic so it actually works!
+   V1.3  19.10.26 Added -s to split the work across forked shard workers
+                  with a final reconciliation pass
+   V1.4  19.10.26 Added -m to write per-stage metrics as JSON
+   V1.5  19.10.26 Added -p to show progress
+   V1.6  19.10.26 Added -k mismatch mode
+   V1.7  19.10.26 Added -i identity clustering
+   V1.8  19.10.26 Added -c cluster membership output and -a merged
+                  deflines
+   V1.9  19.10.26 Added -b binary event log
+   V1.10 19.10.26 Reads BGZF compressed input
+   V1.11 19.10.26 Added -z to write BGZF compressed output
+   V1.12 19.10.26 Reads from stdin given the filename -
+   V1.13 19.10.26 Anchors sequences at minimizers. Added -w
+   V1.14 19.10.26 Bloom filter in front of fragment lookups
+   V1.15 19.10.26 Deleted sequences kept in a bitset rather than a hash
+   V1.16 19.10.26 A single sequence hash; merging is a watermark bump
+   V1.17 19.10.26 Added -j to process the input files concurrently
+                  with a final reconciliation pass
+   V1.18 19.10.26 Lines of any length are read in one pass into a 
+                  growing buffer which counts the Xs
+   V1.19 19.10.26 Added -I to choose the rule for finding identifiers,
+                  which are no longer limited to 31 characters
+   V1.20 19.10.26 Added -D for nucleotide sequences
+   V1.21 19.10.26 Added -S to answer queries against a file over a 
+                  socket
+   V1.22 19.10.26 May be built without main() as part of libnr
+   V1.23 19.10.26 Fragment probes are batched with the Bloom filter
+                  blocks prefetched
+   V1.24 19.10.26 Sequences are fetched into reused buffers. Large 
+                  tables may use huge pages
+   V1.25 19.10.26 Added -e to save the state of a run and -u and -x to
+                  update it with added and removed sequences
+   V1.26 19.10.26 Added -f auto to choose the fragment size from a 
+                  sample of the input
 
 *************************************************************************/
 /* Includes
@@ -102,54 +187,96 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <limits.h>
 #include <unistd.h>
 #include <gdbm.h>
 #include <signal.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
 #include "bioplib/SysDefs.h"
 #include "bioplib/general.h"
 #include "bioplib/macros.h"
+#include "metrics.h"
+#include "hamming.h"
+#include "cluster.h"
+#include "forest.h"
+#include "eventlog.h"
+#include "seqfile.h"
+#include "outfile.h"
+#include "minimizer.h"
+#include "bloom.h"
+#include "tombstone.h"
+#include "idrule.h"
+#include "dna.h"
+#include "serve.h"
+#include "fragtune.h"
 
 
 /************************************************************************/
 /* Defines and macros
 */
 #define DEFAULT_FRAGSIZE   15
-#define MAX_KEY_LEN        32
 #define MAXBUFF           320
 #define HUGEBUFF          800
 #define BLOCK_SIZE       4096
 #define MODE             0600
 
 #define TOO_MANY_X_FRAC     (REAL)0.25
+#define DIAG_DROPPED        INT_MIN
+#define PURGE_FRACTION      4       /* Purge when 1/4 of main is deleted */
+#define PROBE_BATCH        16       /* Fragments prefetched together     */
+
+#define STATE_MAGIC         "#NRSTATE"    /* First line of a state file  */
+#define STATE_EDGE          "#EDGE"       /* Start of each edge line     */
+#define STATE_VERSION       1
+
+#define UPDATE_NONE         0       /* Passes of an update (gUpdatePass) */
+#define UPDATE_KEEP         1       /* Valid representatives             */
+#define UPDATE_RECHECK      2       /* Members of broken families        */
+#define UPDATE_ADDED        3       /* Files given on the command line   */
+#define UPDATE_PROBE        4       /* Representatives probed for members
+                                       of broken families                */
+#define MARK_REMOVED        1       /* Forest marks during an update     */
+#define MARK_RECHECK        2
 
 #define DEFAULT_SEQHASH     "seqhash"
 #define DEFAULT_FRAGHASH    "fraghash"
 #define DEFAULT_FRAGTABLE   "fragtablehash"
-#define DEFAULT_TEMPSEQHASH "seqhash_temp"
-#define DEFAULT_DELETEDHASH "deletedhash"
+#define DEFAULT_KEYFILE     "nrkeys"
+#define DEFAULT_SHARDFILE   "nrshard"
+#define DEFAULT_STDINFILE   "nrstdin"
 #define DEFAULT_GDBM_DIR    "/tmp"
+#define DUPLICATE_MARK      '\001'  /* Key file entry for a duplicate    */
 
 #define CREATEDATUM(x,y)                                                 \
    (x).dptr = (y);                                                       \
    (x).dsize = (strlen(y)+1)
 
-#define CLEARHASH(ch_hash, ch_stem)                                      \
-do                                                                       \
-{  pid_t pid;                                                            \
-   char  name[MAXBUFF];                                                  \
-   gdbm_close(ch_hash);                                                  \
-   pid = getpid();                                                       \
-   sprintf(name,"%s/%s.%d",gGDBMDir,ch_stem,pid);                        \
-   unlink(name);                                                         \
-   if((ch_hash = gdbm_open(name, BLOCK_SIZE,                             \
-                            GDBM_WRCREAT|GDBM_FAST,                      \
-                            MODE, NULL))==NULL)                          \
-   {  fprintf(stderr,"E002: Can't open GDBM hash for r/w: %s\n",         \
-              name);                                                     \
-      return(FALSE);                                                     \
-   }                                                                     \
-} while(0)
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct                   /* A growing buffer for sequences (or
+                                    IDs)                                */
+{
+   char *data;                   /* Residues (NUL-terminated)           */
+   long length,                  /* Number of residues                  */
+        size,                    /* Space allocated for data            */
+        nX;                      /* Number of Xs                        */
+}  SEQBUFF;
+
+typedef struct                   /* State of a server thread            */
+{
+   GDBM_FILE seqdata,            /* Its own handles on the hashes       */
+             fragdata;
+   SEQFILE   *fp;                /* ...and on the file being served     */
+   SEQBUFF   checked,            /* Candidates compared for this query  */
+             hit,                /* ID of the sequence reported         */
+             candidate;          /* Stored sequence being compared      */
+   char      *fragment;
+}  SERVESTATE;
 
 
 /************************************************************************/
@@ -157,12 +284,48 @@ do                                                                       \
 */
 int       gVerbose = 0;
 GDBM_FILE gDBF_seqdata,
-          gDBF_seqdata_temp,
           gDBF_fragdata,
-          gDBF_fragtable,
-          gDBF_deleted;
+          gDBF_fragtable;
 
 char      gGDBMDir[MAXBUFF];
+int       gShard   = (-1),
+          gNShards = 1;
+char      gMetricsFile[MAXBUFF];
+long      gNTempSeqs = 0,
+          gNTempDups = 0,      /* Duplicates of IDs from earlier files  */
+          gNSeqs     = 0,
+          gNIndex    = 0,      /* Index for the next sequence read      */
+          gNDead     = 0,      /* Deleted entries left in the hash      */
+          gFirstNew  = 0;      /* Index of first entry from this file   */
+FILE      *gKeys     = NULL;   /* IDs of the entries from this file     */
+long      gKeysEnd   = 0;      /* ...and the length of the list         */
+int       gMismatches = 0;
+REAL      gIdentity   = 0.0;
+char      gClusterFile[MAXBUFF],
+          gEventFile[MAXBUFF];
+BOOL      gMergeDeflines = FALSE,
+          gForest        = FALSE;
+int       gCompress      = 0,
+          gWindow        = DEFAULT_WINDOW,
+          gJobs          = 1,
+          gIDRule        = IDRULE_DEFAULT;
+BOOL      gDNA           = FALSE;
+char      gUnknown       = 'X';  /* Residue counted by TooManyXs()      */
+char      gServeSocket[MAXBUFF], /* Socket to serve queries on          */
+          *gServeFile     = NULL;
+int       gServeThreads  = DEFAULT_THREADS,
+          gServeFragSize = DEFAULT_FRAGSIZE;
+pthread_mutex_t gSeqFileLock = PTHREAD_MUTEX_INITIALIZER;
+int       gInstance      = 0;    /* Library context (0 for nr itself)   */
+char      gStateFile[MAXBUFF],   /* State to write for a later update   */
+          gUpdateFile[MAXBUFF],  /* State of the run being updated      */
+          gRemovedFile[MAXBUFF]; /* IDs removed since that run          */
+int       gUpdatePass    = UPDATE_NONE;
+ANCHORS   gRecheckAnchors = {NULL, 0, 0}; /* Anchors of the members of
+                                             broken families            */
+BOOL      gLocators      = FALSE;  /* Keep the locators of superceeded
+                                      sequences                         */
+BOOL      gAutoFragSize  = FALSE;  /* -f auto                           */
 
 
 /************************************************************************/
@@ -171,10 +334,25 @@ char      gGDBMDir[MAXBUFF];
 int CompareSequences(char *seq1, char *id1, char *seq2, char *id2);
 BOOL CreateHashes(void);
 BOOL ParseCmdLine(int argc, char **argv, char *outfile, BOOL *FirstIsNR, 
-                  int *fragSize, int *firstFile, int *rejectSize);
+                  int *fragSize, int *firstFile, int *rejectSize,
+                  int *nShards);
 int main(int argc, char **argv);
 void CleanUp(void);
-BOOL ReadSequences(FILE *in, char *file, int rejectSize);
+BOOL ReadSequences(SEQFILE *in, char *file, int rejectSize, int fragSize);
+void StoreRecord(char *key, char *file, long entryStart, SEQBUFF *seq,
+                 int rejectSize, int fragSize);
+BOOL AppendToSeqBuff(SEQBUFF *sb, char *text, int length, BOOL strip);
+BOOL InShard(char *seq, int fragSize);
+BOOL RunShards(char **files, int nFiles, BOOL FirstIsNR, int fragSize,
+               int rejectSize, int nShards, OUTFILE *out);
+BOOL RunJobs(char **files, int nFiles, BOOL FirstIsNR, int fragSize,
+             int rejectSize, int nJobs, OUTFILE *out);
+int RunWorker(char **files, int nFiles, BOOL FirstIsNR, int fragSize,
+              int rejectSize, char *partFile, int worker);
+BOOL ReadPartFile(char *partFile, int fragSize, int rejectSize);
+char **PartFileNames(int nParts);
+void FreePartFiles(char **partFiles, int nParts);
+BOOL SpoolStdinFiles(char **files, int nFiles, char *stdinFile);
 BOOL HashSequences(int fragSize, BOOL loadOnly);
 void StoreSequenceFragment(char *data, 
                            int fragSize,
@@ -185,14 +363,60 @@ BOOL DropRedundancies(int fragSize);
 void doDropRedundancy(char *seqid, char *sequence, int fragSize);
 BOOL NonRedundantise(char *file, BOOL loadOnly, int fragSize, 
                      int rejectSize);
-BOOL MergeSequenceHashes(char *mainhash, char *temphash);
+BOOL MergeSequenceHashes(void);
 void Usage(void);
 char *GetSequence(datum content, BOOL full);
-void WriteResults(FILE *out);
+char *FetchSequence(datum content, BOOL full, SEQBUFF *sb);
+void WriteResults(OUTFILE *out, BOOL mergeDeflines);
 char *ThisSequenceRedundant(char *data, int fragSize,
                             datum gdbm_seq_seqid);
-BOOL TooManyXs(char *seq);
+BOOL TooManyXs(long nX, long length);
 void CleanupDie(int signum);
+void StoreSequenceSeeds(char *data, int fragSize, datum gdbm_seq_seqid);
+void AddToSeedList(char *seed, char *seqid, int offset);
+void DropSequenceSeeds(datum gdbm_seq_key);
+void doDropMismatchRedundancy(char *seqid, char *sequence, int fragSize);
+int CompareSequencesAt(char *seq1, char *id1, char *seq2, char *id2,
+                       int diag);
+BOOL AlreadyChecked(char *seqid, int diag, BOOL add);
+BOOL ClusterResults(REAL identity);
+void Supersede(char *parent, char *child, int reason);
+BOOL OpenEvents(char *filename);
+void CloseEvents(char *filename);
+BOOL WriteClusters(char *filename);
+void WriteMergedHeader(OUTFILE *out, char *seqid, char *entry);
+BOOL SpoolStdin(char *filename);
+long SequenceIndex(datum content);
+void StoreEntry(char *key, char *file, long entryStart);
+char *NextKey(BOOL first, char **copy);
+BOOL ReadKey(SEQBUFF *sb);
+void StoreDuplicate(char *key, char *file, long entryStart);
+void RebuildBloom(long nKeys, int fragSize);
+BOOL MakeFragment(char *seq, int fragLen, char *fragment, datum *key);
+unsigned long FragmentHash(char *seq, int fragLen);
+int NFragments(int length, int fragSize);
+char *ReadEntry(SEQFILE *fp, long offset, BOOL full, SEQBUFF *sb,
+                long *nBytes);
+BOOL ServeFile(char *file, int fragSize, int rejectSize);
+void *OpenServeState(void);
+int ServeQuery(void *state, char *seq, long length, char **hit);
+int CheckCandidate(SERVESTATE *st, char *seq, long length, char *id,
+                   long diag);
+void TempName(char *name, char *base);
+BOOL UpdateFromState(char *stateFile, char *removedFile, int *fragSize,
+                     int *rejectSize);
+BOOL ReadState(char *filename, int *fragSize, int *rejectSize);
+BOOL ReadRemoved(char *filename);
+long BreakRemovedFamilies(void);
+BOOL ProbeRepresentatives(int fragSize);
+void AddRecheckAnchor(unsigned long hash);
+BOOL IsRechecked(char *seqid);
+BOOL InUpdate(char *key, char *file, long entryStart);
+BOOL WriteState(char *filename, int fragSize, int rejectSize);
+BOOL WriteStateEntry(FILE *fp, datum content, SEQBUFF *sb);
+int AutoFragSize(char **files, int nFiles, int fragSize, int rejectSize);
+long SampleFile(char *file, int quota, int rejectSize, char **seqs,
+                int *nSeqs);
 
 
 /************************************************************************/
@@ -201,17 +425,31 @@ void CleanupDie(int signum);
    Main program
 
    15.06.00 Original   By: ACRM
+   19.10.26 Added shard mode
+   19.10.26 Writes metrics
+   19.10.26 Clusters the results with -i
+   19.10.26 Writes cluster membership
+   19.10.26 Writes the event log
+   19.10.26 Output may be compressed
+   19.10.26 Added concurrent file mode
+   19.10.26 Added serving
+   19.10.26 Left out of the library
+   19.10.26 Added updating from a saved state
+   19.10.26 Added choosing the fragment size
 */
+#ifndef NR_LIBRARY
 int main(int argc, char **argv)
 {
    BOOL FirstIsNR  = FALSE;
    int  fragSize   = DEFAULT_FRAGSIZE,
         rejectSize = 2 * DEFAULT_FRAGSIZE,
         firstFile  = 0,
+        nShards    = 1,
         i;
-   char outfile[MAXBUFF],
-        *cptr;
-   FILE *out       = stdout;
+   char    outfile[MAXBUFF],
+           *cptr;
+   FILE    *out    = stdout;
+   OUTFILE *of;
 
    /* Set GDBM storage directory.
       Initially use the hard-coded default. Replace this with anything
@@ -229,9 +467,39 @@ int main(int argc, char **argv)
    signal((int)SIGINT, CleanupDie);
    
    if(ParseCmdLine(argc, argv, outfile, &FirstIsNR, &fragSize, 
-                   &firstFile, &rejectSize))
+                   &firstFile, &rejectSize, &nShards) &&
+      ((nShards == 1) || (gJobs == 1)) &&
+      !(gDNA && (gMismatches || (gIdentity > 0.0))) &&
+      !(gServeSocket[0] && 
+        ((argc-firstFile != 1) || gDNA || gMismatches || 
+         (gIdentity > 0.0) || (nShards > 1) || (gJobs > 1))) &&
+      !((gUpdateFile[0] || gStateFile[0]) &&
+        (FirstIsNR || (gIdentity > 0.0) || gServeSocket[0] || 
+         (nShards > 1) || (gJobs > 1))) &&
+      !(gRemovedFile[0] && !gUpdateFile[0]))
    {
-      if(firstFile && CreateHashes())
+      /* Choose the fragment size from a sample of the input (an update
+         uses the one in the state)
+      */
+      if(gAutoFragSize && firstFile && !gUpdateFile[0])
+      {
+         fragSize = AutoFragSize(argv+firstFile, argc-firstFile, 
+                                 fragSize, rejectSize);
+      }
+
+      gLocators = (gMergeDeflines || gStateFile[0]);
+      gForest   = (gClusterFile[0] || gMergeDeflines || gStateFile[0] ||
+                   gUpdateFile[0]);
+
+      if(firstFile && gServeSocket[0] && CreateHashes())
+      {
+         /* Load the file and answer queries until killed               */
+         signal((int)SIGTERM, CleanupDie);
+         ServeFile(argv[firstFile], fragSize, rejectSize);
+         CleanUp();
+         return(1);
+      }
+      else if((firstFile || gUpdateFile[0]) && CreateHashes())
       {
          /* Open a different output file if specified                   */
          if(outfile[0])
@@ -242,18 +510,81 @@ int main(int argc, char **argv)
                return(1);
             }
          }
-         
-         /* Step through each input file                                */
-         for(i=firstFile; i<argc; i++)
+         if((of = OpenOutFile(out, gCompress))==NULL)
          {
-            NonRedundantise(argv[i], 
-                            ((i==firstFile)?FirstIsNR:FALSE),
-                            fragSize, rejectSize);
+            fprintf(stderr,"E003: No memory for output buffers\n");
+            return(1);
          }
          
-         /* Write the NR output                                         */
-         WriteResults(out);
+         if(nShards > 1)
+         {
+            /* Farm the input out to worker processes, reconcile their
+               results and write the NR output
+            */
+            RunShards(argv+firstFile, argc-firstFile, FirstIsNR,
+                      fragSize, rejectSize, nShards, of);
+         }
+         else if((gJobs > 1) && (argc-firstFile > 1))
+         {
+            /* Make each input file non-redundant in its own worker 
+               process, reconcile their results and write the NR output
+            */
+            RunJobs(argv+firstFile, argc-firstFile, FirstIsNR,
+                    fragSize, rejectSize, gJobs, of);
+         }
+         else
+         {
+            if(gEventFile[0])
+               OpenEvents(gEventFile);
+
+            /* Start from the saved state if updating                   */
+            if(gUpdateFile[0] && 
+               !UpdateFromState(gUpdateFile, gRemovedFile, 
+                                &fragSize, &rejectSize))
+            {
+               CleanUp();
+               return(1);
+            }
+
+            /* Step through each input file                             */
+            for(i=firstFile; firstFile && (i<argc); i++)
+            {
+               NonRedundantise(argv[i], 
+                               ((i==firstFile)?FirstIsNR:FALSE),
+                               fragSize, rejectSize);
+            }
+
+            /* Cluster the survivors at the given identity              */
+            if(gIdentity > 0.0)
+            {
+               ClusterResults(gIdentity);
+            }
+            
+            /* Write the NR output                                      */
+            WriteResults(of, gMergeDeflines);
+            CloseEvents(gEventFile);
+         }
+         if(!CloseOutFile(of))
+         {
+            fprintf(stderr,"E001: Can't write %s\n", 
+                    (outfile[0]?outfile:"output"));
+         }
          if(out!=stdout) fclose(out);
+
+         if(gClusterFile[0] && !WriteClusters(gClusterFile))
+         {
+            fprintf(stderr,"E001: Can't write %s\n", gClusterFile);
+         }
+
+         if(gStateFile[0] && !WriteState(gStateFile, fragSize, rejectSize))
+         {
+            fprintf(stderr,"E001: Can't write %s\n", gStateFile);
+         }
+
+         if(gMetricsFile[0] && !WriteMetrics(gMetricsFile))
+         {
+            fprintf(stderr,"E001: Can't write %s\n", gMetricsFile);
+         }
       }
       CleanUp();
    }
@@ -264,12 +595,13 @@ int main(int argc, char **argv)
 
    return(0);
 }
+#endif
 
 
 /************************************************************************/
 /*>BOOL ParseCmdLine(int argc, char **argv, char *outfile, 
                      BOOL *FirstIsNR, int *fragSize, int *firstFile,
-                     int *rejectSize)
+                     int *rejectSize, int *nShards)
    -----------------------------------------------------------------
    Input:   int    argc         Argument count
             char   **argv       Argument array
@@ -278,24 +610,47 @@ int main(int argc, char **argv)
             int    *fragSize    Fragment size for hashing
             int    *firstFile   Offset into argv of first input file
             int    *rejectSize  Reject sequences shorter than this
+            int    *nShards     Number of shard worker processes
    Returns: BOOL                Success?
 
    Parse the command line
    
    09.06.00 Original    By: ACRM
+   19.10.26 Added -s, -m and -p
+   19.10.26 Added -k
+   19.10.26 Added -i
+   19.10.26 Added -c and -a
+   19.10.26 Added -b
+   19.10.26 Added -z
+   19.10.26 - on its own is taken as a filename (stdin)
+   19.10.26 Added -w
+   19.10.26 Added -j
+   19.10.26 Added -I
+   19.10.26 Added -D
+   19.10.26 Added -S and -t
+   19.10.26 Added -e, -u and -x
+   19.10.26 Added -f auto
 */
 BOOL ParseCmdLine(int argc, char **argv, char *outfile, BOOL *FirstIsNR, 
-                  int *fragSize, int *firstFile, int *rejectSize)
+                  int *fragSize, int *firstFile, int *rejectSize,
+                  int *nShards)
 {
    argc--;
    argv++;
 
    outfile[0] = '\0';
+   gMetricsFile[0] = '\0';
+   gClusterFile[0] = '\0';
+   gEventFile[0]   = '\0';
+   gServeSocket[0] = '\0';
+   gStateFile[0]   = '\0';
+   gUpdateFile[0]  = '\0';
+   gRemovedFile[0] = '\0';
    *firstFile=1;
    
    while(argc)
    {
-      if(argv[0][0] == '-')
+      if((argv[0][0] == '-') && argv[0][1])
       {
          switch(argv[0][1])
          {
@@ -310,6 +665,13 @@ BOOL ParseCmdLine(int argc, char **argv, char *outfile, BOOL *FirstIsNR,
             outfile[MAXBUFF-1] = '\0';
             (*firstFile)+=2;
             break;
+         case 'm':
+            argc--;
+            argv++;
+            strncpy(gMetricsFile,argv[0],MAXBUFF);
+            gMetricsFile[MAXBUFF-1] = '\0';
+            (*firstFile)+=2;
+            break;
          case 'd':
             argc--;
             argv++;
@@ -320,7 +682,10 @@ BOOL ParseCmdLine(int argc, char **argv, char *outfile, BOOL *FirstIsNR,
          case 'f':
             argc--;
             argv++;
-            sscanf(argv[0],"%d",fragSize);
+            if(!strcmp(argv[0], "auto"))
+               gAutoFragSize = TRUE;
+            else
+               sscanf(argv[0],"%d",fragSize);
             (*firstFile)+=2;
             break;
          case 'r':
@@ -329,10 +694,127 @@ BOOL ParseCmdLine(int argc, char **argv, char *outfile, BOOL *FirstIsNR,
             sscanf(argv[0],"%d",rejectSize);
             (*firstFile)+=2;
             break;
+         case 's':
+            argc--;
+            argv++;
+            sscanf(argv[0],"%d",nShards);
+            if(*nShards < 1)
+               return(FALSE);
+            (*firstFile)+=2;
+            break;
+         case 'j':
+            argc--;
+            argv++;
+            if(!sscanf(argv[0],"%d",&gJobs) || (gJobs < 1))
+               return(FALSE);
+            (*firstFile)+=2;
+            break;
+         case 'I':
+            argc--;
+            argv++;
+            if((gIDRule = IDRuleFromName(argv[0])) < 0)
+               return(FALSE);
+            (*firstFile)+=2;
+            break;
+         case 'S':
+            argc--;
+            argv++;
+            strncpy(gServeSocket,argv[0],MAXBUFF);
+            gServeSocket[MAXBUFF-1] = '\0';
+            (*firstFile)+=2;
+            break;
+         case 't':
+            argc--;
+            argv++;
+            if(!sscanf(argv[0],"%d",&gServeThreads) || 
+               (gServeThreads < 1))
+               return(FALSE);
+            (*firstFile)+=2;
+            break;
+         case 'D':
+            gDNA     = TRUE;
+            gUnknown = 'N';
+            (*firstFile)++;
+            break;
+         case 'k':
+            argc--;
+            argv++;
+            sscanf(argv[0],"%d",&gMismatches);
+            if(gMismatches < 0)
+               return(FALSE);
+            (*firstFile)+=2;
+            break;
+         case 'i':
+            argc--;
+            argv++;
+            sscanf(argv[0],"%lf",&gIdentity);
+            if(gIdentity > 1.0)        /* Given as a percentage         */
+               gIdentity /= 100.0;
+            if((gIdentity < 0.0) || (gIdentity > 1.0))
+               return(FALSE);
+            (*firstFile)+=2;
+            break;
+         case 'c':
+            argc--;
+            argv++;
+            strncpy(gClusterFile,argv[0],MAXBUFF);
+            gClusterFile[MAXBUFF-1] = '\0';
+            (*firstFile)+=2;
+            break;
+         case 'b':
+            argc--;
+            argv++;
+            strncpy(gEventFile,argv[0],MAXBUFF);
+            gEventFile[MAXBUFF-1] = '\0';
+            (*firstFile)+=2;
+            break;
+         case 'e':
+            argc--;
+            argv++;
+            strncpy(gStateFile,argv[0],MAXBUFF);
+            gStateFile[MAXBUFF-1] = '\0';
+            (*firstFile)+=2;
+            break;
+         case 'u':
+            argc--;
+            argv++;
+            strncpy(gUpdateFile,argv[0],MAXBUFF);
+            gUpdateFile[MAXBUFF-1] = '\0';
+            (*firstFile)+=2;
+            break;
+         case 'x':
+            argc--;
+            argv++;
+            strncpy(gRemovedFile,argv[0],MAXBUFF);
+            gRemovedFile[MAXBUFF-1] = '\0';
+            (*firstFile)+=2;
+            break;
+         case 'a':
+            gMergeDeflines = TRUE;
+            (*firstFile)++;
+            break;
+         case 'z':
+            argc--;
+            argv++;
+            if(!sscanf(argv[0],"%d",&gCompress) || (gCompress < 1))
+               return(FALSE);
+            (*firstFile)+=2;
+            break;
+         case 'w':
+            argc--;
+            argv++;
+            if(!sscanf(argv[0],"%d",&gWindow) || (gWindow < 0))
+               return(FALSE);
+            (*firstFile)+=2;
+            break;
          case 'v':
             gVerbose++;
             (*firstFile)++;
             break;
+         case 'p':
+            gProgress = TRUE;
+            (*firstFile)++;
+            break;
          default:
             return(FALSE);
             break;
@@ -356,12 +838,9 @@ BOOL ParseCmdLine(int argc, char **argv, char *outfile, BOOL *FirstIsNR,
 BOOL CreateHashes(void)
 {
    char  name[MAXBUFF];
-   pid_t pid;
 
    /* Open the hashes we use read/write                                 */
-   pid = getpid();
-      
-   sprintf(name,"%s/%s.%d",gGDBMDir,DEFAULT_SEQHASH,pid);
+   TempName(name, DEFAULT_SEQHASH);
    if((gDBF_seqdata = gdbm_open(name, BLOCK_SIZE, 
                                 GDBM_WRCREAT|GDBM_FAST, 
                                 MODE, NULL))==NULL)
@@ -370,16 +849,16 @@ BOOL CreateHashes(void)
       return(FALSE);
    }
    
-   sprintf(name,"%s/%s.%d",gGDBMDir,DEFAULT_TEMPSEQHASH,pid);
-   if((gDBF_seqdata_temp = gdbm_open(name, BLOCK_SIZE, 
-                                     GDBM_WRCREAT|GDBM_FAST, 
-                                     MODE, NULL))==NULL)
+   /* The key file is deleted as soon as it is open                    */
+   TempName(name, DEFAULT_KEYFILE);
+   if((gKeys = fopen(name, "w+")) == NULL)
    {
-      fprintf(stderr,"E002: Can't open GDBM hash for r/w: %s\n", name);
+      fprintf(stderr,"E001: Can't write %s\n", name);
       return(FALSE);
    }
+   unlink(name);
    
-   sprintf(name,"%s/%s.%d",gGDBMDir,DEFAULT_FRAGHASH,pid);
+   TempName(name, DEFAULT_FRAGHASH);
    if((gDBF_fragdata = gdbm_open(name, BLOCK_SIZE, 
                                  GDBM_WRCREAT|GDBM_FAST,
                                  MODE, NULL))==NULL)
@@ -389,7 +868,7 @@ BOOL CreateHashes(void)
       return(FALSE);
    }
 
-   sprintf(name,"%s/%s.%d",gGDBMDir,DEFAULT_FRAGTABLE,pid);
+   TempName(name, DEFAULT_FRAGTABLE);
    if((gDBF_fragtable = gdbm_open(name, BLOCK_SIZE, 
                                  GDBM_WRCREAT|GDBM_FAST,
                                  MODE, NULL))==NULL)
@@ -399,16 +878,6 @@ BOOL CreateHashes(void)
       return(FALSE);
    }
 
-   sprintf(name,"%s/%s.%d",gGDBMDir,DEFAULT_DELETEDHASH,pid);
-   if((gDBF_deleted = gdbm_open(name, BLOCK_SIZE, 
-                                 GDBM_WRCREAT|GDBM_FAST,
-                                 MODE, NULL))==NULL)
-   {
-      fprintf(stderr,"E002: Can't open GDBM hash for r/w: %s\n", 
-              name);
-      return(FALSE);
-   }
-
    return(TRUE);
 }
 
@@ -416,41 +885,71 @@ BOOL CreateHashes(void)
 /************************************************************************/
 /*>void CleanUp(void)
    ------------------
-   Removes the hash files 
+   Removes the hash files and any copy of stdin made for shard workers
 
    15.06.00 Original   By: ACRM
+   19.10.26 Also removes the copy of stdin
+   19.10.26 Also removes the server's socket
+   19.10.26 Files are named by TempName(). Closed handles are cleared
 */
 void CleanUp(void)
 {
    char name[MAXBUFF];
-   pid_t pid;
 
-   gdbm_close(gDBF_seqdata_temp);
-   gdbm_close(gDBF_seqdata);
-   gdbm_close(gDBF_fragdata);
-   gdbm_close(gDBF_fragtable);
-   gdbm_close(gDBF_deleted);
-
-   pid = getpid();
-   sprintf(name,"%s/%s.%d",gGDBMDir,DEFAULT_SEQHASH,pid);
-   unlink(name);
-   sprintf(name,"%s/%s.%d",gGDBMDir,DEFAULT_TEMPSEQHASH,pid);
+   if(gKeys != NULL)
+      fclose(gKeys);
+   if(gDBF_seqdata != NULL)
+      gdbm_close(gDBF_seqdata);
+   if(gDBF_fragdata != NULL)
+      gdbm_close(gDBF_fragdata);
+   if(gDBF_fragtable != NULL)
+      gdbm_close(gDBF_fragtable);
+   gKeys          = NULL;
+   gDBF_seqdata   = gDBF_fragdata = gDBF_fragtable = NULL;
+
+   TempName(name, DEFAULT_SEQHASH);
    unlink(name);
-   sprintf(name,"%s/%s.%d",gGDBMDir,DEFAULT_FRAGHASH,pid);
+   TempName(name, DEFAULT_FRAGHASH);
    unlink(name);
-   sprintf(name,"%s/%s.%d",gGDBMDir,DEFAULT_FRAGTABLE,pid);
+   TempName(name, DEFAULT_FRAGTABLE);
    unlink(name);
-   sprintf(name,"%s/%s.%d",gGDBMDir,DEFAULT_DELETEDHASH,pid);
+   TempName(name, DEFAULT_STDINFILE);
    unlink(name);
+   if(gServeSocket[0])
+      unlink(gServeSocket);
 }
 
 
 /************************************************************************/
-/*>BOOL ReadSequences(FILE *in, char *file, int rejectSize)
-   --------------------------------------------------------
-   Input:     FILE   *in      FASTA file to read
-              char   *file    Filename
-   Returns:   BOOL            Success?
+/*>void TempName(char *name, char *base)
+   -------------------------------------
+   Input:     char   *base      Base name (DEFAULT_SEQHASH, etc.)
+   Output:    char   *name      Full name of the file
+
+   Names one of our temporary files in gGDBMDir. The process ID is added
+   so that several runs can share the directory, and the instance number
+   of a library context so that contexts in one process don't collide.
+
+   19.10.26 Original
+*/
+void TempName(char *name, char *base)
+{
+   if(gInstance)
+      sprintf(name,"%s/%s.%d.%d",gGDBMDir,base,(int)getpid(),gInstance);
+   else
+      sprintf(name,"%s/%s.%d",gGDBMDir,base,(int)getpid());
+}
+
+
+/************************************************************************/
+/*>BOOL ReadSequences(SEQFILE *in, char *file, int rejectSize, 
+                      int fragSize)
+   ----------------------------------------------------------------
+   Input:     SEQFILE *in        FASTA file to read
+              char   *file       Filename
+              int    rejectSize  Reject sequences up to this length
+              int    fragSize    Fragment size (used to pick the shard)
+   Returns:   BOOL               Success?
 
    Read a sequence file into a GDBM hash. Checks for duplicate IDs during
    loading.
@@ -464,154 +963,248 @@ void CleanUp(void)
             Added code to reject seqs <= 2*DEFAULT_FRAGSIZE
    12.07.00 rejectSize passed in as parameter instead of 
             2*DEFAULT_FRAGSIZE
+   19.10.26 Skips sequences belonging to other shards
+            Records metrics and progress
+   19.10.26 Reads through a SEQFILE so the offsets may be BGZF virtual
+            offsets
+   19.10.26 Stores through StoreEntry()
+   19.10.26 Reads whole lines with SeqFileGetLine() and collects the
+            residues in a SEQBUFF, so headers and sequences may be any
+            length. Sequences with too many Xs are dropped here
+   19.10.26 The identifier is found by FindID() using the rule given
+            with -I and may be any length
+   19.10.26 Skips anything before the first entry
 */
-BOOL ReadSequences(FILE *in, char *file, int rejectSize)
+BOOL ReadSequences(SEQFILE *in, char *file, int rejectSize, int fragSize)
 {
-   char      ptr[HUGEBUFF], *id,
-             key[MAX_KEY_LEN],
-             *sequence;
-   datum     gdbm_seq_seqid,
-             gdbm_seq_seqdata;
+   static SEQBUFF sSeq = {NULL, 0, 0, 0},
+                  sKey = {NULL, 0, 0, 0};
+   char      *line, 
+             *id;
+   int       length,
+             idLength;
    long      entryStart = (-1),
-             thisEntryStart;
+             lineStart;
+   BOOL      retval = TRUE;
    
    if(gVerbose > 1)
    {
       fprintf(stderr,"TRACE: Reading Sequences...\n");
    }
+   MetricsStartStage(STAGE_READ);
+
+   /* Use the file size to estimate progress                            */
+   if(gProgress)
+   {
+      SetProgressTotals(0L, SeqFileSize(in));
+   }
    
    /* Read through the FASTA input file using a GDBM hash to store the
       sequence keyed by its identifier
    */
-   sequence = NULL;
-   key[0]   = '\0';
-   while((fgets(ptr,HUGEBUFF,in))!=NULL)
+   sSeq.length = sSeq.nX = 0;
+   sKey.length = 0;
+   if(!AppendToSeqBuff(&sSeq, "", 0, FALSE) ||   /* Allocate them      */
+      !AppendToSeqBuff(&sKey, "", 0, FALSE))
+      return(FALSE);
+   lineStart = SeqFileTell(in);
+   while((line = SeqFileGetLine(in, &length))!=NULL)
    {
-      if(*ptr == '>')             /* Start of new entry                 */
+      METRIC_ADD(bytesRead, length);
+      
+      if(*line == '>')            /* Start of new entry                 */
       {
-         thisEntryStart = ftell(in) - strlen(ptr);
-         
          /* If we have a sequence already then store it                 */
-         if(entryStart != (-1) && key[0])
+         if(entryStart != (-1) && sKey.length)
          {
-            char entryStartString[80];
-            char *sptr;
-            sptr = strchr(sequence,'\n');
-            if(sptr == NULL)
-               sptr = sequence;
-
-            if(strlen(sptr) > rejectSize)
-            {
-               sprintf(entryStartString,"%s %ld", file, entryStart);
-               
-               CREATEDATUM(gdbm_seq_seqid,   key);
-               CREATEDATUM(gdbm_seq_seqdata, entryStartString);
-               
-               if(gdbm_store(gDBF_seqdata_temp, gdbm_seq_seqid, 
-                             gdbm_seq_seqdata, GDBM_INSERT))
-               {
-                  fprintf(stderr,"W001: Duplicate ID: %s\n", 
-                          key);
-               }
-            }
-            else if(gVerbose)
-            {
-               TERMINATE(key);
-               fprintf(stderr,"INFO: Sequence %s rejected. Only %d \
-residues\n",
-                       key, strlen(sptr));
-            }
-            
-            free(sequence);
-            sequence = NULL;
+            StoreRecord(sKey.data, file, entryStart, &sSeq, rejectSize,
+                        fragSize);
          }
+         sSeq.length = sSeq.nX = 0;
          
-         /* Find the identifier                                         */
-         if((id = strchr(ptr, '|'))!=NULL)
-         {
-            strncpy(key, id+1, MAX_KEY_LEN-1);
-            key[MAX_KEY_LEN-1] = '\0';
-            
-            /* If the original string (ptr) started with PDB we need to
-               take the chain name if specified
-            */
-            if(!strncmp(ptr+1,"pdb",3))
-            {
-               TERMINATE(key);
-               if((id = strchr(key, '|'))!=NULL)
-               {
-                  if(*(id+1))
-                  {
-                     *(id+2) = '\0';
-                  }
-                  else
-                  {
-                     *id = '\0';
-                  }
-               }
-            }
-            else  /* Something other than PDB, just take the ID         */
-            {
-               if((id = strchr(key, '|'))!=NULL)
-               {
-                  *id = '\0';
-               }
-            }
-         }
-         else
+         /* Find the identifier and keep a copy of it (the line buffer 
+            is reused for the sequence)
+         */
+         id = FindID(line, length, gIDRule, &idLength);
+         sKey.length = 0;
+         if(!AppendToSeqBuff(&sKey, id, idLength, FALSE))
          {
-            strncpy(key,ptr+1,MAX_KEY_LEN);
-            key[MAX_KEY_LEN-1] = '\0';
+            retval = FALSE;
+            break;
          }
-         
 
          /* Update the pointer to the start of this entry               */
-         entryStart = thisEntryStart;
+         entryStart = lineStart;
       }
-      else
+      else if(entryStart == (-1))
+      {
+         /* Skip anything before the first entry                        */
+      }
+      else if(!AppendToSeqBuff(&sSeq, line, length, TRUE))
       {
-         TERMINATE(ptr);
+         retval = FALSE;
+         break;
       }
 
-      /* Build this line into the sequence string                       */
-      sequence = strcatalloc(sequence, ptr);
+      lineStart = SeqFileTell(in);
    }
    
    /* If we have a sequence already then store it                       */
-   if((entryStart != (-1)) && key[0])
+   if(retval && (entryStart != (-1)) && sKey.length)
    {
-      char entryStartString[80];
-      char *sptr;
-      sptr = strchr(sequence,'\n');
-      if(sptr == NULL)
-         sptr = sequence;
-            
-      if(strlen(sptr) > rejectSize)
+      StoreRecord(sKey.data, file, entryStart, &sSeq, rejectSize, fragSize);
+   }
+
+   MetricsEndStage();
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>void StoreRecord(char *key, char *file, long entryStart, SEQBUFF *seq,
+                    int rejectSize, int fragSize)
+   ----------------------------------------------------------------------
+   Input:     char    *key        Sequence ID
+              char    *file       Filename
+              long    entryStart  Offset of the entry in the file
+              SEQBUFF *seq        The residues read for the entry
+              int     rejectSize  Reject sequences up to this length
+              int     fragSize    Fragment size (used to pick the shard)
+
+   Stores an entry read by ReadSequences() unless it belongs to another
+   shard, is not wanted in this pass of an update, is too short or has
+   too many Xs. The length and number of Xs were counted as the residues
+   were read, so the sequence doesn't need to be looked at again.
+
+   19.10.26 Original (split out of ReadSequences())
+   19.10.26 Skips sequences not wanted in an update
+*/
+void StoreRecord(char *key, char *file, long entryStart, SEQBUFF *seq,
+                 int rejectSize, int fragSize)
+{
+   METRIC(seqsIn);
+   PROGRESS();
+   if(!InShard(seq->data, fragSize))
+   {
+      /* Another shard worker will deal with this one                   */
+   }
+   else if(!InUpdate(key, file, entryStart))
+   {
+      /* Not wanted in this pass of an update                           */
+   }
+   else if(seq->length < rejectSize)
+   {
+      if(gVerbose)
       {
-         sprintf(entryStartString,"%s %ld", file, entryStart);
-         
-         CREATEDATUM(gdbm_seq_seqid,     key);
-         CREATEDATUM(gdbm_seq_seqdata, entryStartString);
-         
-         if(gdbm_store(gDBF_seqdata_temp, gdbm_seq_seqid, 
-                       gdbm_seq_seqdata, GDBM_INSERT))
-         {
-            fprintf(stderr,"Warning (W001): Duplicate ID: %s\n", key);
-         }
+         fprintf(stderr,"INFO: Sequence %s rejected. Only %ld residues\n",
+                 key, seq->length);
       }
-      else if(gVerbose)
+   }
+   else if(TooManyXs(seq->nX, seq->length))
+   {
+      fprintf(stderr,"W002: Too many %cs in sequence %s\n", gUnknown, key);
+      Supersede(NULL, key, EVENT_TOO_MANY_XS);
+      METRIC(dropped);
+   }
+   else
+   {
+      StoreEntry(key, file, entryStart);
+   }
+}
+
+
+/************************************************************************/
+/*>BOOL AppendToSeqBuff(SEQBUFF *sb, char *text, int length, BOOL strip)
+   ---------------------------------------------------------------------
+   I/O:       SEQBUFF *sb         Buffer to add to
+   Input:     char    *text       Line to add
+              int     length      Its length
+              BOOL    strip       Remove the newline from the line
+   Returns:   BOOL                Success?
+
+   Adds a line to a SEQBUFF, doubling its size whenever it fills up so
+   that long sequences are built in linear time. The Xs (Ns with -D) 
+   are counted as the line is copied. The buffer is kept NUL-terminated.
+   With -D, sequence lines are put in upper case so that soft-masked
+   bases compare equal to the rest.
+
+   19.10.26 Original
+*/
+BOOL AppendToSeqBuff(SEQBUFF *sb, char *text, int length, BOOL strip)
+{
+   char *data,
+        *dest;
+   long size,
+        nX = 0;
+   int  i;
+
+   if(strip && length && (text[length-1] == '\n'))
+      length--;
+
+   if(sb->length + length + 1 > sb->size)
+   {
+      for(size = (sb->size ? sb->size : SEQFILE_LINE);
+          size < sb->length + length + 1;
+          size *= 2);
+      if((data = (char *)realloc(sb->data, size))==NULL)
       {
-         fprintf(stderr,"INFO: Sequence %s rejected. Only %d residues\n",
-                 key, strlen(sequence));
+         fprintf(stderr,"E003: No memory for sequence of %ld residues\n",
+                 sb->length + length);
+         return(FALSE);
       }
-      free(sequence);
-      sequence = NULL;
+      sb->data = data;
+      sb->size = size;
    }
 
+   dest = sb->data + sb->length;
+   for(i=0; i<length; i++)
+   {
+      dest[i] = ((strip && gDNA) ? toupper(text[i]) : text[i]);
+      if(dest[i] == gUnknown)
+         nX++;
+   }
+   dest[length] = '\0';
+   sb->length += length;
+   sb->nX     += nX;
    return(TRUE);
 }
 
 
+/************************************************************************/
+/*>BOOL InShard(char *seq, int fragSize)
+   -------------------------------------
+   Input:     char   *seq       Sequence (without header)
+              int    fragSize   Fragment size
+   Returns:   BOOL              Does this sequence belong to our shard?
+
+   In shard mode, each worker process only takes the sequences whose 
+   N-terminal (anchor) fragment hashes to that worker. Identical 
+   sequences and sequences which only differ at the C-terminus therefore
+   meet in the same worker and are removed there. Anything missed because
+   the sequences ended up in different workers is picked up by the 
+   reconciliation pass in RunShards().
+
+   Always returns TRUE when we are not running as a shard worker.
+
+   19.10.26 Original
+*/
+BOOL InShard(char *seq, int fragSize)
+{
+   unsigned long hash = 0;
+   int           i;
+
+   if(gShard < 0)
+      return(TRUE);
+
+   for(i=0; (i<fragSize-1) && seq[i]; i++)
+   {
+      hash = (hash * 31) + (unsigned char)seq[i];
+   }
+
+   return((hash % (unsigned long)gNShards) == (unsigned long)gShard);
+}
+
+
 /************************************************************************/
 /*>BOOL HashSequences(int fragSize, BOOL loadOnly)
    -----------------------------------------------
@@ -625,55 +1218,99 @@ residues\n",
    This the has keys are sequence fragments; the data are the sequence IDs
 
    15.06.00 Original   By: ACRM
+   19.10.26 Records metrics
+   19.10.26 Stores seeds in mismatch mode
+   19.10.26 Rebuilds the Bloom filter when needed
+   19.10.26 Loops through the key file
+   19.10.26 Sequences with too many Xs are now dropped by 
+            ReadSequences()
+   19.10.26 Stores seeds when serving
+   19.10.26 Reuses one sequence buffer
+   19.10.26 Hashes duplicates of sequences from earlier files
 */
 BOOL HashSequences(int fragSize, BOOL loadOnly)
 {
-   char      *data;
+   static SEQBUFF sSeq = {NULL, 0, 0, 0};
+   char      *data,
+             *key,
+             *copy;
    datum     gdbm_seq_seqid,
              gdbm_seq_seqdata;
+   BOOL      retval,
+             first = TRUE;
    
    if(gVerbose > 1)
    {
       fprintf(stderr,"TRACE: Hashing Sequence Fragments...\n");
    }
+   MetricsStartStage(STAGE_HASH);
+   SetProgressTotals(gNTempSeqs + gNTempDups, 0L);
+
+   if(!gMismatches && !gServeFile && 
+      BloomStale(gNSeqs + gNTempSeqs + gNTempDups))
+   {
+      RebuildBloom(gNSeqs + gNTempSeqs + gNTempDups, fragSize);
+   }
    
-   gdbm_seq_seqid = gdbm_firstkey(gDBF_seqdata_temp);
-   while(gdbm_seq_seqid.dptr)
+   while((key = NextKey(first, &copy)) != NULL)
    {
-      gdbm_seq_seqdata = gdbm_fetch(gDBF_seqdata_temp, gdbm_seq_seqid);
+      first = FALSE;
+      METRIC(seqsIn);
+      PROGRESS();
+      CREATEDATUM(gdbm_seq_seqid, key);
+
+      /* A duplicate is hashed from where it is rather than the 
+         sequence with this ID from an earlier file
+      */
+      if(copy != NULL)
+      {
+         CREATEDATUM(gdbm_seq_seqdata, copy);
+      }
+      else
+      {
+         gdbm_seq_seqdata = gdbm_fetch(gDBF_seqdata, gdbm_seq_seqid);
+      }
       
-      if((data = GetSequence(gdbm_seq_seqdata, FALSE))!=NULL)
+      if((data = FetchSequence(gdbm_seq_seqdata, FALSE, &sSeq))!=NULL)
       {
-         if(TooManyXs(data))
+         if(gMismatches || gServeFile)
          {
-            fprintf(stderr,"W002: Too many Xs in sequence %s\n", 
-                    gdbm_seq_seqid.dptr);
-            DropSequence(gdbm_seq_seqid.dptr);
+            StoreSequenceSeeds(data, fragSize, gdbm_seq_seqid);
          }
          else
          {
             StoreSequenceFragment(data, fragSize, gdbm_seq_seqid, 
                                   loadOnly);
          }
-         free(data);
       }
-      if(gdbm_seq_seqdata.dptr!=NULL)
+      if((copy == NULL) && (gdbm_seq_seqdata.dptr!=NULL))
       {
          free(gdbm_seq_seqdata.dptr);
       }
-      gdbm_seq_seqid=gdbm_nextkey(gDBF_seqdata_temp,gdbm_seq_seqid);
    }
 
-   return(PurgeDeletedSequences());
+   retval = PurgeDeletedSequences();
+   MetricsEndStage();
+   return(retval);
 }
 
 
 /************************************************************************/
-BOOL TooManyXs(char *seq)
+/*>BOOL TooManyXs(long nX, long length)
+   ------------------------------------
+   Input:     long   nX         Number of Xs in a sequence
+              long   length     Length of the sequence
+   Returns:   BOOL              Are more than TOO_MANY_X_FRAC of the
+                                residues X?
+
+   19.10.26 Takes the counts made by AppendToSeqBuff() rather than
+            scanning the sequence
+*/
+BOOL TooManyXs(long nX, long length)
 {
-   if(strchr(seq, 'X'))
+   if(nX)
    {
-      if(((REAL)countchar(seq,'X') / (REAL)strlen(seq)) > TOO_MANY_X_FRAC)
+      if(((REAL)nX / (REAL)length) > TOO_MANY_X_FRAC)
          return(TRUE);
    }
    return(FALSE);
@@ -697,54 +1334,95 @@ BOOL TooManyXs(char *seq)
    we've managed to store the sequence. If we never find a unique
    fragment, generate a warning message.
 
+   Unless -w 0 was given, the minimizers of the sequence are tried 
+   first, from the N-terminus. Only if they are all taken do we slide
+   along the other fragments, and the one chosen is then added to the
+   extra anchors so that doDropRedundancy() still looks it up.
+
    15.06.00 Original By: ACRM 
+   19.10.26 Tries the minimizers first
+   19.10.26 Adds the fragment to the Bloom filter
+   19.10.26 Fragments made by MakeFragment()
+   19.10.26 Fragment buffer grows to the fragment size in use
+   19.10.26 Notes the anchors of sequences checked again in an update
 */
 void StoreSequenceFragment(char *data, 
                            int fragSize,
                            datum gdbm_seq_seqid, BOOL loadOnly)
 {
-   static char *sFragment=NULL;
-   int         maxoffset,
-               offset;
-   BOOL        done     = FALSE;
-   datum       gdbm_frag_key,
-               gdbm_seq_seqdata;
-
-
-   if(sFragment==NULL)
+   static char   *sFragment=NULL;
+   static int    sFragSize=0;
+   int           maxoffset,
+                 offset,
+                 pass;
+   BOOL          done     = FALSE;
+   datum         gdbm_frag_key,
+                 gdbm_seq_seqdata;
+   unsigned long *hashes  = NULL,
+                 hash;
+   char          *isMin   = NULL;
+
+
+   if(fragSize > sFragSize)
    {
-      /* Allocate memory for fragment storage                           */
-      if((sFragment = (char *)malloc((fragSize+1) * sizeof(char)))==NULL)
+      /* Allocate memory for fragment storage (grown if a library 
+         context uses a bigger fragment size)
+      */
+      if((sFragment = (char *)realloc(sFragment, 
+                                      (fragSize+1) * sizeof(char)))==NULL)
       {
          fprintf(stderr,"E003: No memory for fragment storage\n");
          exit(1);
       }
+      sFragSize = fragSize;
    }
    
    /* Find max possible offset for a fragment                           */
-   maxoffset = strlen(data) - fragSize;
+   maxoffset = NFragments(strlen(data), fragSize);
+
+   if(gWindow && 
+      (FindMinimizers(data, maxoffset, fragSize-1, gWindow, FragmentHash,
+                      &hashes, &isMin) < 0))
+   {
+      fprintf(stderr,"E003: No memory for minimizers\n");
+      exit(1);
+   }
    
    /* Keep trying until we've suceeded in inserting this sequence or
-      decided that it is redundant
+      decided that it is redundant. The first pass tries just the 
+      minimizers and the second the rest of the fragments.
    */
-   for(offset=0; offset<maxoffset; offset++)
+   for(pass=(gWindow?0:1); (pass<2) && !done; pass++)
    {
-      strncpy(sFragment, data+offset, fragSize);
-      sFragment[fragSize-1] = '\0';
-
-      CREATEDATUM(gdbm_frag_key, sFragment);
-
-      /* Try to store this fragment in the hash                         */
-      if(!gdbm_store(gDBF_fragdata, gdbm_frag_key, gdbm_seq_seqid, 
-                     GDBM_INSERT))
+      for(offset=0; offset<maxoffset; offset++)
       {
-         /* Stored OK, store the reverse version as well and break out of
-            the loop                            
-         */
-         gdbm_store(gDBF_fragtable, gdbm_seq_seqid, gdbm_frag_key, 
-                    GDBM_INSERT);
-         done = TRUE;
-         break;
+         if(gWindow && (isMin[offset] != (pass==0)))
+            continue;
+         
+         if(!MakeFragment(data+offset, fragSize-1, sFragment, 
+                          &gdbm_frag_key))
+            continue;
+
+         /* Try to store this fragment in the hash                      */
+         METRIC(hashProbes);
+         if(!gdbm_store(gDBF_fragdata, gdbm_frag_key, gdbm_seq_seqid, 
+                        GDBM_INSERT))
+         {
+            /* Stored OK, store the reverse version as well and break 
+               out of the loop                            
+            */
+            gdbm_store(gDBF_fragtable, gdbm_seq_seqid, gdbm_frag_key, 
+                       GDBM_INSERT);
+            hash = (gWindow ? hashes[offset] : 
+                    FragmentHash(data+offset, fragSize-1));
+            BloomAdd(hash);
+            if(gWindow && (pass==1))
+               AddExtraAnchor(hash);
+            if(gUpdatePass == UPDATE_RECHECK)
+               AddRecheckAnchor(hash);
+            done = TRUE;
+            break;
+         }
       }
    }
 
@@ -754,13 +1432,14 @@ void StoreSequenceFragment(char *data,
       {
          fprintf(stderr,"W003: Can't find unique fragment. Unable to \
 store %s (length=%d)\n", gdbm_seq_seqid.dptr, strlen(data));
+         Supersede(NULL, gdbm_seq_seqid.dptr, EVENT_UNSTORABLE);
          if(gVerbose > 2)
          {
             for(offset=0; offset<maxoffset; offset++)
             {
-               strncpy(sFragment, data+offset, fragSize);
-               sFragment[fragSize-1] = '\0';
-               CREATEDATUM(gdbm_frag_key, sFragment);
+               if(!MakeFragment(data+offset, fragSize-1, sFragment, 
+                                &gdbm_frag_key))
+                  continue;
                gdbm_seq_seqdata = gdbm_fetch(gDBF_fragdata,
                                              gdbm_frag_key);
                fprintf(stderr,"      Hit with: %s\n",
@@ -782,16 +1461,13 @@ store %s (length=%d)\n", gdbm_seq_seqid.dptr, strlen(data));
          if((parent = ThisSequenceRedundant(data, fragSize, 
                                             gdbm_seq_seqid))!=NULL)
          {
-            if(gVerbose)
-            {
-               fprintf(stderr, "INFO: %s superceeds %s\n",
-                       parent, gdbm_seq_seqid.dptr);
-            }
+            Supersede(parent, gdbm_seq_seqid.dptr, EVENT_NO_FRAGMENT);
          }
          else
          {
             fprintf(stderr,"W003: Can't find unique fragment. \
 Unable to store %s (length=%d)\n", gdbm_seq_seqid.dptr, strlen(data));
+            Supersede(NULL, gdbm_seq_seqid.dptr, EVENT_UNSTORABLE);
          }
       }
       
@@ -805,7 +1481,9 @@ char *ThisSequenceRedundant(char *data, int fragSize,
                             datum gdbm_seq_seqid)
 {
    static char *sFragment=NULL,
-               sID[MAX_KEY_LEN];
+               *sID=NULL;
+   static int  sFragSize=0;
+   static SEQBUFF sSeq = {NULL, 0, 0, 0};
    int         maxoffset,
                offset,
                seqnum;
@@ -815,18 +1493,22 @@ char *ThisSequenceRedundant(char *data, int fragSize,
    char        *frag_sequence;
 
 
-   if(sFragment==NULL)
+   if(fragSize > sFragSize)
    {
-      /* Allocate memory for fragment storage                           */
-      if((sFragment = (char *)malloc((fragSize+1) * sizeof(char)))==NULL)
+      /* Allocate memory for fragment storage (grown if a library 
+         context uses a bigger fragment size)
+      */
+      if((sFragment = (char *)realloc(sFragment, 
+                                      (fragSize+1) * sizeof(char)))==NULL)
       {
          fprintf(stderr,"E003: No memory for fragment storage\n");
          exit(1);
       }
+      sFragSize = fragSize;
    }
    
    /* Find max possible offset for a fragment                           */
-   maxoffset = strlen(data) - fragSize;
+   maxoffset = NFragments(strlen(data), fragSize);
    
    /* We know all fragments are already in the fragment hash. Try each
       in turn to see whether the corresponding stored protein is a
@@ -834,42 +1516,41 @@ char *ThisSequenceRedundant(char *data, int fragSize,
    */
    for(offset=0; offset<maxoffset; offset++)
    {
-      strncpy(sFragment, data+offset, fragSize);
-      sFragment[fragSize-1] = '\0';
-
-      if(strchr(sFragment,'X'))
+      if(!MakeFragment(data+offset, fragSize-1, sFragment, 
+                       &gdbm_frag_key) ||
+         (!gDNA && strchr(sFragment,'X')))
       {
          continue;
       }
-   
-      CREATEDATUM(gdbm_frag_key, sFragment);
 
       /* Fetch the identifier for this fragment                         */
+      METRIC(hashProbes);
       gdbm_stored_key = gdbm_fetch(gDBF_fragdata, gdbm_frag_key);
       /* Fetch the sequence pointer for this identifier                 */
-      gdbm_stored_seq = gdbm_fetch(gDBF_seqdata_temp, gdbm_stored_key);
-      if(gdbm_stored_seq.dptr == NULL)
-      {
-         gdbm_stored_seq = gdbm_fetch(gDBF_seqdata, gdbm_stored_key);
-      }
+      gdbm_stored_seq = gdbm_fetch(gDBF_seqdata, gdbm_stored_key);
       if(gdbm_stored_seq.dptr == NULL)
       {
+         if(gdbm_stored_key.dptr != NULL)
+            free(gdbm_stored_key.dptr);
          return(NULL);
       }
 
       /* Now fetch the complete sequence for this fragment              */
-      if((frag_sequence = GetSequence(gdbm_stored_seq, FALSE))!=NULL)
+      METRIC(candidateFetches);
+      frag_sequence = FetchSequence(gdbm_stored_seq, FALSE, &sSeq);
+      free(gdbm_stored_seq.dptr);
+      if(frag_sequence != NULL)
       {
          if((seqnum = CompareSequences(data, gdbm_seq_seqid.dptr, 
                                        frag_sequence, 
                                        gdbm_stored_key.dptr)))
          {
-            strcpy(sID, gdbm_stored_key.dptr);
-            free(gdbm_stored_key.dptr);
-            free(frag_sequence);
+            /* Keep the ID we return until the next call                */
+            if(sID != NULL)
+               free(sID);
+            sID = gdbm_stored_key.dptr;
             return(sID);
          }
-         free(frag_sequence);
       }
       free(gdbm_stored_key.dptr);
    }
@@ -878,33 +1559,182 @@ char *ThisSequenceRedundant(char *data, int fragSize,
 }
 
 
+/************************************************************************/
+/*>void StoreSequenceSeeds(char *data, int fragSize, datum gdbm_seq_seqid)
+   -----------------------------------------------------------------------
+   Input:     char        *data            A sequence to store
+              int         fragSize         Size of fragment
+              datum       gdbm_seq_seqid   GDBM datum of sequence ID
+
+   Mismatch mode version of StoreSequenceFragment(). Splits the sequence
+   into gMismatches+1 equal segments and stores the fragment at the 
+   start of each as a seed. The seeds need not be unique: each entry in
+   the fragment hash is a list of the IDs and offsets of the sequences
+   which contain that seed. The seeds are also stored against the 
+   sequence ID in the fragment table so they can be removed again by
+   DropSequence().
+
+   If the sequence is too short for gMismatches+1 seeds, then as many
+   as will fit are stored.
+
+   When serving, a seed is stored every fragSize-1 residues, so that
+   any query of at least 2*(fragSize-1)-1 residues lying within the
+   sequence contains one of them.
+
+   19.10.26 Original
+   19.10.26 Seeds for serving
+   19.10.26 Notes the seeds of sequences checked again in an update
+*/
+void StoreSequenceSeeds(char *data, int fragSize, datum gdbm_seq_seqid)
+{
+   int   seedLen = fragSize - 1,
+         length,
+         nSeeds,
+         segLen,
+         i;
+   char  *seeds;
+   datum gdbm_seeds;
+
+   length = strlen(data);
+   if((seedLen < 1) || (length < seedLen))
+      return;
+
+   nSeeds = (gServeFile ? (length / seedLen) : (gMismatches + 1));
+   if(nSeeds > length / seedLen)
+      nSeeds = length / seedLen;
+   segLen = (gServeFile ? seedLen : (length / nSeeds));
+
+   /* The seeds are stored in the fragment table as a list of 
+      '\0'-terminated strings
+   */
+   if((seeds = (char *)malloc(nSeeds * (seedLen+1) * sizeof(char)))==NULL)
+   {
+      fprintf(stderr,"E003: No memory for fragment storage\n");
+      exit(1);
+   }
+
+   for(i=0; i<nSeeds; i++)
+   {
+      strncpy(seeds + i*(seedLen+1), data + i*segLen, seedLen);
+      seeds[i*(seedLen+1) + seedLen] = '\0';
+      AddToSeedList(seeds + i*(seedLen+1), gdbm_seq_seqid.dptr, 
+                    i*segLen);
+      if(gUpdatePass == UPDATE_RECHECK)
+         AddRecheckAnchor(KmerHash(seeds + i*(seedLen+1), seedLen));
+   }
+
+   gdbm_seeds.dptr  = seeds;
+   gdbm_seeds.dsize = nSeeds * (seedLen+1);
+   gdbm_store(gDBF_fragtable, gdbm_seq_seqid, gdbm_seeds, GDBM_REPLACE);
+   free(seeds);
+}
+
+
+/************************************************************************/
+/*>void AddToSeedList(char *seed, char *seqid, int offset)
+   -------------------------------------------------------
+   Input:     char   *seed      Seed fragment
+              char   *seqid     Sequence ID
+              int    offset     Offset of the seed in the sequence
+
+   Adds a sequence to the list stored against a seed in the fragment
+   hash. The list is a set of '\0'-terminated strings giving the ID 
+   and the offset of each sequence.
+
+   19.10.26 Original
+*/
+void AddToSeedList(char *seed, char *seqid, int offset)
+{
+   datum gdbm_frag_key,
+         gdbm_list;
+   char  offsetString[16],
+         *list;
+   int   idLen,
+         offLen,
+         oldSize = 0;
+
+   sprintf(offsetString, "%d", offset);
+   idLen  = strlen(seqid) + 1;
+   offLen = strlen(offsetString) + 1;
+
+   CREATEDATUM(gdbm_frag_key, seed);
+   METRIC(hashProbes);
+   gdbm_list = gdbm_fetch(gDBF_fragdata, gdbm_frag_key);
+   if(gdbm_list.dptr != NULL)
+      oldSize = gdbm_list.dsize;
+
+   if((list = (char *)malloc((oldSize+idLen+offLen) * sizeof(char)))
+      ==NULL)
+   {
+      fprintf(stderr,"E003: No memory for fragment storage\n");
+      exit(1);
+   }
+   if(oldSize)
+   {
+      memcpy(list, gdbm_list.dptr, oldSize);
+      free(gdbm_list.dptr);
+   }
+   memcpy(list+oldSize, seqid, idLen);
+   memcpy(list+oldSize+idLen, offsetString, offLen);
+
+   gdbm_list.dptr  = list;
+   gdbm_list.dsize = oldSize + idLen + offLen;
+   gdbm_store(gDBF_fragdata, gdbm_frag_key, gdbm_list, GDBM_REPLACE);
+   free(list);
+}
+
+
 /************************************************************************/
 /* We can't actually delete the seqid->sequence references here since
    that would disrupt the loop through the sequences. Instead we remove
-   them from the fragment hashes and simply mark this sequence ID as
-   having been deleted
+   them from the fragment hashes and simply mark this sequence's index
+   as deleted in the tombstone bitset.
 
-   PurgeDeletedSequences() then does the actual work of deleting the
-   entries in the seqid->sequence hash.
+   PurgeDeletedSequences() removes the entries later.
+
+   19.10.26 Sets a tombstone bit rather than storing in the deleted hash
 */
 
 void DropSequence(char *seqid)
 {
    datum  gdbm_seq_key,
           gdbm_fragment,
-          gdbm_deleted;
+          gdbm_seq_data;
+   long   index;
 
-   /* Delete this sequence from the seqid->sequence hashes              */
+   METRIC(dropped);
+   
+   /* Mark the index of the sequence's entry as deleted                */
    CREATEDATUM(gdbm_seq_key, seqid);
-   CREATEDATUM(gdbm_deleted, "1");
-   gdbm_store(gDBF_deleted, gdbm_seq_key, gdbm_deleted, GDBM_INSERT);
+   if((gdbm_seq_data = gdbm_fetch(gDBF_seqdata, gdbm_seq_key)).dptr 
+      != NULL)
+   {
+      index = SequenceIndex(gdbm_seq_data);
+      if(SetTombstone(index))
+      {
+         if(index >= gFirstNew)
+            gNTempSeqs--;
+         else
+            gNSeqs--;
+         gNDead++;
+      }
+      free(gdbm_seq_data.dptr);
+   }
    
    /* Find the associated fragment and delete that                      */
-   gdbm_fragment = gdbm_fetch(gDBF_fragtable, gdbm_seq_key);
-   gdbm_delete(gDBF_fragdata, gdbm_fragment);
-   if(gdbm_fragment.dptr != NULL)
+   if(gMismatches)
+   {
+      DropSequenceSeeds(gdbm_seq_key);
+   }
+   else
    {
-      free(gdbm_fragment.dptr);
+      gdbm_fragment = gdbm_fetch(gDBF_fragtable, gdbm_seq_key);
+      if(gdbm_fragment.dptr != NULL)
+      {
+         if(!gdbm_delete(gDBF_fragdata, gdbm_fragment))
+            BloomDeleted();
+         free(gdbm_fragment.dptr);
+      }
    }
 
    gdbm_delete(gDBF_fragtable, gdbm_seq_key);
@@ -912,21 +1742,133 @@ void DropSequence(char *seqid)
 
 
 /************************************************************************/
+/*>void DropSequenceSeeds(datum gdbm_seq_key)
+   ------------------------------------------
+   Input:     datum  gdbm_seq_key   Sequence ID
+
+   Mismatch mode. Removes this sequence from the list stored against 
+   each of its seeds in the fragment hash, deleting any list which is
+   left empty.
+
+   19.10.26 Original
+*/
+void DropSequenceSeeds(datum gdbm_seq_key)
+{
+   datum gdbm_seeds,
+         gdbm_frag_key,
+         gdbm_list;
+   char  *seed,
+         *in,
+         *out,
+         *next;
+   int   len;
+
+   gdbm_seeds = gdbm_fetch(gDBF_fragtable, gdbm_seq_key);
+   if(gdbm_seeds.dptr == NULL)
+      return;
+
+   for(seed=gdbm_seeds.dptr; 
+       seed < gdbm_seeds.dptr + gdbm_seeds.dsize;
+       seed += strlen(seed)+1)
+   {
+      CREATEDATUM(gdbm_frag_key, seed);
+      METRIC(hashProbes);
+      gdbm_list = gdbm_fetch(gDBF_fragdata, gdbm_frag_key);
+      if(gdbm_list.dptr == NULL)
+         continue;
+
+      /* Copy down the ID/offset pairs which aren't for this sequence   */
+      in = out = gdbm_list.dptr;
+      while(in < gdbm_list.dptr + gdbm_list.dsize)
+      {
+         next = in + strlen(in) + 1;
+         next += strlen(next) + 1;
+         if(strcmp(in, gdbm_seq_key.dptr))
+         {
+            len = next - in;
+            memmove(out, in, len);
+            out += len;
+         }
+         in = next;
+      }
+
+      if(out == gdbm_list.dptr)
+      {
+         gdbm_delete(gDBF_fragdata, gdbm_frag_key);
+      }
+      else
+      {
+         gdbm_list.dsize = out - gdbm_list.dptr;
+         gdbm_store(gDBF_fragdata, gdbm_frag_key, gdbm_list, 
+                    GDBM_REPLACE);
+      }
+      free(gdbm_list.dptr);
+   }
+   
+   free(gdbm_seeds.dptr);
+}
+
+
+/************************************************************************/
+/*>BOOL PurgeDeletedSequences(void)
+   --------------------------------
+   Returns:   BOOL      Success?
+
+   Removes the deleted entries from the sequence hash, but only once 
+   they make up more than 1/PURGE_FRACTION of it. Until then they
+   are skipped by everything reading the hash. The keys are collected
+   first since the hash can't be changed while we loop through it.
+
+   15.06.00 Original   By: ACRM
+   19.10.26 Compacts the hash lazily using the tombstone bitset
+*/
 BOOL PurgeDeletedSequences(void)
 {
-   datum     gdbm_seq_seqid;
+   datum     key,
+             next,
+             content;
+   char      **dead;
+   long      nDead = 0,
+             i;
+   BOOL      isDead;
 
-   /* Loop through the keys of the deleted sequence hash                */
-   gdbm_seq_seqid = gdbm_firstkey(gDBF_deleted);
-   while(gdbm_seq_seqid.dptr)
+   if((gNDead == 0) || 
+      (gNDead * PURGE_FRACTION <= gNSeqs + gNTempSeqs + gNDead))
+      return(TRUE);
+
+   if(gVerbose > 1)
+   {
+      fprintf(stderr,"TRACE: Purging %ld deleted sequences...\n", gNDead);
+   }
+
+   if((dead = (char **)malloc(gNDead * sizeof(char *)))==NULL)
+      return(TRUE);
+
+   for(key=gdbm_firstkey(gDBF_seqdata); key.dptr!=NULL; key=next)
    {
-      gdbm_delete(gDBF_seqdata, gdbm_seq_seqid);
-      gdbm_delete(gDBF_seqdata_temp, gdbm_seq_seqid);
+      content = gdbm_fetch(gDBF_seqdata, key);
+      isDead  = ((content.dptr != NULL) && 
+                 IsTombstone(SequenceIndex(content)) && 
+                 (nDead < gNDead));
+      if(content.dptr != NULL)
+         free(content.dptr);
+
+      next = gdbm_nextkey(gDBF_seqdata, key);
+      if(isDead)
+         dead[nDead++] = key.dptr;
+      else
+         free(key.dptr);
+   }
 
-      gdbm_seq_seqid=gdbm_nextkey(gDBF_deleted,gdbm_seq_seqid);
+   for(i=0; i<nDead; i++)
+   {
+      CREATEDATUM(key, dead[i]);
+      if(!gdbm_delete(gDBF_seqdata, key))
+         gNDead--;
+      free(dead[i]);
    }
+   free(dead);
 
-   CLEARHASH(gDBF_deleted, DEFAULT_DELETEDHASH);
    return(TRUE);
 }
 
@@ -946,14 +1888,24 @@ BOOL PurgeDeletedSequences(void)
    loadOnly specified, then this file is already redundant: just load it
    for other files to be processed against.
 
+   If the file is - (or NULL), standard input is read as a stream. Each
+   record is kept in the store as it is read so that it can be fetched
+   again without seeking in the input. The records are then referred to
+   by the pseudo-filename STREAM_NAME.
+
    15.06.00 Original   By: ACRM
+   19.10.26 Added stdin
 */
 BOOL NonRedundantise(char *file, BOOL loadOnly, int fragSize, 
                      int rejectSize)
 {
-   FILE *in = NULL;
-   BOOL retval=TRUE;
+   SEQFILE *in = NULL;
+   BOOL    retval=TRUE;
+   char    spillFile[MAXBUFF+40];
 
+   if((file != NULL) && !strcmp(file, "-"))
+      file = NULL;
+   
    if(gVerbose > 1)
    {
       fprintf(stderr,"\n\nTRACE: NON-REDUNDANTISING %s\n\n", 
@@ -963,7 +1915,8 @@ BOOL NonRedundantise(char *file, BOOL loadOnly, int fragSize,
    /* Open the file                                                     */
    if(file)
    {
-      if((in=fopen(file, "r"))==NULL)
+      MetricsNewFile(file);
+      if((in=OpenSeqFile(file))==NULL)
       {
          fprintf(stderr,"E004: Can't read %s\n", file);
          return(FALSE);
@@ -971,11 +1924,18 @@ BOOL NonRedundantise(char *file, BOOL loadOnly, int fragSize,
    }
    else
    {
-      return(FALSE);
+      file = STREAM_NAME;
+      MetricsNewFile(file);
+      TempName(spillFile, DEFAULT_STDINFILE);
+      if((in=OpenSeqStream(stdin, spillFile))==NULL)
+      {
+         fprintf(stderr,"E004: Can't read standard input\n");
+         return(FALSE);
+      }
    }
 
    /* Read in the sequence data into a GDBM hash                        */
-   if(ReadSequences(in, file, rejectSize))
+   if(ReadSequences(in, file, rejectSize, fragSize))
    {
       if(HashSequences(fragSize,loadOnly))
       {
@@ -984,7 +1944,7 @@ BOOL NonRedundantise(char *file, BOOL loadOnly, int fragSize,
             DropRedundancies(fragSize);
          }
 
-         if(!MergeSequenceHashes(DEFAULT_SEQHASH,DEFAULT_TEMPSEQHASH))
+         if(!MergeSequenceHashes())
          {
             retval = FALSE;
          }
@@ -1001,7 +1961,7 @@ BOOL NonRedundantise(char *file, BOOL loadOnly, int fragSize,
       retval = FALSE;
    }
    
-   fclose(in);
+   CloseSeqFile(in);
    return(retval);
 }
 
@@ -1021,50 +1981,71 @@ BOOL NonRedundantise(char *file, BOOL loadOnly, int fragSize,
    redundancy and marking for deletion
 
    15.06.00 Original   By: ACRM
+   19.10.26 Records metrics
+   19.10.26 Calls doDropMismatchRedundancy() in mismatch mode
+   19.10.26 Loops through the key file
+   19.10.26 Reuses one sequence buffer
+   19.10.26 Checks duplicates of sequences from earlier files
 */
 BOOL DropRedundancies(int fragSize)
 {
+   static SEQBUFF sSeq = {NULL, 0, 0, 0};
    datum     gdbm_seq_seqid,
              gdbm_seq_seqdata,
-             gdbm_deleted;
-   char      *data;
+             gdbm_copy;
+   char      *data,
+             *key,
+             *copy;
+   BOOL      retval,
+             first = TRUE;
    
    
    if(gVerbose > 1)
    {
       fprintf(stderr,"TRACE: Dropping Redundancies...\n");
    }
+   MetricsStartStage(STAGE_DROP);
+   SetProgressTotals(gNTempSeqs + gNTempDups, 0L);
    
-   /* Loop through the keys of the temporary sequence hash              */
-   gdbm_seq_seqid = gdbm_firstkey(gDBF_seqdata_temp);
-   while(gdbm_seq_seqid.dptr)
+   /* Loop through the sequences read from this file                    */
+   while((key = NextKey(first, &copy)) != NULL)
    {
-      gdbm_deleted = gdbm_fetch(gDBF_deleted, gdbm_seq_seqid);
-      if(gdbm_deleted.dptr == NULL)
+      first = FALSE;
+      METRIC(seqsIn);
+      PROGRESS();
+      CREATEDATUM(gdbm_seq_seqid, key);
+      gdbm_seq_seqdata = gdbm_fetch(gDBF_seqdata, gdbm_seq_seqid);
+      if(gdbm_seq_seqdata.dptr != NULL)
       {
-         /* This sequence hasn't already been marked as deleted         */
-         gdbm_seq_seqdata = gdbm_fetch(gDBF_seqdata_temp, gdbm_seq_seqid);
-         
-         if((data = GetSequence(gdbm_seq_seqdata, FALSE))!=NULL)
+         /* A duplicate is checked using its own sequence               */
+         gdbm_copy = gdbm_seq_seqdata;
+         if(copy != NULL)
          {
-            doDropRedundancy(gdbm_seq_seqid.dptr, data, fragSize);
-            free(data);
+            CREATEDATUM(gdbm_copy, copy);
          }
-         
-         if(gdbm_seq_seqdata.dptr)
+
+         /* Skip it if it has already been marked as deleted            */
+         if(!IsTombstone(SequenceIndex(gdbm_seq_seqdata)) &&
+            ((data = FetchSequence(gdbm_copy, FALSE, &sSeq))!=NULL))
          {
-            free(gdbm_seq_seqdata.dptr);
+            if(gMismatches)
+            {
+               doDropMismatchRedundancy(gdbm_seq_seqid.dptr, data,
+                                        fragSize);
+            }
+            else
+            {
+               doDropRedundancy(gdbm_seq_seqid.dptr, data, fragSize);
+            }
          }
+         
+         free(gdbm_seq_seqdata.dptr);
       }
-      else
-      {
-         free(gdbm_deleted.dptr);
-      }
-
-      gdbm_seq_seqid=gdbm_nextkey(gDBF_seqdata_temp,gdbm_seq_seqid);
    }
 
-   return(PurgeDeletedSequences());
+   retval = PurgeDeletedSequences();
+   MetricsEndStage();
+   return(retval);
 }
 
 
@@ -1078,274 +2059,937 @@ BOOL DropRedundancies(int fragSize)
    Does the actual checking of a sequence against the fragment hash and
    looking for redundancy then marking a redundant sequence for deletion
 
+   Unless -w 0 was given, only the fragments which are minimizers or
+   might be extra anchors are looked up. Every sequence contained in
+   this one is anchored at one of these (see minimizer.c). Fragments
+   which the Bloom filter says are not stored are not looked up.
+
+   The fragments are taken PROBE_BATCH at a time. All their hashes are
+   found and their blocks of the Bloom filter prefetched before any is
+   tested, since with a filter much bigger than the cache each test is
+   otherwise a cache miss which can't start until the last has ended.
+
+   While the standing representatives are probed in an update, the 
+   extra anchor set holds the anchors of the sequences being checked
+   again and only the fragments in it are looked up.
+
    15.06.00 Original   By: ACRM
+   19.10.26 Only looks up minimizers and extra anchors
+   19.10.26 Checks the Bloom filter first
+   19.10.26 Fragments made by MakeFragment()
+   19.10.26 Fragment buffer grows to the fragment size in use
+   19.10.26 Frees the hash entries when the sequence is dropped
+   19.10.26 Fragments are hashed and their Bloom filter blocks
+            prefetched in batches
+   19.10.26 Reuses one buffer for the stored sequences
+   19.10.26 Looks up just the rechecked anchors when probing the
+            representatives in an update
 */
 void doDropRedundancy(char *seqid, char *sequence, int fragSize)
 {
-   static char *sFragment=NULL;
-   int         maxoffset,
-               offset,
-               fragnum;
-   datum       gdbm_frag_seqid,
-               gdbm_frag_key,
-               gdbm_seq_data;
-   char        *stored_data;
+   static char   *sFragment=NULL;
+   static int    sFragSize=0;
+   static SEQBUFF sStored = {NULL, 0, 0, 0};
+   int           maxoffset,
+                 offset,
+                 fragnum,
+                 start,
+                 probe,
+                 nProbes,
+                 probeOffset[PROBE_BATCH];
+   datum         gdbm_frag_seqid,
+                 gdbm_frag_key,
+                 gdbm_seq_data;
+   char          *stored_data,
+                 *isMin  = NULL;
+   unsigned long *hashes = NULL,
+                 probeHash[PROBE_BATCH];
+   BOOL          dropped = FALSE;
    
 
-   if(sFragment==NULL)
+   if(fragSize > sFragSize)
    {
-      /* Allocate memory for fragment storage                           */
-      if((sFragment = (char *)malloc((fragSize+1) * sizeof(char)))==NULL)
+      /* Allocate memory for fragment storage (grown if a library 
+         context uses a bigger fragment size)
+      */
+      if((sFragment = (char *)realloc(sFragment, 
+                                      (fragSize+1) * sizeof(char)))==NULL)
       {
          fprintf(stderr,"E003: No memory for fragment storage\n");
          exit(1);
       }
+      sFragSize = fragSize;
    }
    
    /* Find max possible offset for a fragment                           */
-   maxoffset = strlen(sequence) - fragSize;
+   maxoffset = NFragments(strlen(sequence), fragSize);
 
-   for(offset=0; offset<maxoffset; offset++)
+   if(gWindow && 
+      (FindMinimizers(sequence, maxoffset, fragSize-1, gWindow, 
+                      FragmentHash, &hashes, &isMin) < 0))
    {
-      strncpy(sFragment, sequence+offset, fragSize);
-      sFragment[fragSize-1] = '\0';
+      fprintf(stderr,"E003: No memory for minimizers\n");
+      exit(1);
+   }
 
-      /* Try to fetch a sequence ID for this fragment                   */
-      CREATEDATUM(gdbm_frag_key,sFragment);
-      gdbm_frag_seqid = gdbm_fetch(gDBF_fragdata, gdbm_frag_key);
-      
-      /* If we found one                                                */
-      if(gdbm_frag_seqid.dptr)
+   for(start=0; (start<maxoffset) && !dropped; start+=PROBE_BATCH)
+   {
+      /* Hash the fragments in this batch which might be anchors and
+         prefetch their Bloom filter blocks, so that the cache misses
+         overlap instead of each test waiting for its own
+      */
+      nProbes = 0;
+      for(offset=start; 
+          (offset<maxoffset) && (offset<start+PROBE_BATCH); 
+          offset++)
       {
-         /* If it isn't the self match                                  */
-         if(strcmp(seqid, gdbm_frag_seqid.dptr))
+         probeHash[nProbes] = (gWindow ? hashes[offset] : 
+                               FragmentHash(sequence+offset, 
+                                            fragSize-1));
+
+         /* Skip fragments which can't be anchors                       */
+         if(gUpdatePass == UPDATE_PROBE)
          {
-            /* Grab the found sequence
-               First try the main sequence hash and then the temp hash
-            */
-            gdbm_seq_data = gdbm_fetch(gDBF_seqdata, gdbm_frag_seqid);
-            if(gdbm_seq_data.dptr == NULL)
-            {
-               gdbm_seq_data = gdbm_fetch(gDBF_seqdata_temp, 
-                                          gdbm_frag_seqid);
-            }
+            if(!IsExtraAnchor(probeHash[nProbes]))
+               continue;
+         }
+         else if(gWindow && !isMin[offset] && 
+                 !IsExtraAnchor(probeHash[nProbes]))
+         {
+            continue;
+         }
+
+         probeOffset[nProbes] = offset;
+         BloomPrefetch(probeHash[nProbes]);
+         nProbes++;
+      }
+
+      for(probe=0; probe<nProbes; probe++)
+      {
+         offset = probeOffset[probe];
 
-            /* If we found it OK                                        */
-            if(gdbm_seq_data.dptr)
+         /* Skip fragments which certainly aren't stored                */
+         if(!BloomTest(probeHash[probe]))
+         {
+            METRIC(bloomRejects);
+            continue;
+         }
+      
+         if(!MakeFragment(sequence+offset, fragSize-1, sFragment, 
+                          &gdbm_frag_key))
+            continue;
+
+         /* Try to fetch a sequence ID for this fragment                */
+         METRIC(hashProbes);
+         gdbm_frag_seqid = gdbm_fetch(gDBF_fragdata, gdbm_frag_key);
+         if(gdbm_frag_seqid.dptr == NULL)
+         {
+            METRIC(bloomFalsePositives);
+         }
+      
+         /* If we found one                                             */
+         if(gdbm_frag_seqid.dptr)
+         {
+            /* If it isn't the self match                               */
+            if(strcmp(seqid, gdbm_frag_seqid.dptr))
             {
-               /* Compare the sequences                                 */
-               if((stored_data = GetSequence(gdbm_seq_data, FALSE))!=NULL)
+               /* Grab the found sequence                               */
+               gdbm_seq_data = gdbm_fetch(gDBF_seqdata, gdbm_frag_seqid);
+
+               /* If we found it OK                                     */
+               if(gdbm_seq_data.dptr)
                {
-                  if((fragnum=CompareSequences(sequence, 
-                                               seqid,
-                                               stored_data,
-                                               gdbm_frag_seqid.dptr)))
+                  /* Compare the sequences                              */
+                  METRIC(candidateFetches);
+                  if((stored_data = FetchSequence(gdbm_seq_data, FALSE,
+                                                  &sStored))!=NULL)
                   {
-                     /* Sequences are the same, if the first one is 
-                        longer then replace it in the fragment hash
-                     */
-                     if(gVerbose)
+                     if((fragnum=CompareSequences(sequence, 
+                                                  seqid,
+                                                  stored_data,
+                                                  gdbm_frag_seqid.dptr)))
                      {
+                        /* Sequences are the same, if the first one is 
+                           longer then replace it in the fragment hash
+                        */
                         if(fragnum==1)
                         {
-                           fprintf(stderr,"INFO: %s superceeds %s\n",
-                                   seqid, 
-                                   gdbm_frag_seqid.dptr);
+                           Supersede(seqid, gdbm_frag_seqid.dptr,
+                                     EVENT_CONTAINED);
+                           DropSequence(gdbm_frag_seqid.dptr);
                         }
                         else
                         {
-                           fprintf(stderr,"INFO: %s superceeds %s\n",
-                                   gdbm_frag_seqid.dptr,
-                                   seqid);
+                           Supersede(gdbm_frag_seqid.dptr, seqid,
+                                     EVENT_CONTAINED);
+                           DropSequence(seqid);
                         }
-                     }
-                  
-                     if(fragnum==1)
-                     {
-                        DropSequence(gdbm_frag_seqid.dptr);
-                     }
-                     else
-                     {
-                        DropSequence(seqid);
-                     }
 
-                     /* If our probe sequence is declared redundant, then
-                        we have finished
-                     */
-                     if(fragnum == 2)
-                     {
-                        free(stored_data);
-                        break;  /* Out of for(offset...)                */
-                     }
-                  }  /* if(sequences match)                             */
-                  free(stored_data);
-               }  /* if(extracted the actual sequence)                  */
-               free(gdbm_seq_data.dptr);
-            }  /* if(found seq data for this id in the hashes)          */
-         }  /* if(not self-match)                                       */
-         free(gdbm_frag_seqid.dptr);
-      }  /* if(fragment found)                                          */
-   }  /* for(offset...)                                                 */
+                        /* If our probe sequence is declared redundant, then
+                           we have finished
+                        */
+                        if(fragnum == 2)
+                        {
+                           free(gdbm_seq_data.dptr);
+                           free(gdbm_frag_seqid.dptr);
+                           dropped = TRUE;
+                           break;  /* Out of for(probe...)              */
+                        }
+                     }  /* if(sequences match)                          */
+                  }  /* if(extracted the actual sequence)               */
+                  free(gdbm_seq_data.dptr);
+               }  /* if(found seq data for this id in the hashes)       */
+            }  /* if(not self-match)                                    */
+            free(gdbm_frag_seqid.dptr);
+         }  /* if(fragment found)                                       */
+      }  /* for(probe...)                                               */
+   }  /* for(start...)                                                  */
 }
 
 
 /************************************************************************/
-/*>BOOL MergeSequenceHashes(char *mainhash, char *temphash)
-   --------------------------------------------------------
-   Input:     char     *mainhash   Main sequence hash
-              char     *temphash   Temporary sequence hash
-   Returns:   BOOL                 Success?
-
-   Merge the data from the temporary sequence has (temphash) into the
-   main sequence hash (mainhash) and then delete temphash
-
-   15.06.00 Original   By: ACRM
+/*>void doDropMismatchRedundancy(char *seqid, char *sequence, 
+                                 int fragSize)
+   -----------------------------------------------------------
+   Input:     char       *seqid        Sequence identifier to test
+              char       *sequence     Sequence to test
+              int        fragSize      Fragment size
+              
+   Mismatch mode version of doDropRedundancy(). Slides a window along
+   the sequence looking up each fragment in the fragment hash. Each hit
+   gives a stored sequence and, from the offset of the seed, the 
+   diagonal on which the two sequences would align. The two are then
+   compared along that diagonal with CompareSequencesAt(). A pair may 
+   hit on up to gMismatches+1 seeds, so each sequence/diagonal pair is
+   only compared once.
+
+   While the standing representatives are probed in an update, only 
+   the seeds of the sequences being checked again are looked up and 
+   only those sequences are compared.
+
+   19.10.26 Original
+   19.10.26 Fragment buffer grows to the fragment size in use
+   19.10.26 Reuses one buffer for the stored sequences
+   19.10.26 Looks up just the rechecked seeds when probing the
+            representatives in an update
 */
-BOOL MergeSequenceHashes(char *mainhash, char *temphash)
+void doDropMismatchRedundancy(char *seqid, char *sequence, int fragSize)
 {
-   datum     key,
-             content;
-
+   static char *sFragment=NULL;
+   static int  sFragSize=0;
+   static SEQBUFF sStored = {NULL, 0, 0, 0};
+   int         maxoffset,
+               offset,
+               diag,
+               fragnum = 0;
+   datum       gdbm_frag_key,
+               gdbm_list,
+               gdbm_id,
+               gdbm_seq_data;
+   char        *entry,
+               *stored_id,
+               *stored_data;
    
-   if(gVerbose > 1)
+
+   if(fragSize > sFragSize)
    {
-      fprintf(stderr,"TRACE: Merging Sequence Hashes...\n");
+      /* Allocate memory for fragment storage (grown if a library 
+         context uses a bigger fragment size)
+      */
+      if((sFragment = (char *)realloc(sFragment, 
+                                      (fragSize+1) * sizeof(char)))==NULL)
+      {
+         fprintf(stderr,"E003: No memory for fragment storage\n");
+         exit(1);
+      }
+      sFragSize = fragSize;
    }
    
-   /* Copy everything across from the temp seq hash to the main one     */
-   key = gdbm_firstkey(gDBF_seqdata_temp);
-   while(key.dptr)
+   /* Clear the list of sequences we have compared against              */
+   AlreadyChecked(NULL, 0, FALSE);
+
+   /* Find max possible offset for a fragment                           */
+   maxoffset = strlen(sequence) - (fragSize-1);
+
+   for(offset=0; (offset<=maxoffset) && (fragnum!=2); offset++)
    {
-      content = gdbm_fetch(gDBF_seqdata_temp, key);
-      
-      if(gdbm_store(gDBF_seqdata, key, content, GDBM_INSERT))
-      {
-         fprintf(stderr,"Warning (W001): Duplicate ID: %s\n", key.dptr);
-      }
-      if(content.dptr)
+      strncpy(sFragment, sequence+offset, fragSize);
+      sFragment[fragSize-1] = '\0';
+      if((gUpdatePass == UPDATE_PROBE) && 
+         !IsExtraAnchor(KmerHash(sFragment, fragSize-1)))
+         continue;
+
+      /* Try to fetch the list of sequences with this seed              */
+      CREATEDATUM(gdbm_frag_key,sFragment);
+      METRIC(hashProbes);
+      gdbm_list = gdbm_fetch(gDBF_fragdata, gdbm_frag_key);
+      if(gdbm_list.dptr == NULL)
+         continue;
+
+      for(entry=gdbm_list.dptr; 
+          entry < gdbm_list.dptr + gdbm_list.dsize;
+          entry += strlen(entry)+1)
       {
-         free(content.dptr);
+         stored_id = entry;
+         entry    += strlen(entry)+1;
+         diag      = offset - atoi(entry);
+
+         /* Skip the self match and any pair we have already seen (and
+            when probing the representatives, any other representative)
+         */
+         if(!strcmp(seqid, stored_id) || 
+            ((gUpdatePass == UPDATE_PROBE) && !IsRechecked(stored_id)) ||
+            AlreadyChecked(stored_id, diag, TRUE))
+            continue;
+
+         /* Grab the found sequence                                     */
+         CREATEDATUM(gdbm_id, stored_id);
+         gdbm_seq_data = gdbm_fetch(gDBF_seqdata, gdbm_id);
+         if(gdbm_seq_data.dptr == NULL)
+            continue;
+         
+         METRIC(candidateFetches);
+         if((stored_data = FetchSequence(gdbm_seq_data, FALSE, 
+                                         &sStored))!=NULL)
+         {
+            if((fragnum=CompareSequencesAt(sequence, seqid, stored_data,
+                                           stored_id, diag)))
+            {
+               if(fragnum==1)
+               {
+                  Supersede(seqid, stored_id, EVENT_MISMATCH);
+                  DropSequence(stored_id);
+                  AlreadyChecked(stored_id, DIAG_DROPPED, TRUE);
+               }
+               else
+               {
+                  Supersede(stored_id, seqid, EVENT_MISMATCH);
+                  DropSequence(seqid);
+               }
+            }
+         }
+         free(gdbm_seq_data.dptr);
+
+         /* If our probe sequence is declared redundant, then we have
+            finished
+         */
+         if(fragnum == 2)
+            break;
       }
-      
-      key=gdbm_nextkey(gDBF_seqdata_temp,key);
+      free(gdbm_list.dptr);
    }
-
-   CLEARHASH(gDBF_seqdata_temp, DEFAULT_TEMPSEQHASH);
-   return(TRUE);
 }
 
 
 /************************************************************************/
-/*>char *GetSequence(datum content, BOOL full)
-   -------------------------------------------
-   Input:     datum   content   GDBM datum structure containing the
-                                filename and fseek() pointer
-              BOOL    full      Get the header as well as the sequence
-   Returns:   char    *         Pointer to sequence data
-
-   The sequence hash contains an fseek() pointer into the sequence data
-   file. This routine reads the actual sequence data into a malloc'd
-   block of memory.
-
-   15.06.00 Original   By: ACRM
-   30.06.00 'content' is now a filename and fseek() pointer into an
-            actual sequence file
-   11.07.00 Fixed memory leak
+/*>BOOL AlreadyChecked(char *seqid, int diag, BOOL add)
+   ----------------------------------------------------
+   Input:     char   *seqid     Sequence ID (NULL to clear the list)
+              int    diag       Diagonal, or DIAG_DROPPED to mark this
+                                sequence as dropped
+              BOOL   add        Add it to the list if not found
+   Returns:   BOOL              Was it already in the list?
+
+   Keeps the list of sequence/diagonal pairs which have been compared
+   against the current probe sequence in doDropMismatchRedundancy().
+   A sequence which has been dropped matches any diagonal.
+
+   19.10.26 Original
+   19.10.26 IDs are kept one after another in a SEQBUFF so they may be
+            any length
 */
-char *GetSequence(datum content, BOOL full)
+BOOL AlreadyChecked(char *seqid, int diag, BOOL add)
 {
-   char   *data = NULL,
-          ptr[HUGEBUFF],
-          filename[MAXBUFF];
-   long   offset;
-   static FILE *fp = NULL;
-   static char lastFilename[MAXBUFF];
-
-   if(content.dptr==NULL)
-      return(NULL);
-
-   if(fp==NULL)
-      lastFilename[0] = '\0';
-
-   sscanf(content.dptr,"%s %ld", filename, &offset);
+   static SEQBUFF sIDs    = {NULL, 0, 0, 0};  /* IDs separated by nulls */
+   static long    *sStart = NULL;             /* ...where each starts   */
+   static int     *sDiags = NULL,
+                  sNItems = 0,
+                  sNAlloc = 0;
+   int            i;
+
+   if(seqid == NULL)
+   {
+      sNItems = 0;
+      sIDs.length = 0;
+      return(FALSE);
+   }
 
-   /* If the filename has changed, open the new file                    */
-   if(strcmp(filename,lastFilename))
+   for(i=0; i<sNItems; i++)
    {
-      if(fp!=NULL)        /* Close the old file                         */
-         fclose(fp);
-      
-      fp=fopen(filename,"r");
-      strcpy(lastFilename, filename);
+      if(((sDiags[i] == diag) || (sDiags[i] == DIAG_DROPPED)) &&
+         !strcmp(sIDs.data + sStart[i], seqid))
+         return(TRUE);
    }
-   
-   if(fp!=NULL)
+
+   if(add)
    {
-      if(fseek(fp, offset, SEEK_SET) == (-1))
-         return(NULL);
-   
-      if(!full)
+      if(sNItems == sNAlloc)
       {
-         /* Throw away the first line                                   */
-         fgets(ptr, HUGEBUFF, fp);
-      }
-      
-      while(fgets(ptr, HUGEBUFF, fp)!=NULL)
-      {
-         if((*ptr == '>') &&        /* Start of new entry. Jump out     */
-            (data != NULL)) 
+         sNAlloc += 64;
+         if(((sStart = (long *)realloc(sStart, sNAlloc * sizeof(long)))
+             ==NULL) ||
+            ((sDiags = (int *)realloc(sDiags, sNAlloc * sizeof(int)))
+             ==NULL))
          {
-            break;
+            fprintf(stderr,"E003: No memory for fragment storage\n");
+            exit(1);
          }
-         else
+      }
+      sStart[sNItems] = sIDs.length;
+      if(!AppendToSeqBuff(&sIDs, seqid, strlen(seqid)+1, FALSE))
+         exit(1);
+      sDiags[sNItems++] = diag;
+   }
+   return(FALSE);
+}
+
+
+/************************************************************************/
+/*>BOOL ClusterResults(REAL identity)
+   ----------------------------------
+   Input:     REAL   identity   Identity threshold (0.0-1.0)
+   Returns:   BOOL              Success?
+
+   Reads the sequences which remain in the main sequence hash into
+   memory, clusters them with ClusterSequences() and drops all but the
+   representative of each cluster.
+
+   The clustering indexes short words over the sequences in memory
+   rather than using the fragment hash since that only holds one 
+   fragment for each sequence.
+
+   19.10.26 Original
+   19.10.26 Skips deleted sequences
+*/
+BOOL ClusterResults(REAL identity)
+{
+   CLUSTERSEQ *seqs  = NULL;
+   int        *repOf = NULL,
+              nSeqs  = 0,
+              nAlloc = 0,
+              i;
+   datum      gdbm_seq_seqid,
+              gdbm_seq_seqdata,
+              gdbm_next;
+   char       *data;
+   BOOL       retval = TRUE;
+
+   if(gVerbose > 1)
+   {
+      fprintf(stderr,"TRACE: Clustering at %.1f%% identity...\n",
+              100.0 * identity);
+   }
+   MetricsNewFile("(cluster)");
+   MetricsStartStage(STAGE_CLUSTER);
+   SetProgressTotals(gNSeqs, 0L);
+
+   gdbm_seq_seqid = gdbm_firstkey(gDBF_seqdata);
+   while(gdbm_seq_seqid.dptr)
+   {
+      gdbm_seq_seqdata = gdbm_fetch(gDBF_seqdata, gdbm_seq_seqid);
+      data = NULL;
+      if((gdbm_seq_seqdata.dptr != NULL) &&
+         !IsTombstone(SequenceIndex(gdbm_seq_seqdata)) &&
+         ((data = GetSequence(gdbm_seq_seqdata, FALSE))!=NULL))
+      {
+         if(nSeqs == nAlloc)
+         {
+            nAlloc += 1024;
+            if((seqs = (CLUSTERSEQ *)realloc(seqs, 
+                                             nAlloc*sizeof(CLUSTERSEQ)))
+               ==NULL)
+            {
+               fprintf(stderr,"E003: No memory for clustering\n");
+               exit(1);
+            }
+         }
+         seqs[nSeqs].id  = gdbm_seq_seqid.dptr;
+         seqs[nSeqs].seq = data;
+         seqs[nSeqs].len = strlen(data);
+         nSeqs++;
+      }
+      if(gdbm_seq_seqdata.dptr)
+      {
+         free(gdbm_seq_seqdata.dptr);
+      }
+
+      /* The key is kept as the ID unless we failed to get a sequence  */
+      gdbm_next = gdbm_nextkey(gDBF_seqdata,gdbm_seq_seqid);
+      if(data == NULL)
+      {
+         free(gdbm_seq_seqid.dptr);
+      }
+      gdbm_seq_seqid = gdbm_next;
+   }
+
+   if(((repOf = (int *)malloc((nSeqs+1) * sizeof(int)))==NULL) ||
+      (ClusterSequences(seqs, nSeqs, identity, repOf) < 0))
+   {
+      fprintf(stderr,"E003: No memory for clustering\n");
+      exit(1);
+   }
+
+   for(i=0; i<nSeqs; i++)
+   {
+      if(repOf[i] != i)
+      {
+         Supersede(seqs[repOf[i]].id, seqs[i].id, EVENT_IDENTITY);
+         DropSequence(seqs[i].id);
+      }
+   }
+
+   for(i=0; i<nSeqs; i++)
+   {
+      free(seqs[i].id);
+      free(seqs[i].seq);
+   }
+   if(seqs  != NULL) free(seqs);
+   if(repOf != NULL) free(repOf);
+
+   retval = PurgeDeletedSequences();
+   MetricsEndStage();
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>void Supersede(char *parent, char *child, int reason)
+   -----------------------------------------------------
+   Input:     char   *parent    ID of the sequence being kept (NULL if
+                                the child is dropped for some other
+                                reason)
+              char   *child     ID of the sequence it superceeds
+              int    reason     Why (EVENT_xxx)
+
+   Called whenever one sequence superceeds another, just before the 
+   child is dropped. Reports it with -v and records it in the supersede
+   forest if cluster membership (-c) or merged deflines (-a) are 
+   wanted. For merged deflines (or a state file), the child's file 
+   locator is kept as well so its header (or entry) can be read back by
+   WriteResults() (or WriteState()).
+
+   Also called with no parent when a sequence is dropped for another
+   reason. All events are written to the -b event log if there is one.
+
+   19.10.26 Original
+   19.10.26 Added reason and writes the event log
+   19.10.26 Keeps the locator for a state file too
+*/
+void Supersede(char *parent, char *child, int reason)
+{
+   datum gdbm_seq_key,
+         gdbm_seq_data;
+
+   if(gEventFile[0])
+   {
+      LogEvent((parent!=NULL)?(unsigned long)ForestIndex(parent, TRUE)
+                             :EVENT_NO_PARENT,
+               (unsigned long)ForestIndex(child, TRUE),
+               reason, MetricsStage());
+   }
+
+   if(parent == NULL)
+      return;
+
+   if(gVerbose)
+   {
+      fprintf(stderr,"INFO: %s superceeds %s\n", parent, child);
+   }
+
+   if(gForest)
+   {
+      gdbm_seq_data.dptr = NULL;
+      if(gLocators)
+      {
+         CREATEDATUM(gdbm_seq_key, child);
+         gdbm_seq_data = gdbm_fetch(gDBF_seqdata, gdbm_seq_key);
+      }
+      ForestAddEdge(parent, child, gdbm_seq_data.dptr);
+      if(gdbm_seq_data.dptr != NULL)
+         free(gdbm_seq_data.dptr);
+   }
+}
+
+
+/************************************************************************/
+/*>BOOL OpenEvents(char *filename)
+   -------------------------------
+   Input:     char   *filename  Event log file
+   Returns:   BOOL              Success?
+
+   Opens the -b event log, reporting any error
+
+   19.10.26 Original
+*/
+BOOL OpenEvents(char *filename)
+{
+   if(!OpenEventLog(filename))
+   {
+      fprintf(stderr,"E001: Can't write %s\n", filename);
+      gEventFile[0] = '\0';
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void CloseEvents(char *filename)
+   --------------------------------
+   Input:     char   *filename  Event log file
+
+   Finishes the -b event log by writing the IDs from the supersede 
+   forest
+
+   19.10.26 Original
+*/
+void CloseEvents(char *filename)
+{
+   if(gEventFile[0] && !CloseEventLog(ForestSize(), ForestID))
+   {
+      fprintf(stderr,"E001: Can't write %s\n", filename);
+   }
+}
+
+
+/************************************************************************/
+/*>BOOL WriteClusters(char *filename)
+   ----------------------------------
+   Input:     char   *filename  File to write
+   Returns:   BOOL              Success?
+
+   Writes the cluster membership as a TSV file with a line for each 
+   sequence giving the ID of the representative (the sequence kept in
+   the output) and the ID of the member. Each representative is the
+   first member of its own cluster.
+
+   19.10.26 Original
+   19.10.26 Skips deleted sequences
+   19.10.26 Frees each key
+*/
+BOOL WriteClusters(char *filename)
+{
+   FILE  *fp;
+   datum gdbm_seq_seqid,
+         gdbm_seq_seqdata,
+         gdbm_next;
+   BOOL  retval;
+
+   if((fp=fopen(filename,"w"))==NULL)
+      return(FALSE);
+
+   gdbm_seq_seqid = gdbm_firstkey(gDBF_seqdata);
+   while(gdbm_seq_seqid.dptr)
+   {
+      gdbm_seq_seqdata = gdbm_fetch(gDBF_seqdata, gdbm_seq_seqid);
+      if(gdbm_seq_seqdata.dptr != NULL)
+      {
+         if(!IsTombstone(SequenceIndex(gdbm_seq_seqdata)))
+            ForestMarkKept(gdbm_seq_seqid.dptr);
+         free(gdbm_seq_seqdata.dptr);
+      }
+      gdbm_next = gdbm_nextkey(gDBF_seqdata,gdbm_seq_seqid);
+      free(gdbm_seq_seqid.dptr);
+      gdbm_seq_seqid = gdbm_next;
+   }
+
+   retval = ForestWriteTSV(fp);
+   if(fclose(fp))
+      retval = FALSE;
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>void WriteMergedHeader(OUTFILE *out, char *seqid, char *entry)
+   --------------------------------------------------------------
+   Input:     OUTFILE *out      Output file
+              char   *seqid     ID of the sequence
+              char   *entry     The complete FASTA entry
+
+   Writes a FASTA entry with the headers of all the sequences it 
+   superceeded added to its own, separated by Ctrl-A characters in the
+   style of the NCBI nr database.
+
+   19.10.26 Original
+   19.10.26 Writes to an OUTFILE
+   19.10.26 Reuses one buffer for the members
+*/
+void WriteMergedHeader(OUTFILE *out, char *seqid, char *entry)
+{
+   static SEQBUFF sMember = {NULL, 0, 0, 0};
+   char  *body,
+         *member;
+   int   rep,
+         i;
+   datum gdbm_member;
+
+   if((body = strchr(entry, '\n')) == NULL)
+   {
+      OutWrite(out, entry, strlen(entry));
+      return;
+   }
+   OutWrite(out, entry, (int)(body-entry));
+
+   /* The first member is the sequence itself                           */
+   if(((rep = ForestIndex(seqid, FALSE)) >= 0) &&
+      ((i = ForestFirstMember(rep)) >= 0))
+   {
+      for(i=ForestNextMember(i); i != (-1); i=ForestNextMember(i))
+      {
+         if((gdbm_member.dptr = ForestLocator(i)) == NULL)
+            continue;
+         gdbm_member.dsize = strlen(gdbm_member.dptr)+1;
+         if((member = FetchSequence(gdbm_member, TRUE, &sMember)) 
+            != NULL)
          {
-            if(!full)
+            if(*member == '>')
             {
-               TERMINATE(ptr);
+               *member = '\001';
+               OutWrite(out, member, (int)strcspn(member, "\n"));
             }
-            data = strcatalloc(data, ptr);
          }
       }
    }
+
+   OutWrite(out, body, strlen(body));
+}
+
+
+/************************************************************************/
+/*>BOOL MergeSequenceHashes(void)
+   ------------------------------
+   Returns:   BOOL                 Success?
+
+   Merge the sequences from the current file into the rest. Since they
+   are all in the one hash, this just moves the watermark (gFirstNew)
+   past them and empties the key file. Duplicates of sequences from 
+   earlier files are only in the key file so are forgotten.
+
+   15.06.00 Original   By: ACRM
+   19.10.26 Records metrics
+   19.10.26 Skips deleted sequences
+   19.10.26 Just moves the watermark
+   19.10.26 Forgets duplicates of sequences from earlier files
+*/
+BOOL MergeSequenceHashes(void)
+{
+   if(gVerbose > 1)
+   {
+      fprintf(stderr,"TRACE: Merging Sequence Hashes...\n");
+   }
+   MetricsStartStage(STAGE_MERGE);
+   METRIC_ADD(seqsIn,  gNTempSeqs + gNTempDups);
+   METRIC_ADD(seqsOut, gNTempSeqs);
+   
+   gNSeqs     += gNTempSeqs;
+   gNTempSeqs  = 0;
+   gNTempDups  = 0;
+   gFirstNew   = gNIndex;
+
+   rewind(gKeys);
+   gKeysEnd    = 0;
    
+   MetricsEndStage();
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>char *GetSequence(datum content, BOOL full)
+   -------------------------------------------
+   Input:     datum   content   GDBM datum structure containing the
+                                filename and fseek() pointer
+              BOOL    full      Get the header as well as the sequence
+   Returns:   char    *         Pointer to sequence data
+
+   The sequence hash contains an fseek() pointer into the sequence data
+   file. This routine reads the actual sequence data into a malloc'd
+   block of memory.
+
+   15.06.00 Original   By: ACRM
+   30.06.00 'content' is now a filename and fseek() pointer into an
+            actual sequence file
+   11.07.00 Fixed memory leak
+   19.10.26 Reads through a SEQFILE so BGZF files are fetched from the
+            block cache. Files are kept open by GetSeqFile() rather
+            than being closed when the filename changes
+   19.10.26 Reads whole lines with SeqFileGetLine() into a SEQBUFF, so
+            headers and sequences may be any length
+   19.10.26 Reading moved to ReadEntry()
+   19.10.26 Now just FetchSequence() into a new buffer
+*/
+char *GetSequence(datum content, BOOL full)
+{
+   SEQBUFF sb;
+
+   sb.data   = NULL;
+   sb.length = sb.size = sb.nX = 0;
+   return(FetchSequence(content, full, &sb));
+}
+
+
+/************************************************************************/
+/*>char *FetchSequence(datum content, BOOL full, SEQBUFF *sb)
+   ----------------------------------------------------------
+   Input:     datum   content   GDBM datum structure containing the
+                                filename and fseek() pointer
+              BOOL    full      Get the header as well as the sequence
+   I/O:       SEQBUFF *sb       Buffer to read into
+   Returns:   char    *         The sequence data in the buffer (NULL 
+                                if it can't be read)
+
+   As GetSequence() but reads into a buffer which the caller keeps, so
+   a loop fetching many sequences only allocates memory when it meets
+   one longer than any before it. The data are overwritten by the next
+   fetch into the same buffer.
+
+   19.10.26 Original (from GetSequence())
+*/
+char *FetchSequence(datum content, BOOL full, SEQBUFF *sb)
+{
+   char    filename[MAXBUFF],
+           *data;
+   long    offset,
+           nBytes = 0;
+   SEQFILE *fp;
+
+   if(content.dptr==NULL)
+      return(NULL);
+
+   sscanf(content.dptr,"%s %ld", filename, &offset);
+   if((fp = GetSeqFile(filename)) == NULL)
+      return(NULL);
+
+   data = ReadEntry(fp, offset, full, sb, &nBytes);
+   METRIC_ADD(bytesRead, nBytes);
    return(data);
 }
 
 
 /************************************************************************/
-/*>void WriteResults(FILE *out)
-   ----------------------------
-   Input:     FILE   *out      Output file pointer
+/*>char *ReadEntry(SEQFILE *fp, long offset, BOOL full, SEQBUFF *sb,
+                   long *nBytes)
+   -----------------------------------------------------------------
+   Input:     SEQFILE *fp         Sequence file
+              long    offset      Offset of the entry
+              BOOL    full        Read the whole entry rather than just
+                                  the sequence
+   I/O:       SEQBUFF *sb         Buffer to read into (emptied first)
+   Output:    long    *nBytes     Number of bytes read
+   Returns:   char    *           The entry or sequence in the buffer
+                                  (NULL if it can't be read)
+
+   Reads an entry from a sequence file. Unless full is set, the header
+   is skipped and the newlines are removed so just the sequence is 
+   returned.
+
+   19.10.26 Original (from GetSequence())
+   19.10.26 Reads into a buffer given by the caller
+*/
+char *ReadEntry(SEQFILE *fp, long offset, BOOL full, SEQBUFF *sb,
+                long *nBytes)
+{
+   char    *line;
+   int     length;
+   long    nLines = 0;
+
+   *nBytes    = 0;
+   sb->length = sb->nX = 0;
+   if(!SeqFileSeek(fp, offset))
+      return(NULL);
+
+   if(!full)
+   {
+      /* Throw away the first line                                      */
+      if((line = SeqFileGetLine(fp, &length)) != NULL)
+         *nBytes += length;
+   }
+      
+   while((line = SeqFileGetLine(fp, &length))!=NULL)
+   {
+      *nBytes += length;
+      if((*line == '>') &&          /* Start of new entry. Jump out     */
+         (nLines != 0)) 
+      {
+         break;
+      }
+      else if(!AppendToSeqBuff(sb, line, length, !full))
+      {
+         break;
+      }
+      nLines++;
+   }
+   
+   return(nLines ? sb->data : NULL);
+}
+
+
+/************************************************************************/
+/*>void WriteResults(OUTFILE *out, BOOL mergeDeflines)
+   ----------------------------------------------------
+   Input:     OUTFILE *out          Output file
+              BOOL   mergeDeflines  Add the headers of the sequences
+                                    each one superceeded
 
    Write the non-redundant sequences to the output file
 
    15.06.00 Original   By: ACRM
    30.06.00 Modified to use GetSequence()
+   19.10.26 Records metrics
+   19.10.26 Added mergeDeflines
+   19.10.26 Writes to an OUTFILE
+   19.10.26 Skips deleted sequences
+   19.10.26 Reuses one entry buffer. Frees each key
 */
-void WriteResults(FILE *out)
+void WriteResults(OUTFILE *out, BOOL mergeDeflines)
 {
+   static SEQBUFF sEntry = {NULL, 0, 0, 0};
    char      *seq;
    datum     gdbm_seq_seqid,
-             gdbm_seq_seqdata;
+             gdbm_seq_seqdata,
+             gdbm_next;
    
    if(gVerbose > 1)
    {
       fprintf(stderr,"TRACE: Writing Results...\n");
    }
+   MetricsNewFile("(output)");
+   MetricsStartStage(STAGE_WRITE);
+   SetProgressTotals(gNSeqs, 0L);
    
    gdbm_seq_seqid = gdbm_firstkey(gDBF_seqdata);
    while(gdbm_seq_seqid.dptr)
    {
+      METRIC(seqsIn);
+      PROGRESS();
       gdbm_seq_seqdata = gdbm_fetch(gDBF_seqdata, gdbm_seq_seqid);
-      seq = GetSequence(gdbm_seq_seqdata, TRUE);
+      if((gdbm_seq_seqdata.dptr != NULL) &&
+         !IsTombstone(SequenceIndex(gdbm_seq_seqdata)))
+      {
+         METRIC(seqsOut);
+         if((seq = FetchSequence(gdbm_seq_seqdata, TRUE, &sEntry))
+            != NULL)
+         {
+            if(mergeDeflines)
+            {
+               WriteMergedHeader(out, gdbm_seq_seqid.dptr, seq);
+            }
+            else
+            {
+               OutWrite(out, seq, strlen(seq));
+            }
+         }
+      }
       if(gdbm_seq_seqdata.dptr)
       {
          free(gdbm_seq_seqdata.dptr);
       }
-      fprintf(out,"%s", seq);
-      free(seq);
-      gdbm_seq_seqid=gdbm_nextkey(gDBF_seqdata,gdbm_seq_seqid);
+      gdbm_next = gdbm_nextkey(gDBF_seqdata,gdbm_seq_seqid);
+      free(gdbm_seq_seqid.dptr);
+      gdbm_seq_seqid = gdbm_next;
    }
+   MetricsEndStage();
 }
 
 
@@ -1372,44 +3016,1918 @@ void WriteResults(FILE *out)
    selecting the alphabetically higher ID, B replaces A, C replaces B
    and C replaces A so we end up with C.
 
+   With -D, a sequence also contains another if it contains its reverse
+   complement.
+
    15.06.00 Original   By: ACRM
    14.07.00 Added id parameters
+   19.10.26 Records metrics
+   19.10.26 Checks the other strand with -D
 */
 int CompareSequences(char *seq1, char *id1, char *seq2, char *id2)
 {
    int len1, 
-       len2;
+       len2,
+       result = 0;
    
    len1 = strlen(seq1);
    len2 = strlen(seq2);
    
    if(len2 < len1)               /* Seq2 is shorter                     */
    {
-      if(strstr(seq1, seq2))
+      if(strstr(seq1, seq2) || (gDNA && ContainsRevComp(seq1, seq2)))
       {
-         return(1);
+         result = 1;
       }
    }
    else if(len1 < len2)          /* Seq1 is shorter                     */
    {
-      if(strstr(seq2, seq1))
+      if(strstr(seq2, seq1) || (gDNA && ContainsRevComp(seq2, seq1)))
       {
-         return(2);
+         result = 2;
       }
    }
    else                          /* Same length                         */
    {
-      if(!strcmp(seq1, seq2))    /* Sequences are identical             */
+      if(!strcmp(seq1, seq2) ||  /* Sequences are identical             */
+         (gDNA && ContainsRevComp(seq1, seq2)))
       {
          /* Compare the identifiers and return the alphabetically higher
             one
          */
-         return((strcmp(id1,id2) > 0)?1:2);
+         result = (strcmp(id1,id2) > 0)?1:2;
       }
    }
    
+   METRIC(compares);
+   METRIC(compareResults[result]);
    
-   return(0);
+   return(result);
+}
+
+
+/************************************************************************/
+/*>int CompareSequencesAt(char *seq1, char *id1, char *seq2, char *id2,
+                          int diag)
+   --------------------------------------------------------------------
+   Input:     char   *seq1      First sequence
+              char   *id1       First identifier
+              char   *seq2      Second sequence
+              char   *id2       Second identifier
+              int    diag       Offset in seq1 of the start of seq2
+   Returns:   int               0: Sequences differ
+                                1: First sequence contains the second
+                                2: Second sequence contains the first
+
+   Mismatch mode version of CompareSequences(). Checks whether the 
+   shorter sequence lies within the longer one at the given diagonal 
+   with no more than gMismatches mismatches. As before, if the sequences
+   are the same length the one with the alphabetically higher 
+   identifier is kept.
+
+   19.10.26 Original
+*/
+int CompareSequencesAt(char *seq1, char *id1, char *seq2, char *id2,
+                       int diag)
+{
+   int len1, 
+       len2,
+       result = 0;
+   
+   len1 = strlen(seq1);
+   len2 = strlen(seq2);
+   
+   if(len2 < len1)               /* Seq2 is shorter                     */
+   {
+      if((diag >= 0) && (diag+len2 <= len1) &&
+         (CountMismatches(seq1+diag, seq2, len2, gMismatches) 
+          <= gMismatches))
+      {
+         result = 1;
+      }
+   }
+   else if(len1 < len2)          /* Seq1 is shorter                     */
+   {
+      if((diag <= 0) && (len1-diag <= len2) &&
+         (CountMismatches(seq2-diag, seq1, len1, gMismatches) 
+          <= gMismatches))
+      {
+         result = 2;
+      }
+   }
+   else                          /* Same length                         */
+   {
+      if((diag == 0) &&
+         (CountMismatches(seq1, seq2, len1, gMismatches) <= gMismatches))
+      {
+         result = (strcmp(id1,id2) > 0)?1:2;
+      }
+   }
+   
+   METRIC(compares);
+   METRIC(compareResults[result]);
+   
+   return(result);
+}
+
+
+/************************************************************************/
+/*>BOOL RunShards(char **files, int nFiles, BOOL FirstIsNR, int fragSize,
+                  int rejectSize, int nShards, OUTFILE *out)
+   ---------------------------------------------------------------------
+   Input:     char   **files      Input files
+              int    nFiles       Number of input files
+              BOOL   FirstIsNR    First file is already non-redundant
+              int    fragSize     Fragment size
+              int    rejectSize   Reject sequences up to this length
+              int    nShards      Number of worker processes
+              OUTFILE *out        Output file
+   Returns:   BOOL                Success?
+
+   Forks nShards worker processes. Each reads all the input files, but
+   only keeps the sequences which InShard() assigns to it, and runs the
+   normal stages on those using its own set of hashes. It then writes
+   its non-redundant set to a shard file in the temporary directory.
+
+   The reconciliation pass then reads all the shard files into our own
+   hashes as if they were a single input file and runs the hashing and
+   redundancy stages on the lot. If cluster membership is wanted, each
+   worker also writes out its supersede forest to be added to ours.
+   Since the workers each read all the input, standard input is first
+   copied to a file for them. This applies the CompareSequences() 
+   rules across the shards. (Processing the shard files as separate 
+   input files would not do, since a sequence is only checked against
+   the fragments of those from the same or earlier files, so a sequence
+   contained in one from an earlier file can survive.)
+
+   19.10.26 Original
+   19.10.26 Collects the supersede forests from the workers
+   19.10.26 Writes to an OUTFILE
+   19.10.26 Copies stdin to a file
+   19.10.26 Workers run by RunWorker() and results read by 
+            ReadPartFile()
+   19.10.26 Frees the shard file names and pids if it can't start
+*/
+BOOL RunShards(char **files, int nFiles, BOOL FirstIsNR, int fragSize,
+               int rejectSize, int nShards, OUTFILE *out)
+{
+   char  **shardFiles,
+         stdinFile[MAXBUFF+40];
+   pid_t *pids;
+   int   shard,
+         status;
+   BOOL  retval = TRUE;
+
+   if(((shardFiles = PartFileNames(nShards))==NULL) ||
+      ((pids       = (pid_t *)malloc(nShards * sizeof(pid_t)))==NULL))
+   {
+      if(shardFiles != NULL)
+         FreePartFiles(shardFiles, nShards);
+      fprintf(stderr,"E003: No memory for shard storage\n");
+      return(FALSE);
+   }
+   
+   if(!SpoolStdinFiles(files, nFiles, stdinFile))
+   {
+      FreePartFiles(shardFiles, nShards);
+      free(pids);
+      return(FALSE);
+   }
+
+   if(gVerbose > 1)
+   {
+      fprintf(stderr,"TRACE: Starting %d shard workers...\n", nShards);
+   }
+
+   /* Start the workers                                                 */
+   fflush(stdout);
+   fflush(stderr);
+   for(shard=0; shard<nShards; shard++)
+   {
+      if((pids[shard] = fork()) == 0)
+      {
+         gShard = shard;
+         gNShards = nShards;
+         _exit(RunWorker(files, nFiles, FirstIsNR, fragSize, rejectSize,
+                         shardFiles[shard], shard));
+      }
+      else if(pids[shard] == (-1))
+      {
+         fprintf(stderr,"E006: Shard worker %d failed\n", shard);
+         retval = FALSE;
+      }
+   }
+
+   /* Wait for them all to finish                                       */
+   for(shard=0; shard<nShards; shard++)
+   {
+      if(pids[shard] > 0)
+      {
+         if((waitpid(pids[shard], &status, 0) == (-1)) ||
+            !WIFEXITED(status) || WEXITSTATUS(status))
+         {
+            fprintf(stderr,"E006: Shard worker %d failed\n", shard);
+            retval = FALSE;
+         }
+      }
+   }
+
+   /* Reconcile the shards and write the results                        */
+   if(retval)
+   {
+      if(gVerbose > 1)
+      {
+         fprintf(stderr,"TRACE: Reconciling shards...\n");
+      }
+
+      /* Read all the shard files into the hash so that they are treated
+         as a single input file
+      */
+      MetricsNewFile("(reconcile)");
+      if(gEventFile[0])
+         OpenEvents(gEventFile);
+      for(shard=0; shard<nShards; shard++)
+      {
+         if(!ReadPartFile(shardFiles[shard], fragSize, rejectSize))
+            retval = FALSE;
+      }
+
+      if(retval && HashSequences(fragSize, FALSE))
+      {
+         DropRedundancies(fragSize);
+         MergeSequenceHashes();
+         if(gIdentity > 0.0)
+         {
+            ClusterResults(gIdentity);
+         }
+         WriteResults(out, gMergeDeflines);
+      }
+      CloseEvents(gEventFile);
+   }
+
+   FreePartFiles(shardFiles, nShards);
+   free(pids);
+   if(stdinFile[0])
+      unlink(stdinFile);
+   
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>BOOL RunJobs(char **files, int nFiles, BOOL FirstIsNR, int fragSize,
+                int rejectSize, int nJobs, OUTFILE *out)
+   -------------------------------------------------------------------
+   Input:     char   **files      Input files
+              int    nFiles       Number of input files
+              BOOL   FirstIsNR    First file is already non-redundant
+              int    fragSize     Fragment size
+              int    rejectSize   Reject sequences up to this length
+              int    nJobs        Number of worker processes to run at
+                                  once
+              OUTFILE *out        Output file
+   Returns:   BOOL                Success?
+
+   Forks a worker process for each input file, running up to nJobs of 
+   them at once, which makes that file non-redundant on its own and 
+   writes the result to a part file in the temporary directory.
+
+   The reconciliation pass then reads the part files back. If the first
+   file was flagged as non-redundant, its part is loaded first without
+   any checking, just as it would be without -j. All the other parts 
+   are then read in as if they were a single input file and checked 
+   against each other (and the first) in one pass.
+
+   19.10.26 Original
+   19.10.26 Frees the part file names and pids if it can't start
+*/
+BOOL RunJobs(char **files, int nFiles, BOOL FirstIsNR, int fragSize,
+             int rejectSize, int nJobs, OUTFILE *out)
+{
+   char  **partFiles,
+         stdinFile[MAXBUFF+40];
+   pid_t *pids,
+         pid;
+   int   job,
+         next,
+         nRunning = 0,
+         status;
+   BOOL  retval = TRUE;
+
+   if(((partFiles = PartFileNames(nFiles))==NULL) ||
+      ((pids      = (pid_t *)malloc(nFiles * sizeof(pid_t)))==NULL))
+   {
+      if(partFiles != NULL)
+         FreePartFiles(partFiles, nFiles);
+      fprintf(stderr,"E003: No memory for job storage\n");
+      return(FALSE);
+   }
+
+   if(!SpoolStdinFiles(files, nFiles, stdinFile))
+   {
+      FreePartFiles(partFiles, nFiles);
+      free(pids);
+      return(FALSE);
+   }
+
+   if(gVerbose > 1)
+   {
+      fprintf(stderr,"TRACE: Starting %d file workers, %d at a time...\n",
+              nFiles, nJobs);
+   }
+
+   /* Start a worker for each file, waiting for one to finish whenever
+      nJobs are running
+   */
+   fflush(stdout);
+   fflush(stderr);
+   for(next=0; (next<nFiles) || nRunning; )
+   {
+      if((next < nFiles) && (nRunning < nJobs))
+      {
+         if((pids[next] = fork()) == 0)
+         {
+            _exit(RunWorker(files+next, 1, 
+                            ((next==0)?FirstIsNR:FALSE), 
+                            fragSize, rejectSize, partFiles[next], 
+                            next));
+         }
+         else if(pids[next] == (-1))
+         {
+            fprintf(stderr,"E006: File worker %d failed\n", next);
+            retval = FALSE;
+         }
+         else
+         {
+            nRunning++;
+         }
+         next++;
+      }
+      else
+      {
+         if((pid = waitpid((pid_t)(-1), &status, 0)) == (-1))
+            break;
+         for(job=0; job<next; job++)
+         {
+            if(pids[job] == pid)
+            {
+               nRunning--;
+               if(!WIFEXITED(status) || WEXITSTATUS(status))
+               {
+                  fprintf(stderr,"E006: File worker %d failed\n", job);
+                  retval = FALSE;
+               }
+            }
+         }
+      }
+   }
+
+   /* Reconcile the files and write the results                         */
+   if(retval)
+   {
+      if(gVerbose > 1)
+      {
+         fprintf(stderr,"TRACE: Reconciling files...\n");
+      }
+
+      MetricsNewFile("(reconcile)");
+      if(gEventFile[0])
+         OpenEvents(gEventFile);
+
+      job = 0;
+      if(FirstIsNR)
+      {
+         if(!ReadPartFile(partFiles[job++], fragSize, rejectSize) ||
+            !HashSequences(fragSize, TRUE) ||
+            !MergeSequenceHashes())
+            retval = FALSE;
+      }
+      for(; job<nFiles; job++)
+      {
+         if(!ReadPartFile(partFiles[job], fragSize, rejectSize))
+            retval = FALSE;
+      }
+
+      if(retval && HashSequences(fragSize, FALSE))
+      {
+         DropRedundancies(fragSize);
+         MergeSequenceHashes();
+         if(gIdentity > 0.0)
+         {
+            ClusterResults(gIdentity);
+         }
+         WriteResults(out, gMergeDeflines);
+      }
+      CloseEvents(gEventFile);
+   }
+
+   FreePartFiles(partFiles, nFiles);
+   free(pids);
+   if(stdinFile[0])
+      unlink(stdinFile);
+   
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>int RunWorker(char **files, int nFiles, BOOL FirstIsNR, int fragSize,
+                 int rejectSize, char *partFile, int worker)
+   ---------------------------------------------------------------------
+   Input:     char   **files      Input files
+              int    nFiles       Number of input files
+              BOOL   FirstIsNR    First file is already non-redundant
+              int    fragSize     Fragment size
+              int    rejectSize   Reject sequences up to this length
+              char   *partFile    File for the results
+              int    worker       Number of this worker
+   Returns:   int                 Exit status (0 if OK)
+
+   The work done by a worker process for RunShards() or RunJobs(). 
+   CreateHashes() and CleanUp() use our own PID so these hashes are
+   distinct from the parent's. Runs the normal stages on the files and
+   writes the results to partFile. The supersede forest (if wanted) is
+   written to partFile.edges and the event log and metrics (if wanted)
+   to files with .worker added to their names.
+
+   19.10.26 Original (split out of RunShards())
+*/
+int RunWorker(char **files, int nFiles, BOOL FirstIsNR, int fragSize,
+              int rejectSize, char *partFile, int worker)
+{
+   char    eventFile[MAXBUFF+16],
+           edgeFile[MAXBUFF+16],
+           metricsFile[MAXBUFF+16];
+   int     status = 1,
+           i;
+   FILE    *fp;
+   OUTFILE *of;
+
+   gProgress = FALSE;
+   if(!CreateHashes())
+      return(status);
+
+   /* Each worker writes its own event log                              */
+   sprintf(eventFile,"%s.%d",gEventFile,worker);
+   if(gEventFile[0])
+      OpenEvents(eventFile);
+
+   for(i=0; i<nFiles; i++)
+   {
+      NonRedundantise(files[i], ((i==0)?FirstIsNR:FALSE),
+                      fragSize, rejectSize);
+   }
+            
+   if((fp=fopen(partFile,"w"))==NULL)
+   {
+      fprintf(stderr,"E001: Can't write %s\n",partFile);
+   }
+   else
+   {
+      if((of = OpenOutFile(fp, 0)) != NULL)
+      {
+         WriteResults(of, FALSE);
+         if(CloseOutFile(of))
+            status = 0;
+      }
+      fclose(fp);
+   }
+   CloseEvents(eventFile);
+   CleanUp();
+
+   /* Pass the supersede forest back to the parent                      */
+   if(gForest && !status)
+   {
+      sprintf(edgeFile,"%s.edges",partFile);
+      if((fp=fopen(edgeFile,"w"))==NULL)
+      {
+         fprintf(stderr,"E001: Can't write %s\n",edgeFile);
+         status = 1;
+      }
+      else
+      {
+         ForestWriteEdges(fp);
+         fclose(fp);
+      }
+   }
+
+   /* Each worker writes its own metrics file                           */
+   if(gMetricsFile[0])
+   {
+      sprintf(metricsFile,"%s.%d",gMetricsFile,worker);
+      if(!WriteMetrics(metricsFile))
+      {
+         fprintf(stderr,"E001: Can't write %s\n",metricsFile);
+      }
+   }
+   
+   return(status);
+}
+
+
+/************************************************************************/
+/*>BOOL ReadPartFile(char *partFile, int fragSize, int rejectSize)
+   ---------------------------------------------------------------
+   Input:     char   *partFile    Results written by a worker
+              int    fragSize     Fragment size
+              int    rejectSize   Reject sequences up to this length
+   Returns:   BOOL                Success?
+
+   Reads the results of a worker into the sequence hash (without 
+   starting a new file) and adds what it superceeded to our forest.
+
+   19.10.26 Original (split out of RunShards())
+*/
+BOOL ReadPartFile(char *partFile, int fragSize, int rejectSize)
+{
+   char    edgeFile[MAXBUFF+16];
+   SEQFILE *sf;
+   FILE    *fp;
+   BOOL    retval = TRUE;
+   
+   if((sf=OpenSeqFile(partFile))==NULL)
+   {
+      fprintf(stderr,"E004: Can't read %s\n", partFile);
+      retval = FALSE;
+   }
+   else
+   {
+      if(!ReadSequences(sf, partFile, rejectSize, fragSize))
+      {
+         fprintf(stderr,"E005: Failed to read sequences from %s\n",
+                 partFile);
+         retval = FALSE;
+      }
+      CloseSeqFile(sf);
+   }
+
+   /* Add what this worker superceeded to our forest                    */
+   if(gForest)
+   {
+      sprintf(edgeFile,"%s.edges",partFile);
+      if(((fp=fopen(edgeFile,"r"))==NULL) || !ForestReadEdges(fp))
+      {
+         fprintf(stderr,"E005: Failed to read sequences from %s\n",
+                 edgeFile);
+         retval = FALSE;
+      }
+      if(fp != NULL)
+         fclose(fp);
+      unlink(edgeFile);
+   }
+
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>char **PartFileNames(int nParts)
+   --------------------------------
+   Input:     int    nParts     Number of worker result files
+   Returns:   char   **         Their names (NULL if no memory)
+
+   Names the files in the temporary directory in which the workers 
+   write their results
+
+   19.10.26 Original (split out of RunShards())
+*/
+char **PartFileNames(int nParts)
+{
+   char  **partFiles;
+   int   i;
+
+   if((partFiles = (char **)malloc(nParts * sizeof(char *)))==NULL)
+      return(NULL);
+   
+   for(i=0; i<nParts; i++)
+   {
+      if((partFiles[i] = (char *)malloc((MAXBUFF+40) * sizeof(char)))==NULL)
+      {
+         FreePartFiles(partFiles, i);
+         return(NULL);
+      }
+      sprintf(partFiles[i],"%s/%s.%d.%d",
+              gGDBMDir,DEFAULT_SHARDFILE,(int)getpid(),i);
+   }
+   return(partFiles);
+}
+
+
+/************************************************************************/
+/*>void FreePartFiles(char **partFiles, int nParts)
+   ------------------------------------------------
+   Input:     char   **partFiles  Names of the worker result files
+              int    nParts       Number of them
+
+   Deletes the files and frees the names
+
+   19.10.26 Original (split out of RunShards())
+*/
+void FreePartFiles(char **partFiles, int nParts)
+{
+   int i;
+   
+   for(i=0; i<nParts; i++)
+   {
+      unlink(partFiles[i]);
+      free(partFiles[i]);
+   }
+   free(partFiles);
+}
+
+
+/************************************************************************/
+/*>BOOL SpoolStdinFiles(char **files, int nFiles, char *stdinFile)
+   ---------------------------------------------------------------
+   I/O:       char   **files      Input files. Any given as - are 
+                                  replaced by stdinFile
+   Input:     int    nFiles       Number of input files
+   Output:    char   *stdinFile   The copy of stdin (blank if none)
+   Returns:   BOOL                Success?
+
+   Since the workers can't share standard input, it is copied to a file
+   in the temporary directory for them to read.
+
+   19.10.26 Original (split out of RunShards())
+*/
+BOOL SpoolStdinFiles(char **files, int nFiles, char *stdinFile)
+{
+   int i;
+   
+   stdinFile[0] = '\0';
+   for(i=0; i<nFiles; i++)
+   {
+      if(!strcmp(files[i], "-"))
+      {
+         if(!stdinFile[0])
+         {
+            TempName(stdinFile, DEFAULT_STDINFILE);
+            if(!SpoolStdin(stdinFile))
+            {
+               fprintf(stderr,"E001: Can't write %s\n", stdinFile);
+               unlink(stdinFile);
+               return(FALSE);
+            }
+         }
+         files[i] = stdinFile;
+      }
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>long SequenceIndex(datum content)
+   ---------------------------------
+   Input:     datum   content   Entry from a sequence hash
+   Returns:   long              The sequence's index (-1 if none)
+
+   The entry is the filename, offset and index separated by spaces
+
+   19.10.26 Original
+*/
+long SequenceIndex(datum content)
+{
+   char *index;
+
+   if((content.dptr == NULL) || 
+      ((index = strrchr(content.dptr, ' ')) == NULL))
+      return(-1L);
+   return(atol(index+1));
+}
+
+
+/************************************************************************/
+/*>void StoreEntry(char *key, char *file, long entryStart)
+   -------------------------------------------------------
+   Input:     char   *key        Sequence ID
+              char   *file       Filename
+              long   entryStart  Offset of the entry in the file
+
+   Stores a sequence in the sequence hash with the next index and adds
+   its ID to the key file. An ID which is already there is a duplicate
+   unless that sequence has since been deleted, in which case it is
+   replaced. A duplicate of a sequence from an earlier file is still
+   checked along with this file (see StoreDuplicate()).
+
+   19.10.26 Original
+   19.10.26 Keeps duplicates of sequences from earlier files
+*/
+void StoreEntry(char *key, char *file, long entryStart)
+{
+   char  entryStartString[MAXBUFF+80];
+   datum gdbm_seq_seqid,
+         gdbm_seq_seqdata,
+         gdbm_old;
+   long  index = 0;
+
+   sprintf(entryStartString,"%s %ld %ld", file, entryStart, gNIndex);
+   CREATEDATUM(gdbm_seq_seqid,   key);
+   CREATEDATUM(gdbm_seq_seqdata, entryStartString);
+
+   if(gdbm_store(gDBF_seqdata, gdbm_seq_seqid, gdbm_seq_seqdata, 
+                 GDBM_INSERT))
+   {
+      gdbm_old = gdbm_fetch(gDBF_seqdata, gdbm_seq_seqid);
+      if(gdbm_old.dptr != NULL)
+      {
+         index = SequenceIndex(gdbm_old);
+         free(gdbm_old.dptr);
+      }
+
+      if((gdbm_old.dptr != NULL) && IsTombstone(index))
+      {
+         gdbm_store(gDBF_seqdata, gdbm_seq_seqid, gdbm_seq_seqdata, 
+                    GDBM_REPLACE);
+         gNDead--;
+      }
+      else
+      {
+         fprintf(stderr,"W001: Duplicate ID: %s\n", key);
+         if((gdbm_old.dptr != NULL) && (index < gFirstNew))
+            StoreDuplicate(key, file, entryStart);
+         return;
+      }
+   }
+
+   fwrite(key, 1, strlen(key)+1, gKeys);
+   gKeysEnd += strlen(key)+1;
+   METRIC(seqsOut);
+   gNTempSeqs++;
+   gNIndex++;
+}
+
+
+/************************************************************************/
+/*>void StoreDuplicate(char *key, char *file, long entryStart)
+   -----------------------------------------------------------
+   Input:     char   *key        Sequence ID
+              char   *file       Filename
+              long   entryStart  Offset of the entry in the file
+
+   Adds a duplicate of a sequence from an earlier file to the key file
+   along with where it is, marked with DUPLICATE_MARK. It is never 
+   stored in the sequence hash, but it is hashed and checked for 
+   redundancy under the ID as if it were the earlier sequence, so it 
+   can drop that sequence, until the files are merged. This is what 
+   happened when each file had its own sequence hash.
+
+   19.10.26 Original
+*/
+void StoreDuplicate(char *key, char *file, long entryStart)
+{
+   char location[MAXBUFF+80];
+
+   sprintf(location,"%s %ld", file, entryStart);
+   putc(DUPLICATE_MARK, gKeys);
+   fwrite(key, 1, strlen(key)+1, gKeys);
+   fwrite(location, 1, strlen(location)+1, gKeys);
+   gKeysEnd += strlen(key) + strlen(location) + 3;
+   METRIC(seqsOut);
+   gNTempDups++;
+}
+
+
+/************************************************************************/
+/*>char *NextKey(BOOL first, char **copy)
+   --------------------------------------
+   Input:     BOOL   first      Start from the first ID
+   Output:    char   **copy     Where a duplicate is in its file (NULL
+                                if this isn't a duplicate)
+   Returns:   char   *          The next ID (NULL if there are no more)
+
+   Reads the IDs of the sequences from the current file back from the
+   key file, where they are stored terminated by nulls. The file isn't
+   truncated between input files so anything after gKeysEnd is old.
+   The ID and copy are only valid until the next call.
+
+   19.10.26 Original
+   19.10.26 Returns the ID from a buffer which grows to fit it
+   19.10.26 Returns where a duplicate is
+*/
+char *NextKey(BOOL first, char **copy)
+{
+   static SEQBUFF sKey  = {NULL, 0, 0, 0},
+                  sCopy = {NULL, 0, 0, 0};
+
+   *copy = NULL;
+   if(first)
+      rewind(gKeys);
+
+   if(!ReadKey(&sKey))
+      return(NULL);
+
+   if(sKey.data[0] == DUPLICATE_MARK)
+   {
+      if(!ReadKey(&sCopy))
+         return(NULL);
+      *copy = sCopy.data;
+      return(sKey.data+1);
+   }
+   return(sKey.data);
+}
+
+
+/************************************************************************/
+/*>BOOL ReadKey(SEQBUFF *sb)
+   -------------------------
+   I/O:       SEQBUFF *sb       Buffer for the string
+   Returns:   BOOL              Was one read?
+
+   Reads the next null-terminated string before gKeysEnd from the key
+   file.
+
+   19.10.26 Original
+*/
+BOOL ReadKey(SEQBUFF *sb)
+{
+   char ch;
+   int  c;
+
+   if(ftell(gKeys) >= gKeysEnd)
+      return(FALSE);
+
+   sb->length = 0;
+   while((c = getc(gKeys)) != EOF)
+   {
+      if(c == '\0')
+         return(sb->data != NULL);
+      ch = (char)c;
+      if(!AppendToSeqBuff(sb, &ch, 1, FALSE))
+         return(FALSE);
+   }
+   return(FALSE);
+}
+
+
+/************************************************************************/
+/*>void RebuildBloom(long nKeys, int fragSize)
+   -------------------------------------------
+   Input:     long   nKeys     Number of fragments the filter must hold
+              int    fragSize  Fragment size
+
+   Recreates the Bloom filter with room for twice the number of 
+   fragments expected and adds everything in the fragment hash. If there
+   isn't the memory, fragments are looked up without a filter.
+
+   19.10.26 Original
+*/
+void RebuildBloom(long nKeys, int fragSize)
+{
+   datum key,
+         next;
+   
+   if(!BloomCreate(2 * nKeys))
+   {
+      fprintf(stderr,"W004: No memory for Bloom filter\n");
+      return;
+   }
+
+   for(key=gdbm_firstkey(gDBF_fragdata); key.dptr!=NULL; key=next)
+   {
+      BloomAdd(KmerHash(key.dptr, (gDNA ? key.dsize : fragSize-1)));
+      next = gdbm_nextkey(gDBF_fragdata, key);
+      free(key.dptr);
+   }
+}
+
+
+/************************************************************************/
+/*>BOOL MakeFragment(char *seq, int fragLen, char *fragment, datum *key)
+   ----------------------------------------------------------------------
+   Input:     char   *seq       Start of the fragment in the sequence
+              int    fragLen    Fragment length
+   Output:    char   *fragment  Space for the fragment (fragLen+1 chars)
+              datum  *key       Fragment hash key pointing to fragment
+   Returns:   BOOL              FALSE if the fragment can't be used
+
+   Makes the fragment hash key for the fragLen residues at seq. For
+   proteins this is the fragment itself. With -D it is the fragment or
+   its reverse complement, whichever packs lower, at 2 bits per base;
+   fragments containing anything but ACGT are not used.
+
+   19.10.26 Original
+*/
+BOOL MakeFragment(char *seq, int fragLen, char *fragment, datum *key)
+{
+   if(gDNA)
+   {
+      if(!PackCanonical(seq, fragLen, (unsigned char *)fragment))
+         return(FALSE);
+      key->dptr  = fragment;
+      key->dsize = DNA_PACKED_SIZE(fragLen);
+   }
+   else
+   {
+      strncpy(fragment, seq, fragLen);
+      fragment[fragLen] = '\0';
+      CREATEDATUM(*key, fragment);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>unsigned long FragmentHash(char *seq, int fragLen)
+   --------------------------------------------------
+   Input:     char   *seq       Start of the fragment in the sequence
+              int    fragLen    Fragment length
+   Returns:   unsigned long     Hash of the fragment's key
+
+   Hashes a fragment for the Bloom filter and minimizers. With -D both
+   strands of a fragment hash the same.
+
+   19.10.26 Original
+*/
+unsigned long FragmentHash(char *seq, int fragLen)
+{
+   return(gDNA ? CanonicalHash(seq, fragLen) : KmerHash(seq, fragLen));
+}
+
+
+/************************************************************************/
+/*>int NFragments(int length, int fragSize)
+   ----------------------------------------
+   Input:     int    length    Sequence length
+              int    fragSize  Fragment size
+   Returns:   int              Number of fragments to use as anchors
+
+   For proteins the last two fragments of a sequence have never been 
+   used. With -D every fragment is used, so that a sequence and its 
+   reverse complement have the same set of fragments.
+
+   19.10.26 Original
+*/
+int NFragments(int length, int fragSize)
+{
+   return(gDNA ? (length - (fragSize-1) + 1) : (length - fragSize));
+}
+
+
+/************************************************************************/
+/*>BOOL ServeFile(char *file, int fragSize, int rejectSize)
+   --------------------------------------------------------
+   Input:     char   *file      Non-redundant file to serve
+              int    fragSize   Fragment size
+              int    rejectSize Reject sequences up to this length
+   Returns:   BOOL              FALSE if the file couldn't be loaded or
+                                the server couldn't be started 
+                                (otherwise it runs until killed)
+
+   Loads the file, storing seeds for each sequence, then reopens the
+   hashes read-only and answers queries on the socket given with -S.
+
+   19.10.26 Original
+*/
+BOOL ServeFile(char *file, int fragSize, int rejectSize)
+{
+   char  name[MAXBUFF];
+
+   gServeFile     = file;
+   gServeFragSize = fragSize;
+   if(!NonRedundantise(file, TRUE, fragSize, rejectSize))
+      return(FALSE);
+
+   if(gMetricsFile[0] && !WriteMetrics(gMetricsFile))
+   {
+      fprintf(stderr,"E001: Can't write %s\n", gMetricsFile);
+   }
+
+   /* Reopen the hashes read-only so that each thread can open them too */
+   gdbm_close(gDBF_seqdata);
+   gdbm_close(gDBF_fragdata);
+   TempName(name, DEFAULT_SEQHASH);
+   gDBF_seqdata = gdbm_open(name, BLOCK_SIZE, GDBM_READER, MODE, NULL);
+   TempName(name, DEFAULT_FRAGHASH);
+   gDBF_fragdata = gdbm_open(name, BLOCK_SIZE, GDBM_READER, MODE, NULL);
+   if((gDBF_seqdata == NULL) || (gDBF_fragdata == NULL))
+   {
+      fprintf(stderr,"E002: Can't open GDBM hash for reading: %s\n", 
+              name);
+      return(FALSE);
+   }
+
+   if(gVerbose)
+   {
+      fprintf(stderr,"Serving %ld sequences from %s on %s\n",
+              gNSeqs, file, gServeSocket);
+   }
+   
+   return(Serve(gServeSocket, gServeThreads, OpenServeState, 
+                ServeQuery));
+}
+
+
+/************************************************************************/
+/*>void *OpenServeState(void)
+   --------------------------
+   Returns:   void   *          SERVESTATE for a server thread (NULL if
+                                it can't be made)
+
+   Opens the thread's own read-only handles on the hashes and the file
+   being served. Opened under gSeqFileLock since BGZF files share the
+   block cache.
+
+   19.10.26 Original
+   19.10.26 Frees the state and closes what was opened on failure
+*/
+void *OpenServeState(void)
+{
+   SERVESTATE *st;
+   char       name[MAXBUFF];
+
+   if(((st = (SERVESTATE *)calloc(1, sizeof(SERVESTATE)))==NULL) ||
+      ((st->fragment = (char *)malloc(gServeFragSize+1))==NULL))
+   {
+      fprintf(stderr,"E003: No memory for server thread\n");
+      if(st != NULL)
+         free(st);
+      return(NULL);
+   }
+
+   pthread_mutex_lock(&gSeqFileLock);
+   TempName(name, DEFAULT_SEQHASH);
+   st->seqdata  = gdbm_open(name, BLOCK_SIZE, GDBM_READER, MODE, NULL);
+   TempName(name, DEFAULT_FRAGHASH);
+   st->fragdata = gdbm_open(name, BLOCK_SIZE, GDBM_READER, MODE, NULL);
+   st->fp = OpenSeqFile(strcmp(gServeFile, "-") ? gServeFile 
+                                                : STREAM_NAME);
+   pthread_mutex_unlock(&gSeqFileLock);
+
+   if((st->seqdata == NULL) || (st->fragdata == NULL) || (st->fp == NULL))
+   {
+      fprintf(stderr,"E002: Server thread can't open the hashes or %s\n",
+              gServeFile);
+      pthread_mutex_lock(&gSeqFileLock);
+      if(st->seqdata != NULL)
+         gdbm_close(st->seqdata);
+      if(st->fragdata != NULL)
+         gdbm_close(st->fragdata);
+      if(st->fp != NULL)
+         CloseSeqFile(st->fp);
+      pthread_mutex_unlock(&gSeqFileLock);
+      free(st->fragment);
+      free(st);
+      return(NULL);
+   }
+   return((void *)st);
+}
+
+
+/************************************************************************/
+/*>int ServeQuery(void *state, char *seq, long length, char **hit)
+   ---------------------------------------------------------------
+   Input:     void   *state     The thread's SERVESTATE
+              char   *seq       Query sequence
+              long   length     Its length
+   Output:    char   **hit      ID of the stored sequence it is 
+                                contained in or contains
+   Returns:   int               SERVE_CONTAINED, SERVE_CONTAINS, 
+                                SERVE_NOVEL or SERVE_TOOSHORT
+
+   Slides a window along the query looking up each fragment in the
+   seed hash. Each hit gives a stored sequence and the diagonal on 
+   which it would align with the query, which is then checked by
+   CheckCandidate(). A query lying within a stored sequence (or 
+   identical to one) is reported in preference to one containing a 
+   stored sequence.
+
+   19.10.26 Original
+*/
+int ServeQuery(void *state, char *seq, long length, char **hit)
+{
+   SERVESTATE *st     = (SERVESTATE *)state;
+   int        seedLen = gServeFragSize - 1,
+              result  = SERVE_NOVEL,
+              found;
+   long       offset;
+   datum      gdbm_frag_key,
+              gdbm_list;
+   char       *entry,
+              *id;
+
+   *hit = NULL;
+   if((seedLen < 1) || (length < 2*seedLen - 1))
+      return(SERVE_TOOSHORT);
+
+   st->checked.length = 0;
+   for(offset=0; 
+       (offset+seedLen <= length) && 
+       (result != SERVE_CONTAINED) && (result != SERVE_ERROR); 
+       offset++)
+   {
+      strncpy(st->fragment, seq+offset, seedLen);
+      st->fragment[seedLen] = '\0';
+      CREATEDATUM(gdbm_frag_key, st->fragment);
+      gdbm_list = gdbm_fetch(st->fragdata, gdbm_frag_key);
+      if(gdbm_list.dptr == NULL)
+         continue;
+
+      /* The list holds ID/offset pairs                                 */
+      for(entry = gdbm_list.dptr; 
+          entry < gdbm_list.dptr + gdbm_list.dsize;
+          entry += strlen(entry)+1)
+      {
+         id     = entry;
+         entry += strlen(entry)+1;
+         if((found = CheckCandidate(st, seq, length, id, 
+                                    atol(entry) - offset)) 
+            != SERVE_NOVEL)
+         {
+            result = found;
+            st->hit.length = 0;
+            if(!AppendToSeqBuff(&(st->hit), id, strlen(id), FALSE))
+               result = SERVE_ERROR;
+            if(result != SERVE_CONTAINS)
+               break;
+         }
+      }
+      free(gdbm_list.dptr);
+   }
+
+   if(result != SERVE_NOVEL)
+      *hit = st->hit.data;
+   return(result);
+}
+
+
+/************************************************************************/
+/*>int CheckCandidate(SERVESTATE *st, char *seq, long length, char *id,
+                      long diag)
+   --------------------------------------------------------------------
+   Input:     SERVESTATE *st     The thread's state
+              char       *seq    Query sequence
+              long       length  Its length
+              char       *id     ID of a stored sequence sharing a seed
+              long       diag    Offset of the query in the stored 
+                                 sequence (negative if it starts
+                                 before it)
+   Returns:   int                SERVE_CONTAINED, SERVE_CONTAINS or
+                                 SERVE_NOVEL
+
+   Checks whether the query lies within the stored sequence, or the
+   stored sequence within the query, at the given diagonal. Each 
+   sequence and diagonal is only checked once for a query.
+
+   19.10.26 Original
+   19.10.26 Reads into the thread's candidate buffer
+*/
+int CheckCandidate(SERVESTATE *st, char *seq, long length, char *id,
+                   long diag)
+{
+   char  diagString[32],
+         *entry,
+         *stored;
+   datum gdbm_seq_seqid,
+         gdbm_seq_data;
+   long  offset,
+         storedLength,
+         nBytes;
+   int   result = SERVE_NOVEL;
+
+   /* The list of those checked holds diagonal/ID pairs                 */
+   sprintf(diagString, "%ld", diag);
+   for(entry = st->checked.data;
+       entry < st->checked.data + st->checked.length;
+       entry += strlen(entry)+1)
+   {
+      if(!strcmp(entry, diagString) && !strcmp(entry+strlen(entry)+1, id))
+         return(SERVE_NOVEL);
+      entry += strlen(entry)+1;
+   }
+   if(!AppendToSeqBuff(&(st->checked), diagString, strlen(diagString)+1,
+                       FALSE) ||
+      !AppendToSeqBuff(&(st->checked), id, strlen(id)+1, FALSE))
+      return(SERVE_NOVEL);
+
+   CREATEDATUM(gdbm_seq_seqid, id);
+   gdbm_seq_data = gdbm_fetch(st->seqdata, gdbm_seq_seqid);
+   if(gdbm_seq_data.dptr == NULL)
+      return(SERVE_NOVEL);
+   sscanf(gdbm_seq_data.dptr, "%*s %ld", &offset);
+   free(gdbm_seq_data.dptr);
+
+   if(st->fp->type != SEQFILE_PLAIN)
+      pthread_mutex_lock(&gSeqFileLock);
+   stored = ReadEntry(st->fp, offset, FALSE, &(st->candidate), &nBytes);
+   if(st->fp->type != SEQFILE_PLAIN)
+      pthread_mutex_unlock(&gSeqFileLock);
+   if(stored == NULL)
+      return(SERVE_NOVEL);
+
+   storedLength = st->candidate.length;
+   if((diag >= 0) && (diag + length <= storedLength) &&
+      !strncmp(stored+diag, seq, length))
+   {
+      result = SERVE_CONTAINED;
+   }
+   else if((diag <= 0) && (storedLength - diag <= length) &&
+           !strncmp(seq-diag, stored, storedLength))
+   {
+      result = SERVE_CONTAINS;
+   }
+   
+   return(result);
+}
+
+
+/************************************************************************/
+/*>BOOL SpoolStdin(char *filename)
+   -------------------------------
+   Input:     char   *filename    File to write
+   Returns:   BOOL                Success?
+
+   Copies standard input to a file
+
+   19.10.26 Original
+*/
+BOOL SpoolStdin(char *filename)
+{
+   FILE   *fp;
+   char   buffer[HUGEBUFF];
+   size_t n;
+   BOOL   retval = TRUE;
+
+   if((fp=fopen(filename,"w"))==NULL)
+      return(FALSE);
+
+   while((n = fread(buffer, 1, HUGEBUFF, stdin)) > 0)
+   {
+      if(fwrite(buffer, 1, n, fp) != n)
+      {
+         retval = FALSE;
+         break;
+      }
+   }
+   
+   if(fclose(fp))
+      retval = FALSE;
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>BOOL UpdateFromState(char *stateFile, char *removedFile, 
+                        int *fragSize, int *rejectSize)
+   ---------------------------------------------------------------
+   Input:     char   *stateFile    State written with -e by an earlier
+                                   run
+              char   *removedFile  IDs removed since then (empty if 
+                                   none)
+   Output:    int    *fragSize     Fragment size used by that run
+              int    *rejectSize   Reject size used by that run
+   Returns:   BOOL                 Success?
+
+   Starts an update of an earlier run. The supersede forest is rebuilt
+   from the state and the removed sequences are marked, breaking up the
+   families whose representative has gone. The state file is then read
+   twice: the representatives which still stand are loaded as already
+   non-redundant (as with -n), then the remaining members of the broken
+   families are made non-redundant against them, so the longest member
+   left in each is promoted. Superceeded members of the other families
+   are not loaded at all. The added files are then processed as usual.
+
+   As the members of broken families are read after the representatives,
+   one which lies within a representative is only found if the
+   representative's anchor lies within it too. ProbeRepresentatives()
+   therefore looks for the others from the representatives' side, so
+   the result is the same as a rebuild.
+
+   19.10.26 Original
+   19.10.26 Probes the representatives for the rechecked sequences
+*/
+BOOL UpdateFromState(char *stateFile, char *removedFile, int *fragSize,
+                     int *rejectSize)
+{
+   long nRecheck;
+   BOOL retval;
+
+   if(!ReadState(stateFile, fragSize, rejectSize) ||
+      (removedFile[0] && !ReadRemoved(removedFile)))
+      return(FALSE);
+
+   nRecheck = BreakRemovedFamilies();
+   if(gVerbose > 1)
+   {
+      fprintf(stderr,"TRACE: %ld sequences to be checked again\n",
+              nRecheck);
+   }
+
+   gUpdatePass = UPDATE_KEEP;
+   retval = NonRedundantise(stateFile, TRUE, *fragSize, *rejectSize);
+   if(retval && nRecheck)
+   {
+      gUpdatePass = UPDATE_RECHECK;
+      retval = NonRedundantise(stateFile, FALSE, *fragSize, *rejectSize);
+      if(retval)
+      {
+         gUpdatePass = UPDATE_PROBE;
+         retval = ProbeRepresentatives(*fragSize);
+      }
+      FreeExtraAnchors(&gRecheckAnchors);
+   }
+   gUpdatePass = UPDATE_ADDED;
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>BOOL ReadState(char *filename, int *fragSize, int *rejectSize)
+   --------------------------------------------------------------
+   Input:     char   *filename    State file written by WriteState()
+   Output:    int    *fragSize    Fragment size used by that run
+              int    *rejectSize  Reject size used by that run
+   Returns:   BOOL                Success?
+
+   Reads the settings and the edges from the start of a state file. The
+   settings which change the results (-f, -r, -k, -I and -D) are taken
+   from here rather than from the command line.
+
+   19.10.26 Original
+*/
+BOOL ReadState(char *filename, int *fragSize, int *rejectSize)
+{
+   SEQFILE *in;
+   char    *line,
+           *child,
+           *tab;
+   int     length,
+           version = 0,
+           dna     = 0;
+   BOOL    retval  = TRUE;
+
+   if((in=OpenSeqFile(filename))==NULL)
+   {
+      fprintf(stderr,"E004: Can't read %s\n", filename);
+      return(FALSE);
+   }
+
+   if(((line = SeqFileGetLine(in, &length)) == NULL) ||
+      strncmp(line, STATE_MAGIC, strlen(STATE_MAGIC)) ||
+      (sscanf(line+strlen(STATE_MAGIC), "%d %d %d %d %d %d", &version,
+              fragSize, rejectSize, &gMismatches, &gIDRule, &dna) != 6) ||
+      (version != STATE_VERSION))
+   {
+      fprintf(stderr,"E010: %s is not an nr state file\n", filename);
+      CloseSeqFile(in);
+      return(FALSE);
+   }
+   gDNA     = (dna ? TRUE : FALSE);
+   gUnknown = (gDNA ? 'N' : 'X');
+
+   /* The edges come before the first entry                             */
+   while(((line = SeqFileGetLine(in, &length)) != NULL) && 
+         (*line != '>'))
+   {
+      line[strcspn(line, "\r\n")] = '\0';
+      if(strncmp(line, STATE_EDGE, strlen(STATE_EDGE)))
+         continue;
+      if(((line  = strchr(line,    '\t')) == NULL) ||
+         ((child = strchr(line+1,  '\t')) == NULL))
+      {
+         fprintf(stderr,"E010: %s is not an nr state file\n", filename);
+         retval = FALSE;
+         break;
+      }
+      line++;
+      *(child++) = '\0';
+      if((tab = strchr(child, '\t')) != NULL)
+         *tab = '\0';
+      ForestAddEdge(line, child, NULL);
+   }
+
+   CloseSeqFile(in);
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>BOOL ReadRemoved(char *filename)
+   --------------------------------
+   Input:     char   *filename    File of IDs, one per line
+   Returns:   BOOL                Success?
+
+   Marks each sequence named in the file as removed. Only the first
+   word of each line is used and blank lines and lines starting with #
+   are skipped.
+
+   19.10.26 Original
+*/
+BOOL ReadRemoved(char *filename)
+{
+   SEQFILE *in;
+   char    *line;
+   int     length;
+
+   if((in=OpenSeqFile(filename))==NULL)
+   {
+      fprintf(stderr,"E004: Can't read %s\n", filename);
+      return(FALSE);
+   }
+
+   while((line = SeqFileGetLine(in, &length)) != NULL)
+   {
+      line += strspn(line, " \t");
+      line[strcspn(line, " \t\r\n")] = '\0';
+      if(*line && (*line != '#'))
+         ForestSetMark(ForestIndex(line, TRUE), MARK_REMOVED);
+   }
+
+   CloseSeqFile(in);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>long BreakRemovedFamilies(void)
+   -------------------------------
+   Returns:   long        Number of sequences to be checked again
+
+   Takes the removed sequences out of their families. Where it was the
+   representative that was removed, the rest of the family is taken
+   apart and each member is marked to be checked again. Every path is
+   compressed first, so cutting a member which was removed from the
+   middle of a family leaves the sequences below it in place.
+
+   19.10.26 Original
+*/
+long BreakRemovedFamilies(void)
+{
+   int  i,
+        root;
+   long nRecheck = 0;
+
+   for(i=0; i<ForestSize(); i++)
+      ForestRoot(i);
+
+   for(i=0; i<ForestSize(); i++)
+   {
+      root = ForestRoot(i);
+      if(ForestMark(i) == MARK_REMOVED)
+      {
+         if(root != i)
+            ForestCut(i);
+      }
+      else if(ForestMark(root) == MARK_REMOVED)
+      {
+         ForestCut(i);
+         ForestSetMark(i, MARK_RECHECK);
+         nRecheck++;
+      }
+   }
+
+   return(nRecheck);
+}
+
+
+/************************************************************************/
+/*>BOOL ProbeRepresentatives(int fragSize)
+   ---------------------------------------
+   Input:     int    fragSize     Fragment size
+   Returns:   BOOL                Success?
+
+   Runs the redundancy stage over every sequence loaded in an update
+   except those which were checked again, so that a rechecked sequence
+   lying within a standing representative is dropped even when the
+   representative's anchor is not inside it. The anchors (or seeds with
+   -k) of the rechecked sequences are swapped in as the extra anchors,
+   so only fragments matching one of them are looked up. The sequences
+   are keyed as a pseudo-file, '(recheck)' in the metrics.
+
+   19.10.26 Original
+*/
+BOOL ProbeRepresentatives(int fragSize)
+{
+   datum key,
+         next;
+   BOOL  retval;
+
+   if(gVerbose > 1)
+   {
+      fprintf(stderr,"TRACE: Probing representatives for %ld \
+anchors\n", gRecheckAnchors.n);
+   }
+   MetricsNewFile("(recheck)");
+
+   for(key=gdbm_firstkey(gDBF_seqdata); key.dptr!=NULL; key=next)
+   {
+      if(!IsRechecked(key.dptr))
+      {
+         fwrite(key.dptr, 1, strlen(key.dptr)+1, gKeys);
+         gKeysEnd += strlen(key.dptr)+1;
+         gNTempSeqs++;
+      }
+      next = gdbm_nextkey(gDBF_seqdata, key);
+      free(key.dptr);
+   }
+
+   SwapExtraAnchors(&gRecheckAnchors);
+   retval = DropRedundancies(fragSize);
+   SwapExtraAnchors(&gRecheckAnchors);
+
+   /* These were all merged already                                     */
+   rewind(gKeys);
+   gKeysEnd   = 0;
+   gNTempSeqs = 0;
+   
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>void AddRecheckAnchor(unsigned long hash)
+   -----------------------------------------
+   Input:     unsigned long hash  Hash of the anchor or seed of a
+                                  sequence being checked again
+
+   Adds to the set of anchors looked up by ProbeRepresentatives(). It
+   is kept as an extra anchor set which is swapped in for the moment.
+
+   19.10.26 Original
+*/
+void AddRecheckAnchor(unsigned long hash)
+{
+   SwapExtraAnchors(&gRecheckAnchors);
+   AddExtraAnchor(hash);
+   SwapExtraAnchors(&gRecheckAnchors);
+}
+
+
+/************************************************************************/
+/*>BOOL IsRechecked(char *seqid)
+   -----------------------------
+   Input:     char   *seqid     Sequence ID
+   Returns:   BOOL              Is it a member of a broken family being
+                                checked again in an update?
+
+   19.10.26 Original
+*/
+BOOL IsRechecked(char *seqid)
+{
+   int index;
+
+   index = ForestIndex(seqid, FALSE);
+   return((index >= 0) && (ForestMark(index) == MARK_RECHECK));
+}
+
+
+/************************************************************************/
+/*>BOOL InUpdate(char *key, char *file, long entryStart)
+   -----------------------------------------------------
+   Input:     char   *key         Sequence ID
+              char   *file        Filename
+              long   entryStart   Offset of the entry in the file
+   Returns:   BOOL                Should the sequence be stored in this
+                                  pass of an update?
+
+   While the state is read for the first pass, superceeded members of
+   families which stand are not stored but their place in the state
+   file is noted. While the added files are read, a sequence with the
+   ID of one of these is a duplicate. Always TRUE when not updating.
+
+   19.10.26 Original
+*/
+BOOL InUpdate(char *key, char *file, long entryStart)
+{
+   char locator[MAXBUFF+40];
+   int  index;
+
+   if(gUpdatePass == UPDATE_NONE)
+      return(TRUE);
+
+   index = ForestIndex(key, FALSE);
+   switch(gUpdatePass)
+   {
+   case UPDATE_KEEP:
+      if(index < 0)
+         return(TRUE);
+      if(ForestMark(index) != 0)
+         return(FALSE);
+      if(ForestRoot(index) != index)
+      {
+         if(gLocators)
+         {
+            sprintf(locator, "%s %ld", file, entryStart);
+            ForestSetLocator(index, locator);
+         }
+         return(FALSE);
+      }
+      return(TRUE);
+   case UPDATE_RECHECK:
+      return(IsRechecked(key));
+   default:
+      if((index >= 0) && (ForestRoot(index) != index))
+      {
+         fprintf(stderr,"W001: Duplicate ID: %s\n", key);
+         return(FALSE);
+      }
+      break;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteState(char *filename, int fragSize, int rejectSize)
+   -------------------------------------------------------------
+   Input:     char   *filename    File to write
+              int    fragSize     Fragment size
+              int    rejectSize   Reject size
+   Returns:   BOOL                Success?
+
+   Writes what a later run needs to update these results with -u: a
+   line giving the settings, a line giving the representative and ID
+   of each superceeded sequence, then the complete FASTA entry of every
+   sequence in the output followed by those of the sequences it 
+   superceeded. The file is written under a temporary name and then
+   renamed, so it may replace the state being updated.
+
+   19.10.26 Original
+*/
+BOOL WriteState(char *filename, int fragSize, int rejectSize)
+{
+   static SEQBUFF sEntry = {NULL, 0, 0, 0};
+   char  tmpName[MAXBUFF+8];
+   FILE  *fp;
+   datum gdbm_seq_seqid,
+         gdbm_seq_seqdata,
+         gdbm_member,
+         gdbm_next;
+   int   pass,
+         rep,
+         member;
+   BOOL  retval = TRUE;
+
+   sprintf(tmpName, "%s.tmp", filename);
+   if((fp=fopen(tmpName,"w"))==NULL)
+      return(FALSE);
+   fprintf(fp,"%s\t%d\t%d\t%d\t%d\t%d\t%d\n", STATE_MAGIC, STATE_VERSION,
+           fragSize, rejectSize, gMismatches, gIDRule, (gDNA?1:0));
+
+   /* The edges on the first pass, the entries on the second            */
+   for(pass=0; pass<2; pass++)
+   {
+      gdbm_seq_seqid = gdbm_firstkey(gDBF_seqdata);
+      while(gdbm_seq_seqid.dptr)
+      {
+         gdbm_seq_seqdata = gdbm_fetch(gDBF_seqdata, gdbm_seq_seqid);
+         if((gdbm_seq_seqdata.dptr != NULL) &&
+            !IsTombstone(SequenceIndex(gdbm_seq_seqdata)))
+         {
+            if(pass && !WriteStateEntry(fp, gdbm_seq_seqdata, &sEntry))
+               retval = FALSE;
+
+            /* Members without a locator can't be written              */
+            if(((rep = ForestIndex(gdbm_seq_seqid.dptr, FALSE)) >= 0) &&
+               ((member = ForestFirstMember(rep)) >= 0))
+            {
+               for(member=ForestNextMember(member); 
+                   member != (-1); 
+                   member=ForestNextMember(member))
+               {
+                  if((gdbm_member.dptr = ForestLocator(member)) == NULL)
+                     continue;
+                  gdbm_member.dsize = strlen(gdbm_member.dptr)+1;
+                  if(!pass)
+                  {
+                     fprintf(fp,"%s\t%s\t%s\n", STATE_EDGE, 
+                             gdbm_seq_seqid.dptr, ForestID(member));
+                  }
+                  else if(!WriteStateEntry(fp, gdbm_member, &sEntry))
+                  {
+                     retval = FALSE;
+                  }
+               }
+            }
+         }
+         if(gdbm_seq_seqdata.dptr)
+         {
+            free(gdbm_seq_seqdata.dptr);
+         }
+         gdbm_next = gdbm_nextkey(gDBF_seqdata,gdbm_seq_seqid);
+         free(gdbm_seq_seqid.dptr);
+         gdbm_seq_seqid = gdbm_next;
+      }
+   }
+
+   if(fclose(fp) || !retval || rename(tmpName, filename))
+   {
+      unlink(tmpName);
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteStateEntry(FILE *fp, datum content, SEQBUFF *sb)
+   ----------------------------------------------------------
+   Input:     FILE    *fp       State file
+              datum   content   Locator of the entry
+   I/O:       SEQBUFF *sb       Buffer to read the entry into
+   Returns:   BOOL              Success?
+
+   Copies a complete FASTA entry into the state, making sure that it
+   ends with a newline.
+
+   19.10.26 Original
+*/
+BOOL WriteStateEntry(FILE *fp, datum content, SEQBUFF *sb)
+{
+   char *entry;
+
+   if((entry = FetchSequence(content, TRUE, sb)) == NULL)
+      return(FALSE);
+   fputs(entry, fp);
+   if(sb->length && (entry[sb->length-1] != '\n'))
+      fputc('\n', fp);
+   return(!ferror(fp));
+}
+
+
+/************************************************************************/
+/*>int AutoFragSize(char **files, int nFiles, int fragSize, 
+                    int rejectSize)
+   ---------------------------------------------------------
+   Input:     char   **files      Input files
+              int    nFiles       Number of input files
+              int    fragSize     Fragment size to use if none can be
+                                  chosen
+              int    rejectSize   Reject sequences up to this length
+   Returns:   int                 Fragment size to use
+
+   Chooses the fragment size for -f auto from a sample of the input 
+   (see fragtune.c). Sizes are tried up to one less than the reject 
+   size, so every sequence kept has a fragment to store. What was found
+   is reported with the metrics.
+
+   19.10.26 Original
+*/
+int AutoFragSize(char **files, int nFiles, int fragSize, int rejectSize)
+{
+   FRAGTUNING sizes[TUNE_MAX_FRAGSIZE];
+   char       **seqs,
+              reason[TUNE_REASON];
+   long       nTotal  = 0;
+   int        nSeqs   = 0,
+              maxSize = rejectSize - 1,
+              nRedundant,
+              nTried,
+              chosen  = 0,
+              i;
+
+   if((seqs = (char **)malloc(TUNE_SAMPLE * sizeof(char *)))==NULL)
+   {
+      fprintf(stderr,"W005: Can't choose a fragment size. Using %d\n",
+              fragSize);
+      return(fragSize);
+   }
+
+   if(maxSize > TUNE_MAX_FRAGSIZE)
+      maxSize = TUNE_MAX_FRAGSIZE;
+
+   /* Share the sample between the files                                */
+   for(i=0; i<nFiles; i++)
+   {
+      nTotal += SampleFile(files[i], (TUNE_SAMPLE - nSeqs) / (nFiles - i),
+                           rejectSize, seqs, &nSeqs);
+   }
+
+   if(maxSize >= TUNE_MIN_FRAGSIZE)
+   {
+      chosen = TuneFragSize(seqs, nSeqs, nTotal, TUNE_MIN_FRAGSIZE, 
+                            maxSize, gWindow, gDNA, sizes, &nTried,
+                            &nRedundant, reason);
+   }
+
+   if(chosen)
+   {
+      MetricsFragTuning(sizes, nTried, chosen,
+                        nSeqs, nRedundant, nTotal, reason);
+      if(gVerbose)
+      {
+         fprintf(stderr,"INFO: Fragment size %d chosen (%s)\n",
+                 chosen, reason);
+      }
+      fragSize = chosen;
+   }
+   else
+   {
+      fprintf(stderr,"W005: Can't choose a fragment size. Using %d\n",
+              fragSize);
+   }
+
+   for(i=0; i<nSeqs; i++)
+      free(seqs[i]);
+   free(seqs);
+   return(fragSize);
+}
+
+
+/************************************************************************/
+/*>long SampleFile(char *file, int quota, int rejectSize, char **seqs,
+                   int *nSeqs)
+   -------------------------------------------------------------------
+   Input:     char   *file        Input file
+              int    quota        Most sequences to take from it
+              int    rejectSize   Reject sequences up to this length
+   I/O:       char   **seqs       Sampled sequences (added to)
+              int    *nSeqs       Number of sampled sequences
+   Returns:   long                Estimated number of sequences in the
+                                  file (0 if it can't be sampled)
+
+   Samples the sequences in a file for AutoFragSize(). A plain file is
+   read in TUNE_CHUNKS evenly spaced places, while a compressed one is
+   read from the start. Sequences which would be rejected or dropped
+   with W002 are not taken. The number of sequences in the file is 
+   estimated from the number of bytes (or compressed bytes) read. 
+   Standard input can't be read twice so isn't sampled.
+
+   19.10.26 Original
+*/
+long SampleFile(char *file, int quota, int rejectSize, char **seqs,
+                int *nSeqs)
+{
+   static SEQBUFF sSeq = {NULL, 0, 0, 0};
+   SEQFILE     *in;
+   struct stat st;
+   char        *line;
+   int         length,
+               chunk,
+               nChunks = TUNE_CHUNKS,
+               chunkTaken;
+   long        size,
+               start,
+               end,
+               lineStart,
+               used    = 0,
+               nRead   = 0;
+   BOOL        inEntry,
+               eof     = FALSE;
+
+   if(!strcmp(file, "-") || (quota < 1) || 
+      ((in = OpenSeqFile(file)) == NULL))
+      return(0);
+
+   /* Only a plain file can be read from anywhere                       */
+   if((size = SeqFileSize(in)) <= 0)
+   {
+      nChunks = 1;
+      size    = (stat(file, &st) ? 0 : (long)st.st_size);
+   }
+
+   for(chunk=0; (chunk<nChunks) && !eof; chunk++)
+   {
+      start = (chunk * (size / nChunks));
+      end   = ((nChunks == 1) ? LONG_MAX : ((chunk+1) * (size / nChunks)));
+      if((chunk && !SeqFileSeek(in, start)) || 
+         !AppendToSeqBuff(&sSeq, "", 0, FALSE))
+         break;
+
+      sSeq.length = sSeq.nX = 0;
+      inEntry     = FALSE;
+      chunkTaken  = 0;
+      for(;;)
+      {
+         /* Entries are taken from those starting before the end of the
+            chunk
+         */
+         lineStart = SeqFileTell(in);
+         if(((line = SeqFileGetLine(in, &length)) == NULL) || 
+            (*line == '>'))
+         {
+            if(inEntry)
+            {
+               nRead++;
+               if((sSeq.length >= rejectSize) && 
+                  !TooManyXs(sSeq.nX, sSeq.length) &&
+                  ((seqs[*nSeqs] = (char *)malloc(sSeq.length+1)) != NULL))
+               {
+                  strcpy(seqs[(*nSeqs)++], sSeq.data);
+                  chunkTaken++;
+               }
+            }
+            sSeq.length = sSeq.nX = 0;
+            eof         = (line == NULL);
+            inEntry     = !eof && (chunkTaken < quota / nChunks + 
+                                   ((chunk < quota % nChunks) ? 1 : 0));
+            if(!inEntry || (lineStart >= end))
+               break;
+         }
+         else if(inEntry && !AppendToSeqBuff(&sSeq, line, length, TRUE))
+         {
+            break;
+         }
+      }
+      used += ((nChunks == 1) ? (SeqFileTell(in) >> 16) : 
+                                (SeqFileTell(in) - start));
+   }
+
+   CloseSeqFile(in);
+
+   if(eof && (nChunks == 1))
+      return(nRead);
+   return((used > 0) ? (long)((double)nRead * size / used) : nRead);
 }
 
 
@@ -1440,19 +4958,82 @@ void Usage(void)
 of Reading.\n");
 
    fprintf(stderr,"\nUsage: nr [-v] [-o out.faa] [-n] [-f fragsize] \
-[-r size] [-d tmpdir] file1.faa [file2.faa ...]\n");
+[-r size] [-d tmpdir] [-s nshards]\n");
+   fprintf(stderr,"          [-m metrics.json] [-p] [-k mismatches] \
+[-i identity]\n");
+   fprintf(stderr,"          [-c clusters.tsv] [-a] [-b events.bin] \
+[-z threads]\n");
+   fprintf(stderr,"          [-w window] [-j jobs] [-I idrule] [-D] \
+file1.faa [file2.faa ...]\n");
+   fprintf(stderr,"       nr -u state [-x removed.ids] [-e state] \
+[other options] [added.faa ...]\n");
+   fprintf(stderr,"       nr [-S socket] [-t threads] [-f fragsize] \
+[-r size] [-d tmpdir] nr.faa\n");
    fprintf(stderr,"       -v  Verbose mode - Report superceeded \
 sequences\n");
    fprintf(stderr,"       -o  Specify output file (stdout if not \
 specified)\n");
    fprintf(stderr,"       -n  First sequence file is already \
 non-redundant\n");
-   fprintf(stderr,"       -f  Specify fragment size (default: %d)\n",
-DEFAULT_FRAGSIZE);
+   fprintf(stderr,"       -f  Specify fragment size (default: %d), or \
+auto to choose one from\n", DEFAULT_FRAGSIZE);
+   fprintf(stderr,"           a sample of the input\n");
    fprintf(stderr,"       -r  Reject sequences up to this length \
 (default: %d)\n", 2*DEFAULT_FRAGSIZE);
    fprintf(stderr,"       -d  Specify temporary directory \
 (default: %s)\n", DEFAULT_GDBM_DIR);
+   fprintf(stderr,"       -s  Split the work across this many worker \
+processes (default: 1)\n");
+   fprintf(stderr,"       -j  Process up to this many input files at \
+once, then reconcile\n");
+   fprintf(stderr,"           them (default: 1, may not be used with \
+-s)\n");
+   fprintf(stderr,"       -I  Rule for finding the identifier in each \
+header: ncbi, uniprot,\n");
+   fprintf(stderr,"           pdb or token (default: ncbi)\n");
+   fprintf(stderr,"       -S  Load the file and answer queries on this \
+socket until killed\n");
+   fprintf(stderr,"           (may not be used with -D, -k, -i, -s or \
+-j)\n");
+   fprintf(stderr,"       -t  Number of threads answering queries with \
+-S (default: %d)\n", DEFAULT_THREADS);
+   fprintf(stderr,"       -D  Sequences are DNA - either strand may \
+contain another (may not\n");
+   fprintf(stderr,"           be used with -k or -i)\n");
+   fprintf(stderr,"       -m  Write per-stage metrics to this file as \
+JSON\n");
+   fprintf(stderr,"       -p  Show progress, throughput and estimated \
+time to completion\n");
+   fprintf(stderr,"       -k  Also drop sequences contained in another \
+with up to this many\n");
+   fprintf(stderr,"           mismatches (default: 0)\n");
+   fprintf(stderr,"       -i  Cluster the results at this sequence \
+identity (e.g. 0.9 or 90)\n");
+   fprintf(stderr,"           keeping the longest sequence of each \
+cluster\n");
+   fprintf(stderr,"       -c  Write the members of each cluster to this \
+file as TSV\n");
+   fprintf(stderr,"       -a  Add the headers of the sequences each one \
+superceeded to its\n");
+   fprintf(stderr,"           header (NCBI nr style, separated by \
+Ctrl-A)\n");
+   fprintf(stderr,"       -b  Write a binary log of superceeded and \
+dropped sequences\n");
+   fprintf(stderr,"           to this file (decode with nrevents)\n");
+   fprintf(stderr,"       -z  Compress the output with bgzip format \
+using this many threads\n");
+   fprintf(stderr,"       -e  Save the state needed to update the results \
+later to this file\n");
+   fprintf(stderr,"       -u  Update the results saved in this state \
+file with the files\n");
+   fprintf(stderr,"           given (-e, -u may not be used with -n, -i, \
+-s, -j or -S)\n");
+   fprintf(stderr,"       -x  File of IDs removed since the state was \
+saved (with -u)\n");
+   fprintf(stderr,"       -w  Anchor sequences at minimizers over this \
+many fragments\n");
+   fprintf(stderr,"           (default: %d, 0 for the first free \
+fragment)\n", DEFAULT_WINDOW);
    
    fprintf(stderr,"\nTwo-pass sequence non-reduntantising program with \
 minimal memory usage.\n");
@@ -1462,6 +5043,9 @@ identical sequences. Thus\n");
 sequence will be\n");
    fprintf(stderr,"retained. In the overlapping region the sequences \
 must be identical.\n");
+   fprintf(stderr,"Input files may be compressed with bgzip (but not \
+plain gzip). A file\n");
+   fprintf(stderr,"given as - is read from standard input.\n");
 
    fprintf(stderr,"The hard-coded temporary directory %s is used for \
 storing the hash\n", DEFAULT_GDBM_DIR);
@@ -0,0 +1,260 @@
+/*************************************************************************
+
+   Program:    nrbench
+   File:       nrbench.c
+
+   Version:    V1.1
+   Date:       19.10.26
+   Function:   Run nr and record its resource usage
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Runs a command (normally nr) and appends one line of JSON to the
+   results file giving the label, the number of input sequences, the
+   wall-clock time, the user and system CPU time, the peak resident set
+   size and the exit status of the command.
+
+   If a metrics file is given (i.e. the file nr was asked to write with
+   -m), its contents are included in the results line.
+
+**************************************************************************
+
+   Usage:
+   ======
+   nrbench -o results.json [-l label] [-n nseq] [-m metrics.json]
+           command [args ...]
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.1  19.10.26 Added -m
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXBUFF 320
+
+/************************************************************************/
+/* Prototypes
+*/
+int main(int argc, char **argv);
+void Usage(void);
+double Seconds(struct timeval *tv);
+void CopyMetrics(FILE *out, char *filename);
+
+/************************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+   Main program
+
+   19.10.26 Original
+*/
+int main(int argc, char **argv)
+{
+   char           resfile[MAXBUFF],
+                  label[MAXBUFF],
+                  metrics[MAXBUFF];
+   long           nSeq = 0;
+   pid_t          pid;
+   int            status;
+   struct timeval start,
+                  stop;
+   struct rusage  usage;
+   FILE           *fp;
+
+   resfile[0] = label[0] = metrics[0] = '\0';
+   for(argc--, argv++; argc && argv[0][0]=='-'; argc--, argv++)
+   {
+      if(argc < 2)
+      {
+         Usage();
+         return(1);
+      }
+
+      switch(argv[0][1])
+      {
+      case 'o':
+         strncpy(resfile, argv[1], MAXBUFF);
+         resfile[MAXBUFF-1] = '\0';
+         break;
+      case 'l':
+         strncpy(label, argv[1], MAXBUFF);
+         label[MAXBUFF-1] = '\0';
+         break;
+      case 'n':
+         nSeq = atol(argv[1]);
+         break;
+      case 'm':
+         strncpy(metrics, argv[1], MAXBUFF);
+         metrics[MAXBUFF-1] = '\0';
+         unlink(metrics);
+         break;
+      default:
+         Usage();
+         return(1);
+      }
+      argc--;
+      argv++;
+   }
+
+   if(!argc || !resfile[0])
+   {
+      Usage();
+      return(1);
+   }
+
+   gettimeofday(&start, NULL);
+   if((pid = fork()) == 0)
+   {
+      execvp(argv[0], argv);
+      fprintf(stderr,"Can't run %s\n", argv[0]);
+      _exit(127);
+   }
+   else if(pid == (-1))
+   {
+      fprintf(stderr,"Can't fork\n");
+      return(1);
+   }
+
+   waitpid(pid, &status, 0);
+   gettimeofday(&stop, NULL);
+
+   /* Only one child has run, so its peak RSS is the children's peak    */
+   getrusage(RUSAGE_CHILDREN, &usage);
+
+   if((fp=fopen(resfile,"a"))==NULL)
+   {
+      fprintf(stderr,"Can't write %s\n", resfile);
+      return(1);
+   }
+
+   fprintf(fp,"{\"label\": \"%s\", \"nseq\": %ld, \"wall_s\": %.3f, \
+\"user_s\": %.3f, \"sys_s\": %.3f, \"max_rss_kb\": %ld, \"exit\": %d",
+           label, nSeq,
+           Seconds(&stop) - Seconds(&start),
+           Seconds(&(usage.ru_utime)),
+           Seconds(&(usage.ru_stime)),
+           (long)usage.ru_maxrss,
+           WIFEXITED(status)?WEXITSTATUS(status):(-1));
+   if(metrics[0])
+   {
+      CopyMetrics(fp, metrics);
+   }
+   fprintf(fp,"}\n");
+   fclose(fp);
+
+   return(WIFEXITED(status)?WEXITSTATUS(status):1);
+}
+
+
+/************************************************************************/
+/*>double Seconds(struct timeval *tv)
+   ----------------------------------
+   Input:     struct timeval *tv    A time
+   Returns:   double                The time in seconds
+
+   19.10.26 Original
+*/
+double Seconds(struct timeval *tv)
+{
+   return((double)tv->tv_sec + ((double)tv->tv_usec / 1000000.0));
+}
+
+
+/************************************************************************/
+/*>void CopyMetrics(FILE *out, char *filename)
+   -------------------------------------------
+   Input:     FILE   *out        Results file pointer
+              char   *filename   Metrics file written by nr
+
+   Adds the contents of the metrics file to the current results line
+   as the value of "metrics", with newlines removed so that the results
+   stay one line per run.
+
+   19.10.26 Original
+*/
+void CopyMetrics(FILE *out, char *filename)
+{
+   FILE *in;
+   int  ch;
+
+   if((in=fopen(filename,"r"))==NULL)
+      return;
+
+   fprintf(out,", \"metrics\": ");
+   while((ch=fgetc(in))!=EOF)
+   {
+      if(ch != '\n')
+         fputc(ch, out);
+   }
+   fclose(in);
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+   Write a usage message
+
+   19.10.26 Original
+*/
+void Usage(void)
+{
+   fprintf(stderr,"\nnrbench V1.0 (c) 2000 Dr. Andrew C.R. Martin, \
+University of Reading.\n");
+   fprintf(stderr,"\nUsage: nrbench -o results.json [-l label] [-n nseq] \
+[-m metrics.json]\n");
+   fprintf(stderr,"               command [args ...]\n");
+   fprintf(stderr,"       -o  Results file (appended to)\n");
+   fprintf(stderr,"       -l  Label for this run\n");
+   fprintf(stderr,"       -n  Number of input sequences\n");
+   fprintf(stderr,"       -m  Metrics file written by the command to \
+include in the results\n");
+   fprintf(stderr,"\nRuns the command and appends a line of JSON giving \
+the wall time, CPU\n");
+   fprintf(stderr,"time, peak resident set size and exit status to the \
+results file.\n\n");
+}
@@ -0,0 +1,281 @@
+/*************************************************************************
+
+   Program:    nrevents
+   File:       nrevents.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Decode an nr binary event log
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Decodes the binary event log written by nr -b into text. By default
+   each event is written as a tab-separated line giving the stage, the
+   reason, the parent ID (- if none) and the child ID. With -v, the
+   events with a parent are written in the same form as the messages
+   from nr -v instead so they may be fed to findequiv.pl.
+
+**************************************************************************
+
+   Usage:
+   ======
+   nrevents [-v] events.bin [events.bin.0 ...]
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bioplib/SysDefs.h"
+#include "eventlog.h"
+#include "metrics.h"
+
+/************************************************************************/
+/* Prototypes
+*/
+int main(int argc, char **argv);
+void Usage(void);
+BOOL DecodeEvents(char *filename, BOOL infoFormat);
+char **ReadIDs(FILE *fp, long start, long end, unsigned long nIDs,
+               char **idBuffer);
+
+/************************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+   Main program
+
+   19.10.26 Original
+*/
+int main(int argc, char **argv)
+{
+   BOOL infoFormat = FALSE;
+   int  retval     = 0;
+
+   for(argc--, argv++; argc && argv[0][0]=='-'; argc--, argv++)
+   {
+      switch(argv[0][1])
+      {
+      case 'v':
+         infoFormat = TRUE;
+         break;
+      default:
+         Usage();
+         return(1);
+      }
+   }
+
+   if(!argc)
+   {
+      Usage();
+      return(1);
+   }
+
+   for(; argc; argc--, argv++)
+   {
+      if(!DecodeEvents(argv[0], infoFormat))
+         retval = 1;
+   }
+
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>BOOL DecodeEvents(char *filename, BOOL infoFormat)
+   --------------------------------------------------
+   Input:     char   *filename    Event log
+              BOOL   infoFormat   Write as nr -v messages
+   Returns:   BOOL                Success?
+
+   19.10.26 Original
+*/
+BOOL DecodeEvents(char *filename, BOOL infoFormat)
+{
+   FILE          *fp;
+   unsigned char header[EVENT_HEADER_SIZE],
+                 trailer[EVENT_TRAILER_SIZE],
+                 record[EVENT_RECORD_SIZE];
+   unsigned long nRecords,
+                 nIDs,
+                 i,
+                 parent,
+                 child;
+   long          end;
+   char          **ids,
+                 *idBuffer = NULL,
+                 *stage;
+
+   if((fp=fopen(filename,"rb"))==NULL)
+   {
+      fprintf(stderr,"Can't read %s\n", filename);
+      return(FALSE);
+   }
+
+   /* Check the header and read the counts from the trailer             */
+   if((fread(header, EVENT_HEADER_SIZE, 1, fp) != 1)            ||
+      memcmp(header, EVENT_MAGIC, 8)                            ||
+      (GetU32(header+8)  != EVENT_VERSION)                      ||
+      (GetU32(header+12) != EVENT_RECORD_SIZE)                  ||
+      fseek(fp, -EVENT_TRAILER_SIZE, SEEK_END)                  ||
+      ((end = ftell(fp)) < 0)                                   ||
+      (fread(trailer, EVENT_TRAILER_SIZE, 1, fp) != 1)          ||
+      memcmp(trailer+8, EVENT_TRAILER, 8))
+   {
+      fprintf(stderr,"%s is not a complete nr event log\n", filename);
+      fclose(fp);
+      return(FALSE);
+   }
+   nRecords = GetU32(trailer);
+   nIDs     = GetU32(trailer+4);
+
+   if((ids = ReadIDs(fp, EVENT_HEADER_SIZE + 
+                     (long)nRecords * EVENT_RECORD_SIZE,
+                     end, nIDs, &idBuffer)) == NULL)
+   {
+      fprintf(stderr,"Can't read the IDs from %s\n", filename);
+      fclose(fp);
+      return(FALSE);
+   }
+
+   fseek(fp, EVENT_HEADER_SIZE, SEEK_SET);
+   for(i=0; i<nRecords; i++)
+   {
+      if(fread(record, EVENT_RECORD_SIZE, 1, fp) != 1)
+         break;
+      parent = GetU32(record);
+      child  = GetU32(record+4);
+      if((child >= nIDs) || 
+         ((parent != EVENT_NO_PARENT) && (parent >= nIDs)))
+         break;
+
+      if(infoFormat)
+      {
+         if(parent != EVENT_NO_PARENT)
+            printf("INFO: %s superceeds %s\n", ids[parent], ids[child]);
+      }
+      else
+      {
+         stage = MetricsStageName(record[9]);
+         printf("%s\t%s\t%s\t%s\n",
+                (stage != NULL)?stage:"-",
+                EventReasonName(record[8]),
+                (parent != EVENT_NO_PARENT)?ids[parent]:"-",
+                ids[child]);
+      }
+   }
+
+   free(ids);
+   free(idBuffer);
+   fclose(fp);
+
+   if(i < nRecords)
+   {
+      fprintf(stderr,"%s is corrupt at record %lu\n", filename, i);
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>char **ReadIDs(FILE *fp, long start, long end, unsigned long nIDs,
+                  char **idBuffer)
+   ------------------------------------------------------------------
+   Input:     FILE          *fp        Event log
+              long          start      Offset of the ID table
+              long          end        Offset of the trailer
+              unsigned long nIDs       Number of IDs
+   Output:    char          **idBuffer The IDs (to be freed)
+   Returns:   char          **         Array of pointers to each ID
+                                       (to be freed; NULL on error)
+
+   19.10.26 Original
+*/
+char **ReadIDs(FILE *fp, long start, long end, unsigned long nIDs,
+               char **idBuffer)
+{
+   char          **ids,
+                 *ptr;
+   unsigned long i;
+   long          size = end - start;
+
+   if((size < 0) || fseek(fp, start, SEEK_SET))
+      return(NULL);
+
+   if(((*idBuffer = (char *)malloc(size+1))==NULL) ||
+      ((ids = (char **)malloc((nIDs+1) * sizeof(char *)))==NULL))
+      return(NULL);
+
+   if(fread(*idBuffer, 1, size, fp) != (size_t)size)
+      return(NULL);
+   (*idBuffer)[size] = '\0';
+
+   for(i=0, ptr=*idBuffer; i<nIDs; i++)
+   {
+      if(ptr >= *idBuffer + size)
+         return(NULL);
+      ids[i] = ptr;
+      ptr += strlen(ptr) + 1;
+   }
+
+   return(ids);
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+   Write a usage message
+
+   19.10.26 Original
+*/
+void Usage(void)
+{
+   fprintf(stderr,"\nnrevents V1.0 (c) 2000 Dr. Andrew C.R. Martin, \
+University of Reading.\n");
+   fprintf(stderr,"\nUsage: nrevents [-v] events.bin [events.bin.0 \
+...]\n");
+   fprintf(stderr,"       -v  Write as nr -v messages for \
+findequiv.pl\n");
+   fprintf(stderr,"\nDecodes the binary event log written by nr -b. \
+Each event is written as\n");
+   fprintf(stderr,"a line giving the stage, reason, parent ID (- if \
+none) and child ID,\n");
+   fprintf(stderr,"separated by tabs.\n\n");
+}
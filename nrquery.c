@@ -0,0 +1,556 @@
+/*************************************************************************
+
+   Program:    nrquery
+   File:       nrquery.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Send queries to an nr server
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Sends the sequences from a FASTA file to a server started with
+   nr -S, in batches, and writes a tab-separated line for each giving
+   its ID (the first word of the header), the result (novel, contained,
+   contains, too_short or error) and the ID of the stored sequence
+   involved (- if none). With -s, the server's statistics are then
+   written as a line of JSON.
+
+**************************************************************************
+
+   Usage:
+   ======
+   nrquery [-b batch] [-s] socket [file.faa]
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "bioplib/SysDefs.h"
+#include "serve.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define DEFAULT_BATCH 1000
+#define MAXLINE       1024
+#define PUTU32(b, v)    ((b)[0] = (unsigned char)(((v) >> 24) & 0xff),   \
+                         (b)[1] = (unsigned char)(((v) >> 16) & 0xff),   \
+                         (b)[2] = (unsigned char)(((v) >> 8) & 0xff),    \
+                         (b)[3] = (unsigned char)((v) & 0xff))
+#define GETU32(b)       (((unsigned long)(b)[0] << 24) |                 \
+                         ((unsigned long)(b)[1] << 16) |                 \
+                         ((unsigned long)(b)[2] << 8)  |                 \
+                          (unsigned long)(b)[3])
+
+/************************************************************************/
+/* Globals
+*/
+static char *sResults[SERVE_NRESULTS] =
+{
+   "novel", "contained", "contains", "too_short", "error"
+};
+
+/************************************************************************/
+/* Prototypes
+*/
+int main(int argc, char **argv);
+void Usage(void);
+int Connect(char *path);
+BOOL QueryFile(int fd, FILE *fp, int batchSize);
+BOOL SendBatch(int fd, char **ids, char **seqs, int nSeqs);
+BOOL WriteStats(int fd);
+char *GetLine(FILE *fp, char **buffer, long *size);
+BOOL Append(char **buffer, long *length, long *size, char *text);
+BOOL ReadFull(int fd, void *buffer, long n);
+BOOL WriteFull(int fd, void *buffer, long n);
+
+
+/************************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+   Main program
+
+   19.10.26 Original
+*/
+int main(int argc, char **argv)
+{
+   int  batchSize = DEFAULT_BATCH,
+        fd;
+   BOOL stats     = FALSE,
+        ok        = TRUE;
+   FILE *fp       = stdin;
+
+   for(argc--, argv++; argc && argv[0][0]=='-'; argc--, argv++)
+   {
+      switch(argv[0][1])
+      {
+      case 'b':
+         if((argc < 2) || !sscanf(argv[1],"%d",&batchSize) ||
+            (batchSize < 1) || (batchSize > SERVE_MAXBATCH))
+         {
+            Usage();
+            return(1);
+         }
+         argc--;
+         argv++;
+         break;
+      case 's':
+         stats = TRUE;
+         break;
+      default:
+         Usage();
+         return(1);
+      }
+   }
+
+   if((argc < 1) || (argc > 2))
+   {
+      Usage();
+      return(1);
+   }
+
+   if((fd = Connect(argv[0])) < 0)
+   {
+      fprintf(stderr,"Can't connect to %s\n", argv[0]);
+      return(1);
+   }
+
+   /* Just the statistics if -s is given without a file                 */
+   if((argc == 2) || !stats)
+   {
+      if((argc == 2) && strcmp(argv[1], "-") &&
+         ((fp=fopen(argv[1],"r"))==NULL))
+      {
+         fprintf(stderr,"Can't read %s\n", argv[1]);
+         return(1);
+      }
+      ok = QueryFile(fd, fp, batchSize);
+      if(fp != stdin)
+         fclose(fp);
+   }
+
+   if(ok && stats)
+      ok = WriteStats(fd);
+   close(fd);
+
+   if(!ok)
+   {
+      fprintf(stderr,"Lost connection to %s\n", argv[0]);
+      return(1);
+   }
+   return(0);
+}
+
+
+/************************************************************************/
+/*>int Connect(char *path)
+   -----------------------
+   Input:     char   *path      Server's socket
+   Returns:   int               Connection (-1 on failure)
+
+   19.10.26 Original
+*/
+int Connect(char *path)
+{
+   struct sockaddr_un addr;
+   int                fd;
+
+   if(strlen(path) >= sizeof(addr.sun_path))
+      return(-1);
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, path);
+
+   if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+      return(-1);
+   if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+   {
+      close(fd);
+      return(-1);
+   }
+   return(fd);
+}
+
+
+/************************************************************************/
+/*>BOOL QueryFile(int fd, FILE *fp, int batchSize)
+   -----------------------------------------------
+   Input:     int    fd         Connection
+              FILE   *fp        FASTA file
+              int    batchSize  Sequences sent in each request
+   Returns:   BOOL              Success?
+
+   Reads the sequences and sends them in batches
+
+   19.10.26 Original
+*/
+BOOL QueryFile(int fd, FILE *fp, int batchSize)
+{
+   char **ids,
+        **seqs,
+        *line,
+        *buffer = NULL;
+   long size    = 0,
+        length  = 0,
+        seqSize = 0;
+   int  nSeqs   = 0,
+        i;
+   BOOL ok      = TRUE;
+
+   if(((ids  = (char **)calloc(batchSize, sizeof(char *)))==NULL) ||
+      ((seqs = (char **)calloc(batchSize, sizeof(char *)))==NULL))
+   {
+      fprintf(stderr,"No memory for queries\n");
+      return(FALSE);
+   }
+
+   for(;;)
+   {
+      line = GetLine(fp, &buffer, &size);
+      if((line == NULL) || (line[0] == '>'))
+      {
+         /* Finish the previous sequence and send a full batch          */
+         if(nSeqs && (seqs[nSeqs-1] == NULL) &&
+            !Append(&(seqs[nSeqs-1]), &length, &seqSize, ""))
+            ok = FALSE;
+         if(ok && ((nSeqs == batchSize) || ((line == NULL) && nSeqs)))
+         {
+            ok = SendBatch(fd, ids, seqs, nSeqs);
+            for(i=0; i<nSeqs; i++)
+            {
+               free(ids[i]);
+               free(seqs[i]);
+               ids[i] = seqs[i] = NULL;
+            }
+            nSeqs = 0;
+         }
+         if(!ok || (line == NULL))
+            break;
+
+         /* Start the next one                                          */
+         line++;
+         line[strcspn(line, " \t\r")] = '\0';
+         if((ids[nSeqs] = (char *)malloc(strlen(line)+1))==NULL)
+         {
+            ok = FALSE;
+            break;
+         }
+         strcpy(ids[nSeqs++], line);
+         length = seqSize = 0;
+      }
+      else if(nSeqs)
+      {
+         line[strcspn(line, " \t\r")] = '\0';
+         if(!Append(&(seqs[nSeqs-1]), &length, &seqSize, line))
+         {
+            ok = FALSE;
+            break;
+         }
+      }
+   }
+
+   for(i=0; i<nSeqs; i++)
+   {
+      free(ids[i]);
+      if(seqs[i] != NULL) free(seqs[i]);
+   }
+   free(ids);
+   free(seqs);
+   if(buffer != NULL) free(buffer);
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>BOOL SendBatch(int fd, char **ids, char **seqs, int nSeqs)
+   ----------------------------------------------------------
+   Input:     int    fd         Connection
+              char   **ids      IDs of the sequences
+              char   **seqs     The sequences
+              int    nSeqs      Number of sequences
+   Returns:   BOOL              Success?
+
+   Sends one request and writes a line for each result
+
+   19.10.26 Original
+*/
+BOOL SendBatch(int fd, char **ids, char **seqs, int nSeqs)
+{
+   unsigned char *request,
+                 *ptr,
+                 header[5];
+   unsigned long nResults,
+                 length;
+   long          total = 5;
+   char          *hit  = NULL;
+   int           i;
+   BOOL          ok    = TRUE;
+
+   for(i=0; i<nSeqs; i++)
+      total += 4 + strlen(seqs[i]);
+   if((request = (unsigned char *)malloc(total))==NULL)
+      return(FALSE);
+
+   request[0] = SERVE_QUERY;
+   PUTU32(request+1, (unsigned long)nSeqs);
+   for(i=0, ptr=request+5; i<nSeqs; i++)
+   {
+      length = strlen(seqs[i]);
+      PUTU32(ptr, length);
+      memcpy(ptr+4, seqs[i], length);
+      ptr += 4 + length;
+   }
+   ok = WriteFull(fd, request, total);
+   free(request);
+
+   if(!ok || !ReadFull(fd, header, 4) ||
+      ((nResults = GETU32(header)) != (unsigned long)nSeqs))
+      return(FALSE);
+
+   for(i=0; ok && (i<nSeqs); i++)
+   {
+      if(!ReadFull(fd, header, 5) ||
+         (header[0] >= SERVE_NRESULTS) ||
+         ((hit = (char *)malloc(GETU32(header+1)+1))==NULL) ||
+         !ReadFull(fd, hit, GETU32(header+1)))
+      {
+         ok = FALSE;
+      }
+      else
+      {
+         hit[GETU32(header+1)] = '\0';
+         printf("%s\t%s\t%s\n", ids[i], sResults[header[0]],
+                (hit[0] ? hit : "-"));
+      }
+      if(hit != NULL)
+      {
+         free(hit);
+         hit = NULL;
+      }
+   }
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteStats(int fd)
+   -----------------------
+   Input:     int    fd         Connection
+   Returns:   BOOL              Success?
+
+   Asks the server for its statistics and writes them out
+
+   19.10.26 Original
+*/
+BOOL WriteStats(int fd)
+{
+   unsigned char header[4];
+   char          *stats;
+   unsigned long length;
+   BOOL          ok;
+
+   header[0] = SERVE_STATS;
+   if(!WriteFull(fd, header, 1) || !ReadFull(fd, header, 4))
+      return(FALSE);
+   length = GETU32(header);
+   if((stats = (char *)malloc(length+1))==NULL)
+      return(FALSE);
+   if((ok = ReadFull(fd, stats, length)))
+   {
+      stats[length] = '\0';
+      fputs(stats, stdout);
+   }
+   free(stats);
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>char *GetLine(FILE *fp, char **buffer, long *size)
+   --------------------------------------------------
+   Input:     FILE   *fp        File to read
+   I/O:       char   **buffer   Buffer for the line (grown to fit)
+              long   *size      Its size
+   Returns:   char   *          The line without its newline (NULL at
+                                the end of the file)
+
+   19.10.26 Original
+*/
+char *GetLine(FILE *fp, char **buffer, long *size)
+{
+   long length = 0;
+   char *newBuffer;
+
+   for(;;)
+   {
+      if(length + MAXLINE > *size)
+      {
+         if((newBuffer = (char *)realloc(*buffer, *size + MAXLINE))==NULL)
+            return(NULL);
+         *buffer = newBuffer;
+         *size  += MAXLINE;
+      }
+      if(fgets(*buffer + length, MAXLINE, fp) == NULL)
+         return(length ? *buffer : NULL);
+      length += strlen(*buffer + length);
+      if((*buffer)[length-1] == '\n')
+      {
+         (*buffer)[length-1] = '\0';
+         return(*buffer);
+      }
+   }
+}
+
+
+/************************************************************************/
+/*>BOOL Append(char **buffer, long *length, long *size, char *text)
+   ----------------------------------------------------------------
+   I/O:       char   **buffer   Buffer (allocated if NULL)
+              long   *length    Length of its contents
+              long   *size      Its size
+   Input:     char   *text      Text to add
+   Returns:   BOOL              Success?
+
+   Adds text to a buffer, doubling its size whenever it fills up
+
+   19.10.26 Original
+*/
+BOOL Append(char **buffer, long *length, long *size, char *text)
+{
+   long textLength = strlen(text),
+        newSize;
+   char *newBuffer;
+
+   if((*buffer == NULL) || (*length + textLength + 1 > *size))
+   {
+      for(newSize = (*size ? *size : MAXLINE);
+          newSize < *length + textLength + 1;
+          newSize *= 2);
+      if((newBuffer = (char *)realloc(*buffer, newSize))==NULL)
+         return(FALSE);
+      *buffer = newBuffer;
+      *size   = newSize;
+   }
+   strcpy(*buffer + *length, text);
+   *length += textLength;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL ReadFull(int fd, void *buffer, long n)
+   -------------------------------------------
+   Input:     int    fd         Connection
+              long   n          Number of bytes to read
+   Output:    void   *buffer    The bytes
+   Returns:   BOOL              Were they all read?
+
+   19.10.26 Original
+*/
+BOOL ReadFull(int fd, void *buffer, long n)
+{
+   char *ptr = (char *)buffer;
+   long nRead;
+
+   while(n > 0)
+   {
+      if((nRead = read(fd, ptr, n)) <= 0)
+         return(FALSE);
+      ptr += nRead;
+      n   -= nRead;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteFull(int fd, void *buffer, long n)
+   --------------------------------------------
+   Input:     int    fd         Connection
+              void   *buffer    Bytes to write
+              long   n          Number of bytes
+   Returns:   BOOL              Were they all written?
+
+   19.10.26 Original
+*/
+BOOL WriteFull(int fd, void *buffer, long n)
+{
+   char *ptr = (char *)buffer;
+   long nWritten;
+
+   while(n > 0)
+   {
+      if((nWritten = write(fd, ptr, n)) <= 0)
+         return(FALSE);
+      ptr += nWritten;
+      n   -= nWritten;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+   Write a usage message
+
+   19.10.26 Original
+*/
+void Usage(void)
+{
+   fprintf(stderr,"\nnrquery V1.0 (c) 2000 Dr. Andrew C.R. Martin, \
+University of Reading.\n");
+   fprintf(stderr,"\nUsage: nrquery [-b batch] [-s] socket \
+[file.faa]\n");
+   fprintf(stderr,"       -b  Sequences sent in each request \
+(default: %d)\n", DEFAULT_BATCH);
+   fprintf(stderr,"       -s  Write the server's statistics (just \
+these if no file is given)\n");
+   fprintf(stderr,"\nSends the sequences in the file (or standard \
+input) to a server started\n");
+   fprintf(stderr,"with nr -S and writes the ID of each, the result \
+and the ID of the stored\n");
+   fprintf(stderr,"sequence involved, separated by tabs.\n\n");
+}
@@ -0,0 +1,475 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       outfile.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Output file with optional parallel BGZF compression
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Writes the output of nr either as plain text or compressed in BGZF
+   format (as written by bgzip, see seqfile.c) so that it can be read
+   by zcat and used as input to nr without being decompressed.
+
+   The data are split into chunks of BGZF_BLOCK_DATA bytes, each of
+   which is compressed independently into one block. With more than
+   one thread, the full chunks are handed to a pool of compressor
+   threads, so several are compressed at once, while the calling thread
+   goes on filling the next. There are OUTFILE_CHUNKS chunks per thread
+   in a ring. Before a chunk is reused, the calling thread waits for it
+   to be compressed and writes it out, so the blocks are written in the
+   order the data were given.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "outfile.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define CHUNK_EMPTY     0
+#define CHUNK_FULL      1        /* Waiting for a thread to compress it */
+#define CHUNK_BUSY      2        /* Being compressed                    */
+#define CHUNK_DONE      3        /* Compressed, waiting to be written   */
+
+#define BGZF_HEADER     18       /* gzip header with the BC field       */
+#define BGZF_TRAILER    8        /* CRC32 and uncompressed size         */
+#define PUTU16(b, v)    ((b)[0] = (unsigned char)((v) & 0xff),           \
+                         (b)[1] = (unsigned char)(((v) >> 8) & 0xff))
+#define PUTU32(b, v)    (PUTU16((b), (v) & 0xffff),                      \
+                         PUTU16((b)+2, ((v) >> 16) & 0xffff))
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL CompressChunk(OUTCHUNK *chunk);
+static BOOL WriteChunk(OUTFILE *of, OUTCHUNK *chunk);
+static BOOL NextChunk(OUTFILE *of);
+static void *CompressThread(void *arg);
+static void FreeOutFile(OUTFILE *of);
+
+
+/************************************************************************/
+/*>OUTFILE *OpenOutFile(FILE *fp, int nThreads)
+   --------------------------------------------
+   Input:     FILE    *fp         Open file to write to
+              int     nThreads    0: Write plain text
+                                  1: Compress without extra threads
+                                  >1: Compress using this many threads
+   Returns:   OUTFILE *           Output file (NULL if no memory)
+
+   19.10.26 Original
+*/
+OUTFILE *OpenOutFile(FILE *fp, int nThreads)
+{
+   OUTFILE *of;
+   int     i;
+
+   if((of = (OUTFILE *)calloc(1, sizeof(OUTFILE)))==NULL)
+      return(NULL);
+   of->fp       = fp;
+   of->nThreads = nThreads;
+   if(nThreads == 0)
+      return(of);
+
+   /* A single thread needs just the one chunk                          */
+   of->nChunks = (nThreads > 1) ? (nThreads * OUTFILE_CHUNKS) : 1;
+   if((of->chunks = (OUTCHUNK *)calloc(of->nChunks, sizeof(OUTCHUNK)))
+      ==NULL)
+   {
+      free(of);
+      return(NULL);
+   }
+   for(i=0; i<of->nChunks; i++)
+   {
+      if(((of->chunks[i].data  = (unsigned char *)malloc(BGZF_BLOCK_DATA))
+          ==NULL) ||
+         ((of->chunks[i].block = (unsigned char *)malloc(BGZF_MAX_BLOCK))
+          ==NULL))
+      {
+         FreeOutFile(of);
+         return(NULL);
+      }
+   }
+
+   if(nThreads > 1)
+   {
+      if((of->threads = (pthread_t *)malloc(nThreads * sizeof(pthread_t)))
+         ==NULL)
+      {
+         FreeOutFile(of);
+         return(NULL);
+      }
+      pthread_mutex_init(&(of->lock), NULL);
+      pthread_cond_init(&(of->work), NULL);
+      pthread_cond_init(&(of->done), NULL);
+      for(i=0; i<nThreads; i++)
+      {
+         if(pthread_create(&(of->threads[i]), NULL, CompressThread, 
+                           (void *)of))
+         {
+            /* Stop any we started and compress without threads        */
+            pthread_mutex_lock(&(of->lock));
+            of->quit = TRUE;
+            pthread_cond_broadcast(&(of->work));
+            pthread_mutex_unlock(&(of->lock));
+            while(--i >= 0)
+               pthread_join(of->threads[i], NULL);
+            of->nThreads = 1;
+            break;
+         }
+      }
+   }
+
+   return(of);
+}
+
+
+/************************************************************************/
+/*>BOOL OutWrite(OUTFILE *of, char *data, int length)
+   --------------------------------------------------
+   Input:     OUTFILE *of         Output file
+              char    *data       Data to write
+              int     length      Number of bytes to write
+   Returns:   BOOL                Success?
+
+   19.10.26 Original
+*/
+BOOL OutWrite(OUTFILE *of, char *data, int length)
+{
+   OUTCHUNK *chunk;
+   int      n;
+
+   if(of->nThreads == 0)
+      return(fwrite(data, 1, length, of->fp) == length);
+   
+   while(length > 0)
+   {
+      chunk = &(of->chunks[of->current]);
+      n = BGZF_BLOCK_DATA - chunk->length;
+      if(n > length)
+         n = length;
+      memcpy(chunk->data + chunk->length, data, n);
+      chunk->length += n;
+      data          += n;
+      length        -= n;
+
+      if((chunk->length == BGZF_BLOCK_DATA) && !NextChunk(of))
+         return(FALSE);
+   }
+   return(!of->error);
+}
+
+
+/************************************************************************/
+/*>BOOL CloseOutFile(OUTFILE *of)
+   ------------------------------
+   Input:     OUTFILE *of         Output file
+   Returns:   BOOL                Success?
+
+   Compresses and writes any remaining data followed by the empty block
+   which marks the end of a BGZF file, then stops the threads and frees
+   the output file. The FILE itself is not closed.
+
+   19.10.26 Original
+*/
+BOOL CloseOutFile(OUTFILE *of)
+{
+   OUTCHUNK *chunk;
+   BOOL     retval;
+   int      i;
+
+   if(of->nThreads > 0)
+   {
+      if(of->chunks[of->current].length)
+         NextChunk(of);
+
+      if(of->nThreads > 1)
+      {
+         /* Write the chunks still in the ring, oldest first            */
+         pthread_mutex_lock(&(of->lock));
+         for(i=0; i<of->nChunks; i++)
+         {
+            chunk = &(of->chunks[(of->current + i) % of->nChunks]);
+            while((chunk->state == CHUNK_FULL) || 
+                  (chunk->state == CHUNK_BUSY))
+               pthread_cond_wait(&(of->done), &(of->lock));
+            if(chunk->state == CHUNK_DONE)
+            {
+               WriteChunk(of, chunk);
+               chunk->state = CHUNK_EMPTY;
+            }
+         }
+
+         of->quit = TRUE;
+         pthread_cond_broadcast(&(of->work));
+         pthread_mutex_unlock(&(of->lock));
+         for(i=0; i<of->nThreads; i++)
+            pthread_join(of->threads[i], NULL);
+      }
+
+      /* The end-of-file marker is an empty block                       */
+      chunk = &(of->chunks[0]);
+      chunk->length = 0;
+      if(!CompressChunk(chunk) || !WriteChunk(of, chunk))
+         of->error = TRUE;
+   }
+
+   retval = !of->error && !fflush(of->fp);
+   FreeOutFile(of);
+   
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>static void FreeOutFile(OUTFILE *of)
+   ------------------------------------
+   Input:     OUTFILE *of         Output file
+
+   Frees the memory used by an output file
+
+   19.10.26 Original
+*/
+static void FreeOutFile(OUTFILE *of)
+{
+   int i;
+
+   if(of->chunks != NULL)
+   {
+      for(i=0; i<of->nChunks; i++)
+      {
+         if(of->chunks[i].data  != NULL) free(of->chunks[i].data);
+         if(of->chunks[i].block != NULL) free(of->chunks[i].block);
+      }
+      free(of->chunks);
+   }
+   if(of->threads != NULL)
+   {
+      pthread_mutex_destroy(&(of->lock));
+      pthread_cond_destroy(&(of->work));
+      pthread_cond_destroy(&(of->done));
+      free(of->threads);
+   }
+   free(of);
+}
+
+
+/************************************************************************/
+/*>static BOOL NextChunk(OUTFILE *of)
+   ----------------------------------
+   Input:     OUTFILE *of         Output file
+   Returns:   BOOL                Success?
+
+   Passes the current chunk on for compression and moves on to the next
+   chunk in the ring, waiting for it to be compressed and writing it 
+   out if it is still in use. Without threads, the chunk is simply 
+   compressed and written.
+
+   19.10.26 Original
+*/
+static BOOL NextChunk(OUTFILE *of)
+{
+   OUTCHUNK *chunk = &(of->chunks[of->current]);
+
+   if(of->nThreads == 1)
+   {
+      if(!CompressChunk(chunk) || !WriteChunk(of, chunk))
+         of->error = TRUE;
+      return(!of->error);
+   }
+
+   pthread_mutex_lock(&(of->lock));
+   chunk->state = CHUNK_FULL;
+   pthread_cond_signal(&(of->work));
+
+   of->current = (of->current + 1) % of->nChunks;
+   chunk = &(of->chunks[of->current]);
+   while((chunk->state == CHUNK_FULL) || (chunk->state == CHUNK_BUSY))
+      pthread_cond_wait(&(of->done), &(of->lock));
+   pthread_mutex_unlock(&(of->lock));
+
+   /* No thread touches a chunk once it is done                         */
+   if(chunk->state == CHUNK_DONE)
+   {
+      WriteChunk(of, chunk);
+      pthread_mutex_lock(&(of->lock));
+      chunk->state = CHUNK_EMPTY;
+      pthread_mutex_unlock(&(of->lock));
+   }
+   return(!of->error);
+}
+
+
+/************************************************************************/
+/*>static BOOL WriteChunk(OUTFILE *of, OUTCHUNK *chunk)
+   ----------------------------------------------------
+   Input:     OUTFILE  *of        Output file
+              OUTCHUNK *chunk     Compressed chunk
+   Returns:   BOOL                Success?
+
+   Writes out a compressed chunk and clears it for reuse. The caller
+   marks it as empty.
+
+   19.10.26 Original
+*/
+static BOOL WriteChunk(OUTFILE *of, OUTCHUNK *chunk)
+{
+   if((chunk->blockLength == 0) ||
+      (fwrite(chunk->block, 1, chunk->blockLength, of->fp) != 
+       chunk->blockLength))
+      of->error = TRUE;
+
+   chunk->length = chunk->blockLength = 0;
+   return(!of->error);
+}
+
+
+/************************************************************************/
+/*>static void *CompressThread(void *arg)
+   --------------------------------------
+   Input:     void    *arg        The OUTFILE
+   Returns:   void    *           NULL
+
+   Compressor thread. Takes full chunks from the ring and compresses 
+   them until told to finish.
+
+   19.10.26 Original
+*/
+static void *CompressThread(void *arg)
+{
+   OUTFILE  *of = (OUTFILE *)arg;
+   OUTCHUNK *chunk;
+   int      i;
+
+   pthread_mutex_lock(&(of->lock));
+   for(;;)
+   {
+      for(i=0, chunk=NULL; i<of->nChunks; i++)
+      {
+         if(of->chunks[i].state == CHUNK_FULL)
+         {
+            chunk = &(of->chunks[i]);
+            break;
+         }
+      }
+
+      if(chunk != NULL)
+      {
+         chunk->state = CHUNK_BUSY;
+         pthread_mutex_unlock(&(of->lock));
+         CompressChunk(chunk);
+         pthread_mutex_lock(&(of->lock));
+         chunk->state = CHUNK_DONE;
+         pthread_cond_broadcast(&(of->done));
+      }
+      else if(of->quit)
+      {
+         break;
+      }
+      else
+      {
+         pthread_cond_wait(&(of->work), &(of->lock));
+      }
+   }
+   pthread_mutex_unlock(&(of->lock));
+   
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static BOOL CompressChunk(OUTCHUNK *chunk)
+   ------------------------------------------
+   I/O:       OUTCHUNK *chunk     Chunk to compress into a BGZF block
+   Returns:   BOOL                Success?
+
+   On failure the block length is left as zero
+
+   19.10.26 Original
+*/
+static BOOL CompressChunk(OUTCHUNK *chunk)
+{
+   z_stream      zs;
+   unsigned char *block = chunk->block;
+   unsigned long crc;
+   int           ret,
+                 size;
+
+   chunk->blockLength = 0;
+   memset(&zs, 0, sizeof(z_stream));
+   if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
+      return(FALSE);
+   zs.next_in   = chunk->data;
+   zs.avail_in  = chunk->length;
+   zs.next_out  = block + BGZF_HEADER;
+   zs.avail_out = BGZF_MAX_BLOCK - BGZF_HEADER - BGZF_TRAILER;
+   ret = deflate(&zs, Z_FINISH);
+   deflateEnd(&zs);
+   if(ret != Z_STREAM_END)
+      return(FALSE);
+
+   /* gzip header with the BC field giving the block size - 1           */
+   size = BGZF_HEADER + (int)zs.total_out + BGZF_TRAILER;
+   memset(block, 0, BGZF_HEADER);
+   block[0]  = 0x1f;
+   block[1]  = 0x8b;
+   block[2]  = Z_DEFLATED;
+   block[3]  = 0x04;             /* FEXTRA                              */
+   block[9]  = 0xff;             /* Unknown OS                          */
+   PUTU16(block+10, 6);          /* XLEN                                */
+   block[12] = 'B';
+   block[13] = 'C';
+   PUTU16(block+14, 2);
+   PUTU16(block+16, size-1);
+
+   crc = crc32(0L, chunk->data, (unsigned int)chunk->length);
+   PUTU32(block+size-BGZF_TRAILER,   crc);
+   PUTU32(block+size-BGZF_TRAILER+4, (unsigned long)chunk->length);
+
+   chunk->blockLength = size;
+   return(TRUE);
+}
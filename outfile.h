@@ -0,0 +1,92 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       outfile.h
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Output file with optional parallel BGZF compression
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+#ifndef _NR_OUTFILE_H
+#define _NR_OUTFILE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "bioplib/SysDefs.h"
+#include "seqfile.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define BGZF_BLOCK_DATA  0xff00  /* Data compressed into each block     */
+#define OUTFILE_CHUNKS   2       /* Chunks in flight per thread         */
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct
+{
+   unsigned char *data,          /* Uncompressed data                   */
+                 *block;         /* Compressed BGZF block               */
+   int           length,         /* Length of data                      */
+                 blockLength,    /* Length of block                     */
+                 state;          /* CHUNK_EMPTY, CHUNK_FULL etc.        */
+}  OUTCHUNK;
+
+typedef struct
+{
+   FILE            *fp;
+   int             nThreads,     /* 0 for uncompressed output           */
+                   nChunks,
+                   current;      /* Chunk being filled                  */
+   BOOL            error,
+                   quit;         /* Tells the threads to finish         */
+   OUTCHUNK        *chunks;
+   pthread_t       *threads;
+   pthread_mutex_t lock;
+   pthread_cond_t  work,         /* A chunk is ready to compress        */
+                   done;         /* A chunk has been compressed         */
+}  OUTFILE;
+
+/************************************************************************/
+/* Prototypes
+*/
+OUTFILE *OpenOutFile(FILE *fp, int nThreads);
+BOOL    OutWrite(OUTFILE *of, char *data, int length);
+BOOL    CloseOutFile(OUTFILE *of);
+
+#endif
@@ -0,0 +1,971 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       seqfile.c
+
+   Version:    V1.4
+   Date:       19.10.26
+   Function:   Sequence file access with BGZF support
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Reads sequence files for nr either as plain text or as BGZF (the
+   block-compressed gzip format written by bgzip from htslib). A BGZF
+   file is a series of gzip members each holding at most 64kB of data,
+   with the compressed size of each member given in a 'BC' extra field,
+   so it is still a valid gzip file but any record can be reached by
+   seeking to the start of its block and decompressing that block
+   alone.
+
+   Offsets returned by SeqFileTell() and used by SeqFileSeek() are the
+   plain file offsets for text files. For BGZF files they are 'virtual
+   offsets' as used by htslib: the file offset of the compressed block
+   shifted up 16 bits, plus the offset within the decompressed block.
+   They are held in a long so this needs a 64-bit long for compressed
+   files over 32kB.
+
+   A single cache of the last SEQFILE_CACHE decompressed blocks is
+   shared by all open files so that fetching records which are close
+   together does not decompress the same block again. GetSeqFile()
+   keeps the files used for fetching records open (rather than opening
+   and closing them as the file changes) so that their cached blocks
+   are not lost.
+
+   Input which can't be read at random (i.e. from a pipe) is read with
+   OpenSeqStream(). Each line read is also added to the 'store', so
+   the records can be read back later by opening the pseudo-file
+   STREAM_NAME. The first STORE_MEMORY chunks of the store are kept in
+   memory and the rest is spilled to a temporary file (which is
+   unlinked as soon as it is created so it goes away when we exit).
+   Offsets in the store are simply its byte positions.
+
+   The cached blocks and the in-memory chunks of the store are kept
+   until we exit, so they are taken from an ARENA rather than being
+   allocated one at a time.
+
+   Text already in memory (given to the library by a program which
+   embeds it) is copied into a buffer with AddSeqBuffer() under a name
+   which is then opened like a file. Offsets are again byte positions.
+   FreeSeqBuffer() releases it when it is no longer needed.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.1  19.10.26 Added streams and the stream store
+   V1.2  19.10.26 SeqFileGetLine() replaces SeqFileGets() so lines may
+                  be any length
+   V1.3  19.10.26 Added memory buffers
+   V1.4  19.10.26 Cache blocks and store chunks come from an arena
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "seqfile.h"
+#include "arena.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define GZIP_ID1        0x1f
+#define GZIP_ID2        0x8b
+#define GZIP_FEXTRA     0x04
+#define BGZF_HEADER     12       /* Fixed part of the gzip header       */
+#define BGZF_TRAILER    8        /* CRC32 and uncompressed size         */
+#define GETU16(b)       ((unsigned int)(b)[0] | ((unsigned int)(b)[1]<<8))
+#define GETU32(b)       ((unsigned long)GETU16(b) |                      \
+                         ((unsigned long)GETU16((b)+2)<<16))
+
+/************************************************************************/
+/* Globals
+*/
+static BGZFBLOCK     sCache[SEQFILE_CACHE];
+static int           sNextSlot = 0;
+static unsigned char sCData[BGZF_MAX_BLOCK];   /* Compressed block      */
+static SEQFILE       *sOpen[SEQFILE_MAXOPEN];
+static int           sNextOpen = 0;
+
+static char          *sStore[STORE_MEMORY];    /* In-memory chunks      */
+static long          sStoreLength = 0;
+static FILE          *sSpill      = NULL;
+static char          sSpillFile[SEQFILE_MAXNAME];
+static SEQBUFFER     *sBuffers    = NULL;      /* Memory buffers        */
+static ARENA         sArena;                   /* Cache blocks and store
+                                                  chunks                */
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL LoadBlock(SEQFILE *sf, long offset);
+static BOOL InflateBlock(SEQFILE *sf, BGZFBLOCK *block, int size);
+static BOOL CheckBlock(SEQFILE *sf);
+static BOOL StoreAppend(char *data, int length);
+static int  StoreGetLine(SEQFILE *sf);
+static BOOL LineAppend(SEQFILE *sf, int n, char *data, int count);
+static BOOL GrowLine(SEQFILE *sf, int size);
+static int  GetsAppend(SEQFILE *sf, FILE *fp, int n);
+static int  BufferGetLine(SEQFILE *sf);
+
+
+/************************************************************************/
+/*>SEQFILE *OpenSeqFile(char *filename)
+   ------------------------------------
+   Input:     char    *filename   File to open
+   Returns:   SEQFILE *           Opened file (NULL on error)
+
+   Opens a sequence file, checking whether it is BGZF compressed. Other
+   gzip files are rejected since they cannot be read at random.
+
+   STREAM_NAME opens the store for reading and the name of a memory
+   buffer opens that buffer.
+
+   19.10.26 Original
+   19.10.26 Added the store
+   19.10.26 Added memory buffers
+*/
+SEQFILE *OpenSeqFile(char *filename)
+{
+   SEQFILE       *sf;
+   SEQBUFFER     *buffer;
+   unsigned char magic[2];
+
+   if((sf = (SEQFILE *)calloc(1, sizeof(SEQFILE)))==NULL)
+      return(NULL);
+
+   if(!strcmp(filename, STREAM_NAME))
+   {
+      strcpy(sf->name, STREAM_NAME);
+      sf->type = SEQFILE_STORE;
+      return(sf);
+   }
+
+   for(buffer=sBuffers; buffer!=NULL; buffer=buffer->next)
+   {
+      if(!strcmp(buffer->name, filename))
+      {
+         strcpy(sf->name, buffer->name);
+         sf->type   = SEQFILE_MEMORY;
+         sf->buffer = buffer;
+         return(sf);
+      }
+   }
+
+   if((sf->fp = fopen(filename, "r"))==NULL)
+   {
+      free(sf);
+      return(NULL);
+   }
+   strncpy(sf->name, filename, SEQFILE_MAXNAME);
+   sf->name[SEQFILE_MAXNAME-1] = '\0';
+
+   if((fread(magic, 1, 2, sf->fp) == 2) &&
+      (magic[0] == GZIP_ID1) && (magic[1] == GZIP_ID2))
+   {
+      sf->type = SEQFILE_BGZF;
+      if(!LoadBlock(sf, 0L))
+      {
+         fprintf(stderr,"E007: %s is compressed but not with bgzip\n",
+                 filename);
+         CloseSeqFile(sf);
+         return(NULL);
+      }
+   }
+   else
+   {
+      rewind(sf->fp);
+   }
+   
+   return(sf);
+}
+
+
+/************************************************************************/
+/*>void CloseSeqFile(SEQFILE *sf)
+   ------------------------------
+   Input:     SEQFILE *sf         File to close
+
+   Closes a sequence file and drops its blocks from the cache
+
+   19.10.26 Original
+*/
+void CloseSeqFile(SEQFILE *sf)
+{
+   int i;
+
+   if(sf == NULL)
+      return;
+   
+   for(i=0; i<SEQFILE_CACHE; i++)
+   {
+      if(sCache[i].owner == sf)
+         sCache[i].owner = NULL;
+   }
+   if((sf->fp != NULL) && (sf->fp != stdin))
+      fclose(sf->fp);
+   if(sf->line != NULL)
+      free(sf->line);
+   free(sf);
+}
+
+
+/************************************************************************/
+/*>SEQFILE *GetSeqFile(char *filename)
+   -----------------------------------
+   Input:     char    *filename   File wanted
+   Returns:   SEQFILE *           Opened file (NULL on error)
+
+   Returns the open SEQFILE for a file, opening it if it is not one of
+   the last SEQFILE_MAXOPEN used.
+
+   19.10.26 Original
+*/
+SEQFILE *GetSeqFile(char *filename)
+{
+   int i;
+
+   for(i=0; i<SEQFILE_MAXOPEN; i++)
+   {
+      if((sOpen[i] != NULL) && !strcmp(sOpen[i]->name, filename))
+         return(sOpen[i]);
+   }
+
+   CloseSeqFile(sOpen[sNextOpen]);
+   sOpen[sNextOpen] = OpenSeqFile(filename);
+   i = sNextOpen;
+   sNextOpen = (sNextOpen + 1) % SEQFILE_MAXOPEN;
+   
+   return(sOpen[i]);
+}
+
+
+/************************************************************************/
+/*>void CloseSeqFiles(void)
+   ------------------------
+   Closes all the files opened by GetSeqFile()
+
+   19.10.26 Original
+*/
+void CloseSeqFiles(void)
+{
+   int i;
+
+   for(i=0; i<SEQFILE_MAXOPEN; i++)
+   {
+      CloseSeqFile(sOpen[i]);
+      sOpen[i] = NULL;
+   }
+}
+
+/************************************************************************/
+/*>SEQFILE *OpenSeqStream(FILE *fp, char *spillFile)
+   --------------------------------------------------
+   Input:     FILE    *fp         Open input which can't be seeked
+              char    *spillFile  Temporary file for the store
+   Returns:   SEQFILE *           Stream (NULL if no memory)
+
+   Opens a stream. The lines read from it are added to the store and
+   can be read back at random by opening STREAM_NAME.
+
+   19.10.26 Original
+*/
+SEQFILE *OpenSeqStream(FILE *fp, char *spillFile)
+{
+   SEQFILE *sf;
+
+   if((sf = (SEQFILE *)calloc(1, sizeof(SEQFILE)))==NULL)
+      return(NULL);
+
+   sf->fp   = fp;
+   sf->type = SEQFILE_STREAM;
+   strcpy(sf->name, STREAM_NAME);
+   strncpy(sSpillFile, spillFile, SEQFILE_MAXNAME);
+   sSpillFile[SEQFILE_MAXNAME-1] = '\0';
+
+   return(sf);
+}
+
+
+/************************************************************************/
+/*>char *SeqFileGetLine(SEQFILE *sf, int *length)
+   ----------------------------------------------
+   Input:     SEQFILE *sf         File to read
+   Output:    int     *length     Length of the line (including any
+                                  newline)
+   Returns:   char    *           The line (NULL at end of file or if
+                                  there is no memory)
+
+   Reads the next line whatever its length. The line is held in a 
+   buffer belonging to the file, which grows as needed, so it is only
+   valid until the next call. Each chunk of a compressed block or of 
+   the store is searched for the newline with memchr() and copied in 
+   one go, so a line is only looked at once.
+
+   19.10.26 Original (replaces SeqFileGets())
+*/
+char *SeqFileGetLine(SEQFILE *sf, int *length)
+{
+   unsigned char *start,
+                 *end;
+   int           n = 0,
+                 count;
+
+   switch(sf->type)
+   {
+   case SEQFILE_PLAIN:
+      n = GetsAppend(sf, sf->fp, 0);
+      break;
+   case SEQFILE_STREAM:
+      if(((n = GetsAppend(sf, sf->fp, 0)) > 0) &&
+         !StoreAppend(sf->line, n))
+         return(NULL);
+      break;
+   case SEQFILE_STORE:
+      n = StoreGetLine(sf);
+      break;
+   case SEQFILE_MEMORY:
+      n = BufferGetLine(sf);
+      break;
+   default:
+      if(!CheckBlock(sf))
+         return(NULL);
+      for(;;)
+      {
+         /* Move on to the next block when this one is used up          */
+         if(sf->pos >= sf->block->length)
+         {
+            if(!LoadBlock(sf, sf->block->next))
+               break;
+            continue;
+         }
+
+         start = sf->block->data + sf->pos;
+         count = sf->block->length - sf->pos;
+         if((end = (unsigned char *)memchr(start, '\n', count)) != NULL)
+            count = (int)(end - start) + 1;
+         if(!LineAppend(sf, n, (char *)start, count))
+            return(NULL);
+         n       += count;
+         sf->pos += count;
+         if(end != NULL)
+            break;
+      }
+      break;
+   }
+
+   if(n <= 0)
+      return(NULL);
+   *length = n;
+   return(sf->line);
+}
+
+
+/************************************************************************/
+/*>long SeqFileTell(SEQFILE *sf)
+   -----------------------------
+   Input:     SEQFILE *sf         Sequence file
+   Returns:   long                Current offset
+
+   Equivalent of ftell() for a sequence file. For BGZF files this is
+   a virtual offset. At the end of a block, the start of the next block
+   is given so that it refers to the block holding the next record.
+   For a stream it is the offset in the store of the next line.
+
+   19.10.26 Original
+   19.10.26 Added streams and the store
+   19.10.26 Added memory buffers
+*/
+long SeqFileTell(SEQFILE *sf)
+{
+   switch(sf->type)
+   {
+   case SEQFILE_PLAIN:
+      return(ftell(sf->fp));
+   case SEQFILE_STREAM:
+      return(sStoreLength);
+   case SEQFILE_STORE:
+   case SEQFILE_MEMORY:
+      return(sf->offset);
+   }
+
+   if(!CheckBlock(sf))
+      return(-1L);
+   if(sf->pos >= sf->block->length)
+      return(sf->block->next << 16);
+   return((sf->block->offset << 16) | sf->pos);
+}
+
+
+/************************************************************************/
+/*>BOOL SeqFileSeek(SEQFILE *sf, long offset)
+   ------------------------------------------
+   Input:     SEQFILE *sf         Sequence file
+              long    offset      Offset from SeqFileTell()
+   Returns:   BOOL                Success?
+
+   Equivalent of fseek() from the start of a sequence file. Streams
+   can't be seeked.
+
+   19.10.26 Original
+   19.10.26 Added streams and the store
+   19.10.26 Added memory buffers
+*/
+BOOL SeqFileSeek(SEQFILE *sf, long offset)
+{
+   switch(sf->type)
+   {
+   case SEQFILE_PLAIN:
+      return(fseek(sf->fp, offset, SEEK_SET) == 0);
+   case SEQFILE_STREAM:
+      return(FALSE);
+   case SEQFILE_STORE:
+      sf->offset = offset;
+      return((offset >= 0) && (offset <= sStoreLength));
+   case SEQFILE_MEMORY:
+      sf->offset = offset;
+      return((offset >= 0) && (offset <= sf->buffer->length));
+   }
+
+   if(!LoadBlock(sf, offset >> 16))
+      return(FALSE);
+   sf->pos = (int)(offset & 0xFFFF);
+   return(sf->pos <= sf->block->length);
+}
+
+
+/************************************************************************/
+/*>long SeqFileSize(SEQFILE *sf)
+   -----------------------------
+   Input:     SEQFILE *sf         Sequence file
+   Returns:   long                Size of the data (0 if not known)
+
+   Gives the size of a plain file or memory buffer. The uncompressed
+   size of a BGZF file or a stream is not known without reading it all,
+   so 0 is returned.
+
+   19.10.26 Original
+   19.10.26 Added memory buffers
+*/
+long SeqFileSize(SEQFILE *sf)
+{
+   long here,
+        size = 0;
+
+   if(sf->type == SEQFILE_MEMORY)
+      return(sf->buffer->length);
+   if((sf->type == SEQFILE_PLAIN) && ((here = ftell(sf->fp)) >= 0) &&
+      !fseek(sf->fp, 0L, SEEK_END))
+   {
+      size = ftell(sf->fp);
+      fseek(sf->fp, here, SEEK_SET);
+   }
+   return(size);
+}
+
+
+/************************************************************************/
+/*>BOOL AddSeqBuffer(char *name, char *data, long length)
+   ------------------------------------------------------
+   Input:     char    *name       Name to open it by
+              char    *data       FASTA text
+              long    length      Number of bytes
+   Returns:   BOOL                Success? (FALSE if there is no memory
+                                  or the name is already used)
+
+   Keeps a copy of text held in memory so that it can be opened with
+   OpenSeqFile() (and GetSeqFile()) by name and read at random like a
+   file. The name should not be that of a real file.
+
+   19.10.26 Original
+*/
+BOOL AddSeqBuffer(char *name, char *data, long length)
+{
+   SEQBUFFER *buffer;
+
+   for(buffer=sBuffers; buffer!=NULL; buffer=buffer->next)
+   {
+      if(!strcmp(buffer->name, name))
+         return(FALSE);
+   }
+
+   if((buffer = (SEQBUFFER *)malloc(sizeof(SEQBUFFER)))==NULL)
+      return(FALSE);
+   if((buffer->data = (char *)malloc(length ? length : 1))==NULL)
+   {
+      free(buffer);
+      return(FALSE);
+   }
+   memcpy(buffer->data, data, length);
+   buffer->length = length;
+   strncpy(buffer->name, name, SEQFILE_MAXNAME);
+   buffer->name[SEQFILE_MAXNAME-1] = '\0';
+
+   buffer->next = sBuffers;
+   sBuffers     = buffer;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void FreeSeqBuffer(char *name)
+   ------------------------------
+   Input:     char    *name       Name given to AddSeqBuffer()
+
+   Frees a memory buffer, closing it first if GetSeqFile() has it open.
+   Any other SEQFILE reading it must already have been closed.
+
+   19.10.26 Original
+*/
+void FreeSeqBuffer(char *name)
+{
+   SEQBUFFER *buffer,
+             *prev = NULL;
+   int       i;
+
+   for(i=0; i<SEQFILE_MAXOPEN; i++)
+   {
+      if((sOpen[i] != NULL) && !strcmp(sOpen[i]->name, name))
+      {
+         CloseSeqFile(sOpen[i]);
+         sOpen[i] = NULL;
+      }
+   }
+
+   for(buffer=sBuffers; buffer!=NULL; prev=buffer, buffer=buffer->next)
+   {
+      if(!strcmp(buffer->name, name))
+      {
+         if(prev == NULL)
+            sBuffers   = buffer->next;
+         else
+            prev->next = buffer->next;
+         free(buffer->data);
+         free(buffer);
+         return;
+      }
+   }
+}
+
+
+/************************************************************************/
+/*>static BOOL LoadBlock(SEQFILE *sf, long offset)
+   -----------------------------------------------
+   Input:     SEQFILE *sf         BGZF file
+              long    offset      File offset of the block
+   Returns:   BOOL                Success? (FALSE at end of file)
+
+   Makes the block starting at the given file offset the current block,
+   reading and decompressing it unless it is already in the cache.
+
+   19.10.26 Original
+   19.10.26 Block data comes from the arena
+*/
+static BOOL LoadBlock(SEQFILE *sf, long offset)
+{
+   unsigned char header[BGZF_HEADER],
+                 *extra;
+   BGZFBLOCK     *block;
+   int           xlen,
+                 size = 0,
+                 i;
+
+   for(i=0; i<SEQFILE_CACHE; i++)
+   {
+      if((sCache[i].owner == sf) && (sCache[i].offset == offset))
+      {
+         sf->block       = &(sCache[i]);
+         sf->blockOffset = offset;
+         sf->pos         = 0;
+         return(TRUE);
+      }
+   }
+
+   /* Read the gzip header and find the block size in the BC field      */
+   if(fseek(sf->fp, offset, SEEK_SET) ||
+      (fread(header, 1, BGZF_HEADER, sf->fp) != BGZF_HEADER))
+      return(FALSE);
+   if((header[0] != GZIP_ID1) || (header[1] != GZIP_ID2) ||
+      !(header[3] & GZIP_FEXTRA))
+      return(FALSE);
+   
+   xlen = GETU16(header+10);
+   if(fread(sCData, 1, xlen, sf->fp) != xlen)
+      return(FALSE);
+   for(extra=sCData; extra+4 <= sCData+xlen; 
+       extra += 4 + GETU16(extra+2))
+   {
+      if((extra[0] == 'B') && (extra[1] == 'C') && 
+         (GETU16(extra+2) == 2))
+      {
+         size = GETU16(extra+4) + 1;
+         break;
+      }
+   }
+   if(size < BGZF_HEADER + xlen + BGZF_TRAILER)
+      return(FALSE);
+   
+   /* Replace the oldest block in the cache                             */
+   block = &(sCache[sNextSlot]);
+   sNextSlot = (sNextSlot + 1) % SEQFILE_CACHE;
+   block->owner = NULL;
+   if((block->data == NULL) &&
+      ((block->data = (unsigned char *)ArenaAlloc(&sArena, 
+                                                  BGZF_MAX_BLOCK))==NULL))
+      return(FALSE);
+
+   if(!InflateBlock(sf, block, size - BGZF_HEADER - xlen))
+   {
+      fprintf(stderr,"E008: Corrupt compressed block at offset %ld in \
+%s\n", offset, sf->name);
+      return(FALSE);
+   }
+
+   block->owner    = sf;
+   block->offset   = offset;
+   block->next     = offset + size;
+   sf->block       = block;
+   sf->blockOffset = offset;
+   sf->pos         = 0;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL InflateBlock(SEQFILE *sf, BGZFBLOCK *block, int size)
+   ------------------------------------------------------------------
+   Input:     SEQFILE   *sf       BGZF file positioned after the header
+              int       size      Size of the rest of the block
+   Output:    BGZFBLOCK *block    Decompressed data and length
+   Returns:   BOOL                Success?
+
+   Reads the compressed data and trailer of a block and decompresses
+   it, checking the length and CRC.
+
+   19.10.26 Original
+*/
+static BOOL InflateBlock(SEQFILE *sf, BGZFBLOCK *block, int size)
+{
+   z_stream      zs;
+   unsigned char *trailer = sCData + size - BGZF_TRAILER;
+   int           ret;
+
+   if(fread(sCData, 1, size, sf->fp) != size)
+      return(FALSE);
+
+   memset(&zs, 0, sizeof(z_stream));
+   if(inflateInit2(&zs, -15) != Z_OK)   /* Raw deflate data             */
+      return(FALSE);
+   zs.next_in   = sCData;
+   zs.avail_in  = size - BGZF_TRAILER;
+   zs.next_out  = block->data;
+   zs.avail_out = BGZF_MAX_BLOCK;
+   ret = inflate(&zs, Z_FINISH);
+   inflateEnd(&zs);
+
+   block->length = (int)zs.total_out;
+   return((ret == Z_STREAM_END) &&
+          (GETU32(trailer+4) == (unsigned long)block->length) &&
+          (GETU32(trailer) == 
+           crc32(0L, block->data, (unsigned int)block->length)));
+}
+
+
+/************************************************************************/
+/*>static BOOL CheckBlock(SEQFILE *sf)
+   -----------------------------------
+   Input:     SEQFILE *sf         BGZF file
+   Returns:   BOOL                Success?
+
+   Makes sure the current block of a file is still in the cache, since
+   reading other files may have replaced it, reading it again if not.
+
+   19.10.26 Original
+*/
+static BOOL CheckBlock(SEQFILE *sf)
+{
+   int pos = sf->pos;
+
+   if((sf->block->owner == sf) && (sf->block->offset == sf->blockOffset))
+      return(TRUE);
+
+   if(!LoadBlock(sf, sf->blockOffset))
+      return(FALSE);
+   sf->pos = pos;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL StoreAppend(char *data, int length)
+   -----------------------------------------------
+   Input:     char    *data       Data read from a stream
+              int     length      Number of bytes
+   Returns:   BOOL                Success?
+
+   Adds data to the end of the store, spilling to the temporary file
+   once the in-memory chunks are full.
+
+   19.10.26 Original
+   19.10.26 Chunks come from the arena
+*/
+static BOOL StoreAppend(char *data, int length)
+{
+   int chunk,
+       start,
+       n;
+
+   while(length > 0)
+   {
+      chunk = (int)(sStoreLength / STORE_CHUNK);
+      if(chunk < STORE_MEMORY)
+      {
+         if((sStore[chunk] == NULL) &&
+            ((sStore[chunk] = (char *)ArenaAlloc(&sArena, 
+                                                 STORE_CHUNK))==NULL))
+         {
+            fprintf(stderr,"E003: No memory for the input store\n");
+            return(FALSE);
+         }
+         start = (int)(sStoreLength % STORE_CHUNK);
+         n     = STORE_CHUNK - start;
+         if(n > length)
+            n = length;
+         memcpy(sStore[chunk]+start, data, n);
+      }
+      else
+      {
+         if(sSpill == NULL)
+         {
+            if((sSpill = fopen(sSpillFile, "w+"))==NULL)
+            {
+               fprintf(stderr,"E001: Can't write %s\n", sSpillFile);
+               return(FALSE);
+            }
+            unlink(sSpillFile);
+         }
+         n = length;
+         if(fseek(sSpill, 0L, SEEK_END) ||
+            (fwrite(data, 1, n, sSpill) != n))
+         {
+            fprintf(stderr,"E001: Can't write %s\n", sSpillFile);
+            return(FALSE);
+         }
+      }
+      
+      data         += n;
+      length       -= n;
+      sStoreLength += n;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static int StoreGetLine(SEQFILE *sf)
+   ------------------------------------
+   Input:     SEQFILE *sf         Store opened with OpenSeqFile()
+   Returns:   int                 Length of the line read into the line
+                                  buffer (0 at end of the store, -1 if
+                                  no memory)
+
+   Reads the next line from the store
+
+   19.10.26 Original (replaces StoreGets())
+*/
+static int StoreGetLine(SEQFILE *sf)
+{
+   long memLength = (long)STORE_MEMORY * STORE_CHUNK,
+        left;
+   int  n         = 0,
+        count;
+   char *start,
+        *end;
+
+   while(sf->offset < sStoreLength)
+   {
+      /* Read the rest of the line from the spill file                  */
+      if(sf->offset >= memLength)
+      {
+         if(!fseek(sSpill, sf->offset - memLength, SEEK_SET))
+         {
+            count = GetsAppend(sf, sSpill, n);
+            if(count < 0)
+               return(-1);
+            sf->offset += count - n;
+            n           = count;
+         }
+         break;
+      }
+
+      start = sStore[sf->offset / STORE_CHUNK] + 
+              (sf->offset % STORE_CHUNK);
+      count = STORE_CHUNK - (int)(sf->offset % STORE_CHUNK);
+      left  = sStoreLength - sf->offset;
+      if(left < count)
+         count = (int)left;
+      if((end = (char *)memchr(start, '\n', count)) != NULL)
+         count = (int)(end - start) + 1;
+      if(!LineAppend(sf, n, start, count))
+         return(-1);
+      n          += count;
+      sf->offset += count;
+      if(end != NULL)
+         break;
+   }
+
+   return(n);
+}
+
+
+/************************************************************************/
+/*>static BOOL LineAppend(SEQFILE *sf, int n, char *data, int count)
+   -----------------------------------------------------------------
+   Input:     SEQFILE *sf         File being read
+              int     n           Length of the line so far
+              char    *data       Data to add to the line
+              int     count       Number of bytes
+   Returns:   BOOL                Success?
+
+   Adds data to the end of the line being read, growing the line buffer
+   if needed. The line is kept NUL-terminated.
+
+   19.10.26 Original
+*/
+static BOOL LineAppend(SEQFILE *sf, int n, char *data, int count)
+{
+   if(!GrowLine(sf, n + count + 1))
+      return(FALSE);
+   memcpy(sf->line+n, data, count);
+   sf->line[n+count] = '\0';
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL GrowLine(SEQFILE *sf, int size)
+   ------------------------------------------
+   Input:     SEQFILE *sf         File being read
+              int     size        Space needed in the line buffer
+   Returns:   BOOL                Success?
+
+   Makes sure the line buffer holds at least size bytes. It is doubled
+   each time so a long line is still read in linear time.
+
+   19.10.26 Original
+*/
+static BOOL GrowLine(SEQFILE *sf, int size)
+{
+   char *line;
+   int  newSize;
+
+   if(size <= sf->lineSize)
+      return(TRUE);
+
+   for(newSize = (sf->lineSize ? sf->lineSize : SEQFILE_LINE);
+       newSize < size; 
+       newSize *= 2);
+   if((line = (char *)realloc(sf->line, newSize))==NULL)
+   {
+      fprintf(stderr,"E003: No memory for a line of %d bytes\n", size);
+      return(FALSE);
+   }
+   sf->line     = line;
+   sf->lineSize = newSize;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static int GetsAppend(SEQFILE *sf, FILE *fp, int n)
+   ---------------------------------------------------
+   Input:     SEQFILE *sf         File being read
+              FILE    *fp         File to read from
+              int     n           Length of the line so far
+   Returns:   int                 Length of the line (-1 if no memory)
+
+   Reads the rest of a line from a stdio file onto the end of the line 
+   buffer, calling fgets() again with a bigger buffer until the newline
+   is reached.
+
+   19.10.26 Original
+*/
+static int GetsAppend(SEQFILE *sf, FILE *fp, int n)
+{
+   do
+   {
+      if(!GrowLine(sf, n + SEQFILE_LINE))
+         return(-1);
+      if(fgets(sf->line+n, sf->lineSize-n, fp) == NULL)
+         break;
+      n += strlen(sf->line+n);
+   }  while(sf->line[n-1] != '\n');
+
+   return(n);
+}
+
+
+/************************************************************************/
+/*>static int BufferGetLine(SEQFILE *sf)
+   -------------------------------------
+   Input:     SEQFILE *sf         Memory buffer opened with OpenSeqFile()
+   Returns:   int                 Length of the line read into the line
+                                  buffer (0 at the end of the buffer, -1
+                                  if no memory)
+
+   Reads the next line from a memory buffer
+
+   19.10.26 Original
+*/
+static int BufferGetLine(SEQFILE *sf)
+{
+   char *start,
+        *end;
+   long count;
+
+   if(sf->offset >= sf->buffer->length)
+      return(0);
+
+   start = sf->buffer->data + sf->offset;
+   count = sf->buffer->length - sf->offset;
+   if((end = (char *)memchr(start, '\n', count)) != NULL)
+      count = (long)(end - start) + 1;
+   if(!LineAppend(sf, 0, start, (int)count))
+      return(-1);
+   sf->offset += count;
+
+   return((int)count);
+}
@@ -0,0 +1,122 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       seqfile.h
+
+   Version:    V1.4
+   Date:       19.10.26
+   Function:   Sequence file access with BGZF support
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.1  19.10.26 Added streams and the stream store
+   V1.2  19.10.26 SeqFileGetLine() replaces SeqFileGets()
+   V1.3  19.10.26 Added memory buffers
+   V1.4  19.10.26 Cache blocks and store chunks come from an arena
+
+*************************************************************************/
+#ifndef _NR_SEQFILE_H
+#define _NR_SEQFILE_H
+
+#include <stdio.h>
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define BGZF_MAX_BLOCK   65536   /* Maximum block size (both ways)      */
+#define SEQFILE_CACHE    256     /* Decompressed blocks kept (16MB)     */
+#define SEQFILE_MAXOPEN  16      /* Files kept open by GetSeqFile()     */
+#define SEQFILE_MAXNAME  320
+#define SEQFILE_LINE     1024    /* Initial size of the line buffer     */
+
+#define SEQFILE_PLAIN    0       /* Types of SEQFILE                    */
+#define SEQFILE_BGZF     1
+#define SEQFILE_STREAM   2       /* A pipe being copied to the store    */
+#define SEQFILE_STORE    3       /* Reads back from the store           */
+#define SEQFILE_MEMORY   4       /* A buffer added with AddSeqBuffer()  */
+
+#define STREAM_NAME      "@stdin"   /* Filename for the store           */
+#define STORE_CHUNK      1048576    /* Size of each in-memory chunk     */
+#define STORE_MEMORY     64         /* Chunks kept before spilling      */
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct _seqfile
+{
+   FILE          *fp;
+   int           type;           /* SEQFILE_PLAIN etc.                  */
+   struct _bgzfblock *block;     /* Current block (in the cache)        */
+   struct _seqbuffer *buffer;    /* Memory buffer being read            */
+   long          blockOffset,    /* File offset of the current block    */
+                 offset;         /* Read position in the store or buffer*/
+   int           pos,            /* Read position in the current block  */
+                 lineSize;       /* Size of the line buffer             */
+   char          *line;          /* Line read by SeqFileGetLine()       */
+   char          name[SEQFILE_MAXNAME];
+}  SEQFILE;
+
+typedef struct _bgzfblock
+{
+   SEQFILE       *owner;         /* File this block is from             */
+   long          offset,         /* File offset of the compressed block */
+                 next;           /* File offset of the following block  */
+   int           length;         /* Decompressed length                 */
+   unsigned char *data;          /* Decompressed data                   */
+}  BGZFBLOCK;
+
+typedef struct _seqbuffer
+{
+   char          *data;          /* Copy of the FASTA text              */
+   long          length;
+   char          name[SEQFILE_MAXNAME];
+   struct _seqbuffer *next;
+}  SEQBUFFER;
+
+/************************************************************************/
+/* Prototypes
+*/
+SEQFILE *OpenSeqFile(char *filename);
+void    CloseSeqFile(SEQFILE *sf);
+SEQFILE *GetSeqFile(char *filename);
+void    CloseSeqFiles(void);
+SEQFILE *OpenSeqStream(FILE *fp, char *spillFile);
+char    *SeqFileGetLine(SEQFILE *sf, int *length);
+long    SeqFileTell(SEQFILE *sf);
+BOOL    SeqFileSeek(SEQFILE *sf, long offset);
+long    SeqFileSize(SEQFILE *sf);
+BOOL    AddSeqBuffer(char *name, char *data, long length);
+void    FreeSeqBuffer(char *name);
+
+#endif
@@ -0,0 +1,636 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       serve.c
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Query server on a Unix domain socket
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Answers queries against a loaded set of sequences over a Unix domain
+   socket. The main thread accepts connections and queues them for a
+   pool of worker threads. A worker keeps a connection until the client
+   closes it, so a client wanting more than one thread to work on its
+   queries should open more than one connection.
+
+   Each worker has its own state, made by the open function given to
+   Serve(), which the query function uses to answer each query.
+
+   All numbers in the protocol are 4-byte unsigned integers, most
+   significant byte first. A request is a single byte giving its type:
+
+   'Q'  followed by the number of queries and then, for each query,
+        its length and its residues. The reply is the number of
+        queries and then, for each, a byte giving the result
+        (SERVE_NOVEL etc.), the length of the ID of the stored sequence
+        involved (0 if none) and the ID.
+   'S'  The reply is the length of a line of JSON followed by the line
+        giving the number of requests and queries answered, the counts
+        of each result and percentiles of the time taken to answer a
+        request, in microseconds.
+
+   The request times are kept in a histogram with 16 buckets for each
+   power of two, so the percentiles are correct to about 6%.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "serve.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXSTATS 1024
+#define PUTU32(b, v)    ((b)[0] = (unsigned char)(((v) >> 24) & 0xff),   \
+                         (b)[1] = (unsigned char)(((v) >> 16) & 0xff),   \
+                         (b)[2] = (unsigned char)(((v) >> 8) & 0xff),    \
+                         (b)[3] = (unsigned char)((v) & 0xff))
+#define GETU32(b)       (((unsigned long)(b)[0] << 24) |                 \
+                         ((unsigned long)(b)[1] << 16) |                 \
+                         ((unsigned long)(b)[2] << 8)  |                 \
+                          (unsigned long)(b)[3])
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct                   /* A growing buffer for a reply        */
+{
+   unsigned char *data;
+   long          length,
+                 size;
+}  REPLY;
+
+/************************************************************************/
+/* Prototypes
+*/
+static void *ServeThread(void *arg);
+static void HandleConnection(SERVER *sv, void *state, int fd);
+static BOOL HandleQueries(SERVER *sv, void *state, int fd, REPLY *reply);
+static BOOL SendStats(SERVER *sv, int fd);
+static BOOL ReadFull(int fd, void *buffer, long n);
+static BOOL WriteFull(int fd, void *buffer, long n);
+static BOOL ReadU32(int fd, unsigned long *value);
+static BOOL ReplyAppend(REPLY *reply, void *data, long n);
+static BOOL ReplyU32(REPLY *reply, unsigned long value);
+static double Now(void);
+static int LatencyBucket(unsigned long us);
+static unsigned long Percentile(SERVER *sv, double fraction);
+
+
+/************************************************************************/
+/*>BOOL Serve(char *path, int nThreads, SERVEOPENFN openFn,
+              SERVEQUERYFN queryFn)
+   --------------------------------------------------------
+   Input:     char         *path     Socket to create
+              int          nThreads  Number of worker threads
+              SERVEOPENFN  openFn    Makes the state for a worker
+              SERVEQUERYFN queryFn   Answers a query using that state
+   Returns:   BOOL                   FALSE if the server couldn't be
+                                     started (otherwise it runs until
+                                     the program is killed)
+
+   Creates the socket and the worker threads, then accepts connections
+   and passes them on to the workers.
+
+   19.10.26 Original
+*/
+BOOL Serve(char *path, int nThreads, SERVEOPENFN openFn,
+           SERVEQUERYFN queryFn)
+{
+   static SERVER      sv;
+   struct sockaddr_un addr;
+   pthread_t          thread;
+   int                fd,
+                      i,
+                      nStarted = 0;
+
+   if(strlen(path) >= sizeof(addr.sun_path))
+   {
+      fprintf(stderr,"E009: Socket name too long: %s\n", path);
+      return(FALSE);
+   }
+
+   memset(&sv, 0, sizeof(SERVER));
+   sv.open  = openFn;
+   sv.query = queryFn;
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, path);
+   unlink(path);
+   if(((sv.listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) ||
+      bind(sv.listener, (struct sockaddr *)&addr, sizeof(addr)) ||
+      listen(sv.listener, SERVE_QUEUE))
+   {
+      fprintf(stderr,"E009: Can't listen on socket %s\n", path);
+      return(FALSE);
+   }
+
+   /* A client going away must not kill the server                      */
+   signal(SIGPIPE, SIG_IGN);
+
+   pthread_mutex_init(&(sv.lock), NULL);
+   pthread_cond_init(&(sv.work), NULL);
+   pthread_cond_init(&(sv.space), NULL);
+   for(i=0; i<nThreads; i++)
+   {
+      if(!pthread_create(&thread, NULL, ServeThread, (void *)&sv))
+      {
+         pthread_detach(thread);
+         nStarted++;
+      }
+   }
+   if(!nStarted)
+   {
+      fprintf(stderr,"E009: Can't start server threads\n");
+      close(sv.listener);
+      unlink(path);
+      return(FALSE);
+   }
+
+   for(;;)
+   {
+      if((fd = accept(sv.listener, NULL, NULL)) < 0)
+         continue;
+
+      pthread_mutex_lock(&(sv.lock));
+      while(sv.count == SERVE_QUEUE)
+         pthread_cond_wait(&(sv.space), &(sv.lock));
+      sv.queue[(sv.head + sv.count) % SERVE_QUEUE] = fd;
+      sv.count++;
+      pthread_cond_signal(&(sv.work));
+      pthread_mutex_unlock(&(sv.lock));
+   }
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void *ServeThread(void *arg)
+   -----------------------------------
+   Input:     void    *arg        The SERVER
+   Returns:   void    *           NULL
+
+   Worker thread. Takes connections from the queue and answers the
+   requests on each until it is closed. Gives up if its state can't be
+   made. The state is never freed since the server runs until it is
+   killed.
+
+   19.10.26 Original
+*/
+static void *ServeThread(void *arg)
+{
+   SERVER *sv = (SERVER *)arg;
+   void   *state;
+   int    fd;
+
+   if((state = (*(sv->open))()) == NULL)
+      return(NULL);
+
+   for(;;)
+   {
+      pthread_mutex_lock(&(sv->lock));
+      while(sv->count == 0)
+         pthread_cond_wait(&(sv->work), &(sv->lock));
+      fd = sv->queue[sv->head];
+      sv->head = (sv->head + 1) % SERVE_QUEUE;
+      sv->count--;
+      pthread_cond_signal(&(sv->space));
+      pthread_mutex_unlock(&(sv->lock));
+
+      HandleConnection(sv, state, fd);
+      close(fd);
+   }
+
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static void HandleConnection(SERVER *sv, void *state, int fd)
+   -------------------------------------------------------------
+   Input:     SERVER  *sv         The server
+              void    *state      This thread's state
+              int     fd          Connection
+
+   Answers requests until the client closes the connection or sends
+   something which isn't a request.
+
+   19.10.26 Original
+*/
+static void HandleConnection(SERVER *sv, void *state, int fd)
+{
+   REPLY         reply;
+   unsigned char type;
+   BOOL          ok = TRUE;
+
+   reply.data = NULL;
+   reply.length = reply.size = 0;
+
+   while(ok && ReadFull(fd, &type, 1))
+   {
+      switch(type)
+      {
+      case SERVE_QUERY:
+         ok = HandleQueries(sv, state, fd, &reply);
+         break;
+      case SERVE_STATS:
+         ok = SendStats(sv, fd);
+         break;
+      default:
+         ok = FALSE;
+         break;
+      }
+   }
+
+   if(reply.data != NULL)
+      free(reply.data);
+}
+
+
+/************************************************************************/
+/*>static BOOL HandleQueries(SERVER *sv, void *state, int fd,
+                             REPLY *reply)
+   ---------------------------------------------------------
+   Input:     SERVER  *sv         The server
+              void    *state      This thread's state
+              int     fd          Connection
+   I/O:       REPLY   *reply      Buffer for the reply
+   Returns:   BOOL                Success?
+
+   Reads a batch of queries, answers each one and sends the reply. The
+   time from reading the first query to sending the reply is added to
+   the histogram.
+
+   19.10.26 Original
+*/
+static BOOL HandleQueries(SERVER *sv, void *state, int fd, REPLY *reply)
+{
+   static char   *sNoID = "";
+   unsigned long nQueries,
+                 length,
+                 i;
+   long          counts[SERVE_NRESULTS];
+   char          *seq   = NULL,
+                 *hit;
+   long          seqSize = 0;
+   int           result;
+   unsigned char resultByte;
+   double        start;
+   BOOL          ok = TRUE;
+
+   if(!ReadU32(fd, &nQueries) || (nQueries > SERVE_MAXBATCH))
+      return(FALSE);
+
+   start = Now();
+   reply->length = 0;
+   memset(counts, 0, sizeof(counts));
+   ok = ReplyU32(reply, nQueries);
+
+   for(i=0; ok && (i<nQueries); i++)
+   {
+      if(!ReadU32(fd, &length) || (length > SERVE_MAXSEQ))
+      {
+         ok = FALSE;
+         break;
+      }
+      if((long)length + 1 > seqSize)
+      {
+         if(seq != NULL)
+            free(seq);
+         seqSize = (long)length + 1;
+         if((seq = (char *)malloc(seqSize)) == NULL)
+         {
+            ok = FALSE;
+            break;
+         }
+      }
+      if(!ReadFull(fd, seq, (long)length))
+      {
+         ok = FALSE;
+         break;
+      }
+      seq[length] = '\0';
+
+      hit    = sNoID;
+      result = (*(sv->query))(state, seq, (long)length, &hit);
+      if((result < 0) || (result >= SERVE_NRESULTS))
+         result = SERVE_ERROR;
+      if(hit == NULL)
+         hit = sNoID;
+      counts[result]++;
+
+      resultByte = (unsigned char)result;
+      ok = ReplyAppend(reply, &resultByte, 1) &&
+           ReplyU32(reply, (unsigned long)strlen(hit)) &&
+           ReplyAppend(reply, hit, strlen(hit));
+   }
+   if(seq != NULL)
+      free(seq);
+
+   if(ok)
+      ok = WriteFull(fd, reply->data, reply->length);
+
+   if(ok)
+   {
+      pthread_mutex_lock(&(sv->lock));
+      sv->requests++;
+      sv->queries += nQueries;
+      for(result=0; result<SERVE_NRESULTS; result++)
+         sv->results[result] += counts[result];
+      sv->latency[LatencyBucket((unsigned long)
+                                ((Now() - start) * 1000000.0))]++;
+      pthread_mutex_unlock(&(sv->lock));
+   }
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>static BOOL SendStats(SERVER *sv, int fd)
+   -----------------------------------------
+   Input:     SERVER  *sv         The server
+              int     fd          Connection
+   Returns:   BOOL                Success?
+
+   Sends the statistics as a line of JSON
+
+   19.10.26 Original
+*/
+static BOOL SendStats(SERVER *sv, int fd)
+{
+   char          stats[MAXSTATS];
+   unsigned char header[4];
+   int           length;
+
+   pthread_mutex_lock(&(sv->lock));
+   sprintf(stats,"{\"requests\": %ld, \"queries\": %ld, \
+\"novel\": %ld, \"contained\": %ld, \"contains\": %ld, \
+\"too_short\": %ld, \"errors\": %ld, \"p50_us\": %lu, \"p90_us\": %lu, \
+\"p99_us\": %lu, \"p999_us\": %lu, \"max_us\": %lu}\n",
+           sv->requests, sv->queries,
+           sv->results[SERVE_NOVEL], sv->results[SERVE_CONTAINED],
+           sv->results[SERVE_CONTAINS], sv->results[SERVE_TOOSHORT],
+           sv->results[SERVE_ERROR],
+           Percentile(sv, 0.5), Percentile(sv, 0.9),
+           Percentile(sv, 0.99), Percentile(sv, 0.999),
+           Percentile(sv, 1.0));
+   pthread_mutex_unlock(&(sv->lock));
+
+   length = strlen(stats);
+   PUTU32(header, (unsigned long)length);
+   return(WriteFull(fd, header, 4) && WriteFull(fd, stats, length));
+}
+
+
+/************************************************************************/
+/*>static BOOL ReadFull(int fd, void *buffer, long n)
+   --------------------------------------------------
+   Input:     int     fd          Connection
+              long    n           Number of bytes to read
+   Output:    void    *buffer     The bytes
+   Returns:   BOOL                Were they all read?
+
+   19.10.26 Original
+*/
+static BOOL ReadFull(int fd, void *buffer, long n)
+{
+   char *ptr = (char *)buffer;
+   long nRead;
+
+   while(n > 0)
+   {
+      if((nRead = read(fd, ptr, n)) <= 0)
+         return(FALSE);
+      ptr += nRead;
+      n   -= nRead;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL WriteFull(int fd, void *buffer, long n)
+   ---------------------------------------------------
+   Input:     int     fd          Connection
+              void    *buffer     Bytes to write
+              long    n           Number of bytes
+   Returns:   BOOL                Were they all written?
+
+   19.10.26 Original
+*/
+static BOOL WriteFull(int fd, void *buffer, long n)
+{
+   char *ptr = (char *)buffer;
+   long nWritten;
+
+   while(n > 0)
+   {
+      if((nWritten = write(fd, ptr, n)) <= 0)
+         return(FALSE);
+      ptr += nWritten;
+      n   -= nWritten;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL ReadU32(int fd, unsigned long *value)
+   -------------------------------------------------
+   Input:     int           fd     Connection
+   Output:    unsigned long *value Number read
+   Returns:   BOOL                 Success?
+
+   19.10.26 Original
+*/
+static BOOL ReadU32(int fd, unsigned long *value)
+{
+   unsigned char buffer[4];
+
+   if(!ReadFull(fd, buffer, 4))
+      return(FALSE);
+   *value = GETU32(buffer);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL ReplyAppend(REPLY *reply, void *data, long n)
+   ---------------------------------------------------------
+   I/O:       REPLY   *reply      Reply being built
+   Input:     void    *data       Bytes to add
+              long    n           Number of bytes
+   Returns:   BOOL                Success?
+
+   Adds to a reply, doubling its size whenever it fills up. The buffer
+   is kept between requests.
+
+   19.10.26 Original
+*/
+static BOOL ReplyAppend(REPLY *reply, void *data, long n)
+{
+   unsigned char *newData;
+   long          size;
+
+   if(reply->length + n > reply->size)
+   {
+      for(size = (reply->size ? reply->size : MAXSTATS);
+          size < reply->length + n;
+          size *= 2);
+      if((newData = (unsigned char *)realloc(reply->data, size))==NULL)
+         return(FALSE);
+      reply->data = newData;
+      reply->size = size;
+   }
+   memcpy(reply->data + reply->length, data, n);
+   reply->length += n;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL ReplyU32(REPLY *reply, unsigned long value)
+   -------------------------------------------------------
+   I/O:       REPLY         *reply Reply being built
+   Input:     unsigned long value  Number to add
+   Returns:   BOOL                 Success?
+
+   19.10.26 Original
+*/
+static BOOL ReplyU32(REPLY *reply, unsigned long value)
+{
+   unsigned char buffer[4];
+
+   PUTU32(buffer, value);
+   return(ReplyAppend(reply, buffer, 4));
+}
+
+
+/************************************************************************/
+/*>static double Now(void)
+   -----------------------
+   Returns:   double              Current time in seconds
+
+   19.10.26 Original
+*/
+static double Now(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+   return((double)tv.tv_sec + ((double)tv.tv_usec / 1000000.0));
+}
+
+
+/************************************************************************/
+/*>static int LatencyBucket(unsigned long us)
+   ------------------------------------------
+   Input:     unsigned long us    A time in microseconds
+   Returns:   int                 Its bucket in the histogram
+
+   Times below 2^LATENCY_BITS have a bucket each. Above that, each 
+   power of two is split into 2^LATENCY_BITS buckets.
+
+   19.10.26 Original
+*/
+static int LatencyBucket(unsigned long us)
+{
+   int shift = 0,
+       bucket;
+
+   while((us >> shift) >= (2UL << LATENCY_BITS))
+      shift++;
+   if(shift == 0)
+      return((int)us);
+
+   bucket = ((shift + 1) << LATENCY_BITS) + 
+            (int)((us >> shift) - (1UL << LATENCY_BITS));
+   return((bucket < LATENCY_BUCKETS) ? bucket : (LATENCY_BUCKETS - 1));
+}
+
+
+/************************************************************************/
+/*>static unsigned long Percentile(SERVER *sv, double fraction)
+   ------------------------------------------------------------
+   Input:     SERVER  *sv         The server (locked)
+              double  fraction    e.g. 0.99 for the 99th percentile
+   Returns:   unsigned long       Request time (us) at that percentile
+
+   Gives the top of the bucket holding the request at the percentile.
+
+   19.10.26 Original
+*/
+static unsigned long Percentile(SERVER *sv, double fraction)
+{
+   long target,
+        seen = 0;
+   int  bucket,
+        shift;
+
+   if(sv->requests == 0)
+      return(0);
+   target = (long)(fraction * sv->requests + 0.5);
+   if(target < 1)
+      target = 1;
+
+   for(bucket=0; bucket<LATENCY_BUCKETS; bucket++)
+   {
+      if((seen += sv->latency[bucket]) >= target)
+         break;
+   }
+
+   if(bucket < (2 << LATENCY_BITS))
+      return((unsigned long)bucket);
+   shift = (bucket >> LATENCY_BITS) - 1;
+   return(((unsigned long)((bucket & ((1 << LATENCY_BITS) - 1)) +
+                           (1 << LATENCY_BITS) + 1) << shift) - 1);
+}
@@ -0,0 +1,101 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       serve.h
+
+   Version:    V1.0
+   Date:       19.10.26
+   Function:   Query server on a Unix domain socket
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+
+*************************************************************************/
+#ifndef _NR_SERVE_H
+#define _NR_SERVE_H
+
+#include <pthread.h>
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define SERVE_QUERY      'Q'     /* Request types                       */
+#define SERVE_STATS      'S'
+
+#define SERVE_NOVEL      0       /* Query results                       */
+#define SERVE_CONTAINED  1       /* Query is within a stored sequence   */
+#define SERVE_CONTAINS   2       /* Query contains a stored sequence    */
+#define SERVE_TOOSHORT   3       /* Query is too short to check         */
+#define SERVE_ERROR      4
+#define SERVE_NRESULTS   5
+
+#define SERVE_MAXBATCH   65536   /* Most queries in one request         */
+#define SERVE_MAXSEQ     (256*1048576L) /* Longest query                */
+#define SERVE_QUEUE      64      /* Connections waiting for a thread    */
+#define DEFAULT_THREADS  4
+
+#define LATENCY_BITS     4       /* 16 buckets per power of two         */
+#define LATENCY_BUCKETS  (64 << LATENCY_BITS)
+
+/************************************************************************/
+/* Structures
+*/
+typedef void *(*SERVEOPENFN)(void);
+typedef int  (*SERVEQUERYFN)(void *state, char *seq, long length,
+                             char **hit);
+
+typedef struct
+{
+   int             listener,     /* Listening socket                    */
+                   queue[SERVE_QUEUE], /* Accepted connections          */
+                   head,
+                   count;
+   SERVEOPENFN     open;         /* Makes the state for each thread     */
+   SERVEQUERYFN    query;        /* Answers one query                   */
+   pthread_mutex_t lock;
+   pthread_cond_t  work,         /* A connection is waiting             */
+                   space;        /* There is room in the queue          */
+   long            requests,     /* Statistics (under lock)             */
+                   queries,
+                   results[SERVE_NRESULTS],
+                   latency[LATENCY_BUCKETS]; /* Request times (us)      */
+}  SERVER;
+
+/************************************************************************/
+/* Prototypes
+*/
+BOOL Serve(char *path, int nThreads, SERVEOPENFN openFn,
+           SERVEQUERYFN queryFn);
+
+#endif
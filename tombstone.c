@@ -0,0 +1,223 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       tombstone.c
+
+   Version:    V1.2
+   Date:       19.10.26
+   Function:   Bitset of deleted sequences
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Each sequence read by nr is given a serial index which is stored
+   with its entry in the sequence hash. Deleting a sequence just sets
+   its bit in an in-memory bitset, so checking whether a sequence has
+   been deleted is a single bit test and the entries themselves can be
+   removed from the hashes later, when convenient.
+
+   Bits are set with an atomic OR where the compiler provides one, so
+   several threads may delete sequences at once provided the bitset has
+   already been grown to cover them.
+
+   SwapTombstones() exchanges the bitset in use with one kept in a
+   TOMBSTONES, so each library context can have its own.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.1  19.10.26 Added SwapTombstones() and FreeTombstones()
+   V1.2  19.10.26 The bitset comes from PageAlloc()
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tombstone.h"
+#include "arena.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define WORD_BITS    (8 * sizeof(unsigned long))
+#define INITIAL_SIZE 1024        /* Words                               */
+
+/* Set bits b in word w, leaving the old value of the word in old      */
+#ifdef __GNUC__
+#  define ATOMIC_OR(w, b, old) ((old) = __sync_fetch_and_or(&(w), (b)))
+#else
+#  define ATOMIC_OR(w, b, old) ((old) = (w), (w) |= (b))
+#endif
+
+/************************************************************************/
+/* Globals
+*/
+static unsigned long *sBits  = NULL;
+static long          sNWords = 0;
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL GrowBits(long nWords);
+
+
+/************************************************************************/
+/*>BOOL SetTombstone(long index)
+   -----------------------------
+   Input:     long   index     Index of a sequence
+   Returns:   BOOL             Was the sequence not already deleted?
+
+   Marks a sequence as deleted, growing the bitset if needed. Exits if
+   there is no memory.
+
+   19.10.26 Original
+*/
+BOOL SetTombstone(long index)
+{
+   unsigned long bit,
+                 old;
+   
+   if(index < 0)
+      return(FALSE);
+   
+   if((index / WORD_BITS) >= sNWords)
+   {
+      if(!GrowBits(index / WORD_BITS + 1))
+      {
+         fprintf(stderr,"E003: No memory for deleted sequences\n");
+         exit(1);
+      }
+   }
+   
+   bit = 1UL << (index % WORD_BITS);
+   ATOMIC_OR(sBits[index / WORD_BITS], bit, old);
+   return(!(old & bit));
+}
+
+
+/************************************************************************/
+/*>BOOL IsTombstone(long index)
+   ----------------------------
+   Input:     long   index     Index of a sequence
+   Returns:   BOOL             Has the sequence been deleted?
+
+   19.10.26 Original
+*/
+BOOL IsTombstone(long index)
+{
+   if((index < 0) || ((index / WORD_BITS) >= sNWords))
+      return(FALSE);
+   
+   return((sBits[index / WORD_BITS] & (1UL << (index % WORD_BITS))) 
+          ? TRUE : FALSE);
+}
+
+
+/************************************************************************/
+/*>static BOOL GrowBits(long nWords)
+   ---------------------------------
+   Input:     long   nWords    Number of words needed
+   Returns:   BOOL             Success?
+
+   Grows the bitset to at least nWords (doubling each time) with the 
+   new words cleared.
+
+   19.10.26 Original
+   19.10.26 Allocated with PageAlloc() so it may use huge pages
+*/
+static BOOL GrowBits(long nWords)
+{
+   unsigned long *bits;
+   long          size = (sNWords ? sNWords : INITIAL_SIZE);
+
+   while(size < nWords)
+      size *= 2;
+   
+   if((bits = (unsigned long *)PageAlloc(size * sizeof(unsigned long)))
+      ==NULL)
+   {
+      return(FALSE);
+   }
+   if(sBits != NULL)
+   {
+      memcpy(bits, sBits, sNWords * sizeof(unsigned long));
+      PageFree(sBits, sNWords * sizeof(unsigned long));
+   }
+   sBits   = bits;
+   sNWords = size;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void SwapTombstones(TOMBSTONES *other)
+   --------------------------------------
+   I/O:       TOMBSTONES *other  Bitset to use (returned holding the one
+                                 that was in use)
+
+   Exchanges the bitset in use with another. A zeroed TOMBSTONES has no
+   sequences deleted.
+
+   19.10.26 Original
+*/
+void SwapTombstones(TOMBSTONES *other)
+{
+   TOMBSTONES here;
+
+   here.bits     = sBits;
+   here.nWords   = sNWords;
+   sBits         = other->bits;
+   sNWords       = other->nWords;
+   *other        = here;
+}
+
+
+/************************************************************************/
+/*>void FreeTombstones(TOMBSTONES *set)
+   ------------------------------------
+   I/O:       TOMBSTONES *set    Bitset which is not in use
+
+   Frees a bitset swapped out with SwapTombstones(), leaving it empty
+
+   19.10.26 Original
+   19.10.26 Uses PageFree()
+*/
+void FreeTombstones(TOMBSTONES *set)
+{
+   if(set->bits != NULL)
+      PageFree(set->bits, set->nWords * sizeof(unsigned long));
+   set->bits   = NULL;
+   set->nWords = 0;
+}
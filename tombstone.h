@@ -0,0 +1,68 @@
+/*************************************************************************
+
+   Program:    nr
+   File:       tombstone.h
+
+   Version:    V1.2
+   Date:       19.10.26
+   Function:   Bitset of deleted sequences
+
+   Copyright:  (c) University of Reading / Dr. Andrew C. R. Martin 2000
+   Author:     Dr. Andrew C. R. Martin
+   Address:    School of Animal and Microbial Sciences,
+               The University of Reading,
+               Whiteknights,
+               P.O. Box 228,
+               Reading RG6 6AJ.
+               England.
+   Phone:      +44 (0)118 987 5123 Extn. 7022
+   Fax:        +44 (0)118 931 0180
+   EMail:      a.c.r.martin@reading.ac.uk
+               andrew@stagleys.demon.co.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  19.10.26 Original
+   V1.1  19.10.26 Added SwapTombstones() and FreeTombstones()
+   V1.2  19.10.26 The bitset comes from PageAlloc()
+
+*************************************************************************/
+#ifndef _NR_TOMBSTONE_H
+#define _NR_TOMBSTONE_H
+
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Structures
+*/
+typedef struct                   /* A bitset while it is not in use     */
+{
+   unsigned long *bits;
+   long          nWords;
+}  TOMBSTONES;
+
+/************************************************************************/
+/* Prototypes
+*/
+BOOL SetTombstone(long index);
+BOOL IsTombstone(long index);
+void SwapTombstones(TOMBSTONES *other);
+void FreeTombstones(TOMBSTONES *set);
+
+#endif